@@ -0,0 +1,67 @@
+#include "util/C2P.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace trost;
+
+// converts a 320x256 frame over and over with every kernel and prints
+// pixels per second at depths 5 and 8
+//
+//   C2PBench [seconds per run]
+
+static constexpr std::uint16_t Width = 320;
+static constexpr std::uint16_t Height = 256;
+static constexpr std::uint16_t BytesPerRow = Width / 8;
+
+static std::uint8_t chunky[Width * Height];
+static std::uint8_t storage[8][BytesPerRow * Height];
+
+static double run(c2p::Kernel kernel, std::uint16_t depth, double seconds)
+{
+    std::uint8_t* planes[8];
+    for (int p = 0; p < 8; ++p) {
+        planes[p] = storage[p];
+    }
+    std::uint64_t frames = 0;
+    const auto start = std::chrono::steady_clock::now();
+    double elapsed = 0;
+    do {
+        // a handful between clock reads so the clock doesn't dominate
+        for (int i = 0; i < 8; ++i) {
+            c2p::convert(kernel, chunky, Width, Width, Height, planes, BytesPerRow, depth);
+        }
+        frames += 8;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (elapsed < seconds);
+    return static_cast<double>(frames) * Width * Height / elapsed;
+}
+
+int main(int argc, char** argv)
+{
+    const double seconds = argc > 1 ? atof(argv[1]) : 0.5;
+    std::uint32_t state = 1;
+    for (auto& pixel : chunky) {
+        state = state * 1103515245 + 12345;
+        pixel = static_cast<std::uint8_t>(state >> 16);
+    }
+
+    static const struct
+    {
+        c2p::Kernel kernel;
+        const char* name;
+    } kernels[] = {
+        { c2p::Kernel::Reference, "Reference" },
+        { c2p::Kernel::Lookup, "Lookup" },
+        { c2p::Kernel::Merge, "Merge" },
+    };
+    printf("kernel      depth  Mpixels/s\n");
+    static const std::uint16_t depths[] = { 5, 8 };
+    for (auto& k : kernels) {
+        for (auto depth : depths) {
+            printf("%-10s  %5u  %9.1f\n", k.name, depth, run(k.kernel, depth, seconds) / 1e6);
+            fflush(stdout);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include "db/DB.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace trost;
+
+// createIndex over synthetic collections at a few sort budgets. every
+// build runs in a child process so its peak RSS is its own
+//
+//   IndexBench [entries ...]
+
+static const char* const Words[] = {
+    "Alien", "Battle", "Chaos", "Dungeon", "Elite", "Fire", "Ghost", "Hyper", "Island", "Jungle", "Knight", "Lotus",
+    "Monkey", "Night", "Octane", "Power", "Quest", "Rally", "Shadow", "Turbo", "Ultima", "Venom", "Wings", "Zero",
+};
+static const char* const Genres[] = { "Platform", "Shooter", "Adventure", "Racing", "Puzzle", "Strategy" };
+static const std::uint32_t Budgets[] = { 32 * 1024, 256 * 1024 };
+
+// names from a few words each so neighbours share prefixes like real
+// collections do, a serial keeps them apart
+static bool write_collection(const char* dir, std::uint32_t entries)
+{
+    mkdir(dir, 0755);
+    char path[256];
+    snprintf(path, sizeof(path), "%s/games.txt", dir);
+    auto games = fopen(path, "w");
+    if (!games) {
+        return false;
+    }
+    std::uint32_t state = entries;
+    auto next = [&state](std::uint32_t n) -> std::uint32_t {
+        state = state * 1103515245 + 12345;
+        return (state >> 16) % n;
+    };
+    const auto words = static_cast<std::uint32_t>(sizeof(Words) / sizeof(Words[0]));
+    const auto genres = static_cast<std::uint32_t>(sizeof(Genres) / sizeof(Genres[0]));
+    for (std::uint32_t i = 0; i < entries; ++i) {
+        // one draw at a time, argument order isn't fixed
+        const auto a = Words[next(words)];
+        const auto b = Words[next(words)];
+        const auto c = Words[next(words)];
+        const auto year = 1980 + next(20);
+        const auto publisher = next(200);
+        const auto genre = Genres[next(genres)];
+        fprintf(games, "%s %s %s %lu\tdh0:games/%lu\t\tyear=%lu; publisher=Studio %lu; genre=%s\n", a, b, c,
+                static_cast<unsigned long>(i), static_cast<unsigned long>(i), static_cast<unsigned long>(year),
+                static_cast<unsigned long>(publisher), genre);
+    }
+    return fclose(games) == 0;
+}
+
+static void run(const char* dir, std::uint32_t entries, std::uint32_t budget)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const auto child = fork();
+    if (child < 0) {
+        printf("Failed to fork\n");
+        return;
+    }
+    if (!child) {
+        DB db { String(dir) };
+        DB::IndexOptions options;
+        options.sortBudget = budget;
+        _exit(db.createIndex(options) ? 0 : 1);
+    }
+    int status = 0;
+    struct rusage usage = {};
+    wait4(child, &status, 0, &usage);
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+        printf("%8lu  %6luK  failed\n", static_cast<unsigned long>(entries), static_cast<unsigned long>(budget / 1024));
+        return;
+    }
+    printf("%8lu  %6luK  %7.2fs  %6.1fMB\n", static_cast<unsigned long>(entries),
+           static_cast<unsigned long>(budget / 1024), elapsed, usage.ru_maxrss / 1024.0);
+    fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+    std::uint32_t sizes[16] = { 10000, 50000, 100000 };
+    std::size_t count = 3;
+    if (argc > 1) {
+        count = 0;
+        for (int i = 1; i < argc && count < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+            sizes[count++] = static_cast<std::uint32_t>(strtoul(argv[i], nullptr, 10));
+        }
+    }
+
+    mkdir("index.bench", 0755);
+    printf(" entries   budget     time      peak\n");
+    fflush(stdout);
+    for (std::size_t s = 0; s < count; ++s) {
+        char dir[64];
+        snprintf(dir, sizeof(dir), "index.bench/%lu", static_cast<unsigned long>(sizes[s]));
+        if (!write_collection(dir, sizes[s])) {
+            printf("Failed to write %s\n", dir);
+            return 1;
+        }
+        for (auto budget : Budgets) {
+            run(dir, sizes[s], budget);
+        }
+    }
+    return 0;
+}
@@ -3,10 +3,15 @@
 #include "Renderer.h"
 #include "Messages.h"
 #include <clib/exec_protos.h>
+#include <clib/timer_protos.h>
 #include <cstdio>
 
 using namespace trost;
 
+extern "C" {
+struct Device *TimerBase = nullptr;
+}
+
 App* App::sInstance = nullptr;
 
 bool App::initialize()
@@ -17,23 +22,29 @@ bool App::initialize()
 
     sInstance = new App();
 
-    if (!Renderer::initialize()) {
-        delete sInstance->mRenderer;
-        sInstance->mRenderer = nullptr;
+    if (!sInstance->openTimer()) {
+        printf("Failed to open timer.device\n");
+        delete sInstance;
+        sInstance = nullptr;
+        return false;
+    }
+    sInstance->addSignal(sInstance->mTimerPort->mp_SigBit, [that = sInstance]() -> void {
+        that->processTimers();
+    });
+
+    if (!Renderer::initialize(3)) {
+        sInstance->removeSignal(sInstance->mTimerPort->mp_SigBit);
+        sInstance->closeTimer();
+        delete sInstance;
+        sInstance = nullptr;
         return false;
     }
 
     sInstance->mRenderer = Renderer::instance();
-    sInstance->mRenderSig = sInstance->mRenderer->sigBit();
     sInstance->mGraphics = sInstance->mRenderer->graphics();
 
     Messages::initialize(sInstance->mGraphics);
-    sInstance->mMessages = Messages::instance();
-    sInstance->mMessageSig = sInstance->mMessages->sigBit();
-
     Input::initialize(sInstance->mGraphics);
-    sInstance->mInput = Input::instance();
-    sInstance->mInputSig = sInstance->mInput->sigBit();
 
     return true;
 }
@@ -44,9 +55,18 @@ void App::cleanup()
         return;
     }
 
+    // tasks tend to hold on to handlers and renderers, let them go while
+    // everything is still around
+    auto& tasks = sInstance->mTasks;
+    while (tasks.size() > 0) {
+        sInstance->removeTask(tasks.handleAt(tasks.size() - 1));
+    }
+
     Input::cleanup();
     Messages::cleanup();
     Renderer::cleanup();
+    sInstance->removeSignal(sInstance->mTimerPort->mp_SigBit);
+    sInstance->closeTimer();
 
     delete sInstance;
     sInstance = nullptr;
@@ -59,22 +79,258 @@ App* App::instance()
 
 void App::iterateLoop()
 {
+    const bool busy = runTasks();
+
     // if the renderer is ready, just render
     if (!mRenderer->isWaiting()) {
         mRenderer->render();
         return;
     }
 
-    const auto sigs = Wait((1 << mInputSig) | (1 << mRenderSig) | (1 << mMessageSig));
-    if (sigs &(1 << mInputSig)) {
-        mInput->processInput();
-    }
-    if (sigs & (1 << mRenderSig)) {
-        mRenderer->processDbuf();
+    // runnable tasks mean we only poll, otherwise sleep until something
+    // happens. a handler may remove itself or others, skip bits that went away
+    auto sigs = (busy ? SetSignal(0, mSignalMask) : Wait(mSignalMask)) & mSignalMask;
+    if (!sigs) {
+        // nothing to do but run the tasks again
+        return;
     }
-    if (sigs & (1 << mMessageSig)) {
-        mMessages->processMessages();
+    while (sigs) {
+        const auto bit = __builtin_ctzl(sigs);
+        sigs &= sigs - 1;
+        if (mSignalMask & (1UL << bit)) {
+            mSignals[bit]();
+        }
     }
 
     mRenderer->render();
 }
+
+bool App::addSignal(UBYTE sigBit, Function<void()>&& handler)
+{
+    if (sigBit >= 32 || (mSignalMask & (1UL << sigBit))) {
+        return false;
+    }
+    mSignals[sigBit] = std::move(handler);
+    mSignalMask |= 1UL << sigBit;
+    return true;
+}
+
+void App::removeSignal(UBYTE sigBit)
+{
+    if (sigBit >= 32) {
+        return;
+    }
+    // the handler might be the one running right now, leave it in place
+    // until the bit is registered again
+    mSignalMask &= ~(1UL << sigBit);
+}
+
+ULONG App::addTask(Function<Yield()>&& step)
+{
+    return mTasks.insert({ std::move(step), TaskState::Ready, 0, false });
+}
+
+void App::removeTask(ULONG id)
+{
+    auto task = mTasks.get(id);
+    if (!task) {
+        return;
+    }
+    removeTimer(task->timer);
+    mTasks.erase(id);
+}
+
+void App::wakeTask(ULONG id)
+{
+    auto task = mTasks.get(id);
+    if (!task) {
+        return;
+    }
+    if (task->state == TaskState::Ready) {
+        task->woken = true;
+        return;
+    }
+    if (task->timer) {
+        removeTimer(task->timer);
+        task->timer = 0;
+    }
+    task->state = TaskState::Ready;
+}
+
+bool App::runTasks()
+{
+    Vector<ULONG> runnable;
+    const auto sz = mTasks.size();
+    for (std::size_t i = 0; i < sz; ++i) {
+        if (mTasks[i].state == TaskState::Ready) {
+            runnable.push_back(mTasks.handleAt(i));
+        }
+    }
+
+    const auto count = runnable.size();
+    for (std::size_t i = 0; i < count; ++i) {
+        const auto id = runnable[i];
+        auto task = mTasks.get(id);
+        if (!task) {
+            continue;
+        }
+
+        // the step may add or remove tasks which moves the entries
+        // around, so run it from the outside
+        auto step = std::move(task->step);
+        task->woken = false;
+        const auto yield = step();
+
+        task = mTasks.get(id);
+        if (!task) {
+            continue;
+        }
+        switch (yield.kind) {
+        case Yield::Kind::Next:
+            task->step = std::move(step);
+            break;
+        case Yield::Kind::Sleep:
+            task->step = std::move(step);
+            task->state = TaskState::Sleeping;
+            task->timer = addTimer(yield.value, [this, id]() -> void {
+                wakeTask(id);
+            });
+            break;
+        case Yield::Kind::Wait:
+            task->step = std::move(step);
+            if (!task->woken) {
+                task->state = TaskState::Waiting;
+            }
+            break;
+        case Yield::Kind::Done:
+            mTasks.erase(id);
+            break;
+        }
+    }
+
+    // includes tasks added by a step, they haven't run yet
+    const auto remaining = mTasks.size();
+    for (std::size_t i = 0; i < remaining; ++i) {
+        if (mTasks[i].state == TaskState::Ready) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool App::openTimer()
+{
+    mTimerPort = CreateMsgPort();
+    if (!mTimerPort) {
+        return false;
+    }
+    mTimerRequest = reinterpret_cast<timerequest*>(CreateIORequest(mTimerPort, sizeof(timerequest)));
+    if (!mTimerRequest) {
+        DeleteMsgPort(mTimerPort);
+        mTimerPort = nullptr;
+        return false;
+    }
+    if (OpenDevice(TIMERNAME, UNIT_MICROHZ, reinterpret_cast<IORequest*>(mTimerRequest), 0) != 0) {
+        DeleteIORequest(mTimerRequest);
+        DeleteMsgPort(mTimerPort);
+        mTimerRequest = nullptr;
+        mTimerPort = nullptr;
+        return false;
+    }
+    TimerBase = mTimerRequest->tr_node.io_Device;
+    return true;
+}
+
+void App::closeTimer()
+{
+    if (!mTimerRequest) {
+        return;
+    }
+    if (mTimerPending) {
+        AbortIO(reinterpret_cast<IORequest*>(mTimerRequest));
+        WaitIO(reinterpret_cast<IORequest*>(mTimerRequest));
+        mTimerPending = false;
+    }
+    CloseDevice(reinterpret_cast<IORequest*>(mTimerRequest));
+    DeleteIORequest(mTimerRequest);
+    DeleteMsgPort(mTimerPort);
+    mTimerRequest = nullptr;
+    mTimerPort = nullptr;
+    TimerBase = nullptr;
+}
+
+ULONG App::milliseconds() const
+{
+    timeval tv;
+    GetSysTime(&tv);
+    return tv.tv_secs * 1000 + tv.tv_micro / 1000;
+}
+
+ULONG App::addTimer(ULONG delay, Function<void()>&& callback)
+{
+    const auto id = mTimers.add(milliseconds(), delay, 0, std::move(callback));
+    scheduleTimer();
+    return id;
+}
+
+ULONG App::addPeriodicTimer(ULONG interval, Function<void()>&& callback)
+{
+    const auto id = mTimers.add(milliseconds(), interval, interval, std::move(callback));
+    scheduleTimer();
+    return id;
+}
+
+void App::removeTimer(ULONG id)
+{
+    if (mTimers.remove(id)) {
+        scheduleTimer();
+    }
+}
+
+void App::processTimers()
+{
+    if (!GetMsg(mTimerPort)) {
+        return;
+    }
+    mTimerPending = false;
+
+    mTimers.fire(milliseconds());
+    scheduleTimer();
+}
+
+void App::scheduleTimer()
+{
+    auto request = reinterpret_cast<IORequest*>(mTimerRequest);
+
+    // nothing to wait for, don't leave a wakeup behind
+    if (mTimers.empty()) {
+        if (mTimerPending) {
+            AbortIO(request);
+            WaitIO(request);
+            SetSignal(0, 1UL << mTimerPort->mp_SigBit);
+            mTimerPending = false;
+        }
+        return;
+    }
+
+    const auto deadline = mTimers.nextDeadline();
+    if (mTimerPending) {
+        // the request in flight fires early enough, let it be
+        if (static_cast<LONG>(mTimerDeadline - deadline) <= 0) {
+            return;
+        }
+        AbortIO(request);
+        WaitIO(request);
+        SetSignal(0, 1UL << mTimerPort->mp_SigBit);
+        mTimerPending = false;
+    }
+
+    const auto now = milliseconds();
+    const auto delay = static_cast<LONG>(deadline - now) > 0 ? deadline - now : 0;
+    mTimerRequest->tr_node.io_Command = TR_ADDREQUEST;
+    mTimerRequest->tr_time.tv_secs = delay / 1000;
+    mTimerRequest->tr_time.tv_micro = (delay % 1000) * 1000;
+    SendIO(request);
+    mTimerDeadline = deadline;
+    mTimerPending = true;
+}
@@ -1,12 +1,14 @@
 #pragma once
 
 #include "Graphics.h"
+#include "util/Function.h"
+#include "util/SlotMap.h"
+#include "util/TimerQueue.h"
+#include <devices/timer.h>
 
 namespace trost {
 
 class Renderer;
-class Messages;
-class Input;
 
 class App
 {
@@ -18,15 +20,81 @@ public:
 
     void iterateLoop();
 
+    // subsystems hook their signal bits into the loop here, one handler
+    // per bit. the loop waits on the union of registered bits
+    bool addSignal(UBYTE sigBit, Function<void()>&& handler);
+    void removeSignal(UBYTE sigBit);
+
+    // timers run from iterateLoop, all timers share one timer.device
+    // request aimed at the earliest deadline. delays are in milliseconds
+    ULONG addTimer(ULONG delay, Function<void()>&& callback);
+    ULONG addPeriodicTimer(ULONG interval, Function<void()>&& callback);
+    void removeTimer(ULONG id);
+
+    // cooperative tasks, step is called from iterateLoop to do a slice of
+    // work and says when it wants to run again. a waiting task is resumed
+    // by wakeTask, typically from an input handler or a timer. nothing in
+    // here blocks so modal UI doesn't need a loop of its own
+    struct Yield
+    {
+        enum class Kind {
+            Next,
+            Sleep,
+            Wait,
+            Done,
+        };
+        Kind kind;
+        ULONG value;
+
+        static Yield next() { return { Kind::Next, 0 }; }
+        static Yield sleep(ULONG ms) { return { Kind::Sleep, ms }; }
+        static Yield wait() { return { Kind::Wait, 0 }; }
+        static Yield done() { return { Kind::Done, 0 }; }
+    };
+    ULONG addTask(Function<Yield()>&& step);
+    // safe to call from inside a step, including for the running task
+    void removeTask(ULONG id);
+    void wakeTask(ULONG id);
+
+    // monotonic enough for deadlines, wraps every ~49 days
+    ULONG milliseconds() const;
+
 private:
     App() = default;
 
+    bool openTimer();
+    void closeTimer();
+    void processTimers();
+    void scheduleTimer();
+    bool runTasks();
+
     const Graphics* mGraphics = nullptr;
 
-    UBYTE mInputSig, mRenderSig, mMessageSig;
-    Input* mInput = nullptr;
     Renderer* mRenderer = nullptr;
-    Messages* mMessages = nullptr;
+
+    Function<void()> mSignals[32];
+    ULONG mSignalMask = 0;
+
+    MsgPort* mTimerPort = nullptr;
+    timerequest* mTimerRequest = nullptr;
+    bool mTimerPending = false;
+    ULONG mTimerDeadline = 0;
+    TimerQueue mTimers;
+
+    enum class TaskState {
+        Ready,
+        Sleeping,
+        Waiting,
+    };
+    struct Task
+    {
+        Function<Yield()> step;
+        TaskState state;
+        ULONG timer;
+        // woken while running, the next wait doesn't park
+        bool woken;
+    };
+    SlotMap<Task> mTasks;
 
     static App* sInstance;
 };
@@ -2,15 +2,26 @@
 #include "App.h"
 #include "Messages.h"
 #include "Renderer.h"
+#include "TextField.h"
+#include "util/Collation.h"
+#include "util/SharedPtr.h"
 #include <clib/alib_protos.h>
-#include <clib/keymap_protos.h>
 #include <clib/graphics_protos.h>
 #include <clib/exec_protos.h>
 #include <devices/gameport.h>
+#include <devices/input.h>
 #include <cstring>
 #include <cstdio>
 
 extern "C" ExecBase *SysBase;
+extern "C" struct IntuitionBase *IntuitionBase;
+
+// input.device calls handlers with the event list in a0 and is_Data in a1
+#if defined(__mc68000__)
+#define REG(reg, arg) arg __asm(#reg)
+#else
+#define REG(reg, arg) arg
+#endif
 
 using namespace trost;
 
@@ -19,6 +30,10 @@ using namespace trost;
 
 using JoyDirection = Input::JoyDirection;
 
+// repeat tokens, the low bits hold the direction or the raw key code
+static constexpr ULONG JoystickRepeat = 0x10000;
+static constexpr ULONG KeyboardRepeat = 0x20000;
+
 static const JoyDirection joyDirectionLookup[3][3] = {
     // y = -1                                 0,                   1 (up)
     { JoyDirection::Left  | JoyDirection::Up, JoyDirection::Left,  JoyDirection::Left  | JoyDirection::Down },  // x = -1
@@ -59,6 +74,13 @@ static BOOL set_controller_type(BYTE type, struct IOStdReq *game_io_msg)
     return(success);
 }
 
+// idle timeout for gameport reads, as long as it goes since timeouts are
+// dropped anyway
+static UWORD timeout_ticks()
+{
+    return (UWORD)(SysBase->VBlankFrequency) * 60;
+}
+
 static void set_trigger_conditions(struct GamePortTrigger *gpt,
                                    struct IOStdReq *game_io_msg)
 {
@@ -66,8 +88,8 @@ static void set_trigger_conditions(struct GamePortTrigger *gpt,
     gpt->gpt_Keys   = GPTF_UPKEYS | GPTF_DOWNKEYS;
     gpt->gpt_XDelta = 1;
     gpt->gpt_YDelta = 1;
-    /* timeout trigger every TIMEOUT_SECONDS second(s) */
-    gpt->gpt_Timeout = (UWORD)(SysBase->VBlankFrequency) * 10;
+    /* timeout trigger every minute */
+    gpt->gpt_Timeout = timeout_ticks();
 
     game_io_msg->io_Command = GPD_SETTRIGGER;
     game_io_msg->io_Flags   = IOF_QUICK;
@@ -107,88 +129,65 @@ static void send_read_request(struct InputEvent *game_event,
 }
 
 namespace trost {
-bool acquireKeyInput(const KeyInputOptions& options, KeyInput* input)
-{
-    InputEvent ie;
-
-    char output[10];
-    unsigned int pos = 0;
-    long x = options.rect.x, y = options.rect.y;
-
-    static auto keymap = AskKeyMapDefault();
-
-    auto inputInstance = Input::instance();
-    bool success = false;
-    bool done = false;
-    auto inputId = inputInstance->addKeyboard([&](IntuiMessage* msg) -> void {
-        auto code = msg->Code;
-        auto qualifier = msg->Qualifier;
-        if ((code & 0x80) == 0) {
-            // key press
-            switch (code) {
-            case 0x45: // Escape key
-                done = true;
-                break;
-            case 0x44: // Enter key
-                input->buffer[pos] = '\0';
-                input->length = pos;
-                success = done = true;
-                break;
-            case 0x41: // Backspace key
-            case 0x46: // Delete key
-                pos--;
-                break;
-            default:
-                ie.ie_Class = IECLASS_RAWKEY;
-                ie.ie_Code = code;
-                ie.ie_Qualifier = qualifier;
-                ie.ie_EventAddress = NULL;
-                if (MapRawKey(&ie, (STRPTR)output, sizeof(output), keymap) > 0) {
-                    char ch = output[0];
-                    if (pos < sizeof(input->buffer) - 1 && ch >= 32 && ch <= 126) {
-                        input->buffer[pos++] = ch;
-                    }
-                } else {
-                    // map failed, bail out. should surface this somehow
-                    //printf("Failed to map raw key: %d %d\n", code, qualifier);
-                    //done = true;
-                }
-            }
+ULONG acquireKeyInput(const KeyInputOptions& options, Function<void(const KeyInput*)>&& done)
+{
+    // handlers and the renderer point at the state, the task owns it and
+    // tears everything down when it finishes or is removed
+    struct State
+    {
+        State(const KeyInputOptions& options)
+            : field(options.rect, options.message, options.messageLength)
+        {
+        }
+        ~State()
+        {
+            Renderer::instance()->removeRenderer(rendererId);
+            Input::instance()->removeKeyboard(inputId);
         }
-    }, Input::AddMode::Exclusive);
-
-    auto app = App::instance();
 
-    auto renderer = Renderer::instance();
+        TextField field;
+        TextField::Result result = TextField::Result::None;
+        ULONG task = 0;
+        ULONG inputId = 0;
+        ULONG rendererId = 0;
+    };
+    SharedPtr<State> state(new State(options));
+    auto raw = state.get();
+
+    raw->inputId = Input::instance()->addKeyboard([raw](IntuiMessage* msg) -> void {
+        const auto result = raw->field.handleKey(msg);
+        if (result == TextField::Result::Accept || result == TextField::Result::Cancel) {
+            raw->result = result;
+            App::instance()->wakeTask(raw->task);
+        }
+    }, Input::AddMode::Exclusive);
 
-    auto rendererId = renderer->addRenderer([&](Renderer::Context* ctx) -> void {
-        auto rp = ctx->rastPort;
+    raw->rendererId = Renderer::instance()->addRenderer([raw](Renderer::Context* ctx) -> void {
+        raw->field.render(ctx);
+    });
 
-        long cx = x, cy = y;
-        Move(rp, cx, cy);
-        if (options.message) {
-            auto messageLen = options.messageLength ? options.messageLength : strlen(options.message);
-            Text(rp, options.message, messageLen);
-            cy += 20;
-            Move(rp, cx, cy);
-        }
-        if (pos > 0) {
-            Text(rp, input->buffer, pos);
+    raw->task = App::instance()->addTask([state, done = std::move(done)]() -> App::Yield {
+        switch (state->result) {
+        case TextField::Result::Accept: {
+            KeyInput input;
+            memcpy(input.buffer, state->field.buffer(), state->field.length() + 1);
+            input.length = state->field.length();
+            input.keyLength = collation::key(input.buffer, input.length, input.key, sizeof(input.key));
+            done(&input);
+            return App::Yield::done(); }
+        case TextField::Result::Cancel:
+            done(nullptr);
+            return App::Yield::done();
+        default:
+            return App::Yield::wait();
         }
     });
-
-    while (!done) {
-        app->iterateLoop();
-    }
-
-    renderer->removeRenderer(rendererId);
-    inputInstance->removeKeyboard(inputId);
-    return true;
+    return raw->task;
 }
 
 Input* Input::sInstance = nullptr;
 
-void Input::initialize(const Graphics* graphics)
+void Input::initialize(const Graphics* graphics, KeyboardSource source)
 {
     if (sInstance) {
         return;
@@ -196,74 +195,275 @@ void Input::initialize(const Graphics* graphics)
     sInstance = new Input();
     sInstance->mGraphics = graphics;
 
+    // the keyboard works without a joystick
+    sInstance->openGameport();
+
+    sInstance->mRepeater.configure(sInstance->mRepeatOptions.timing);
+
+    if (source == KeyboardSource::InputHandler) {
+        if (sInstance->addInputHandler()) {
+            return;
+        }
+        printf("Failed to add input handler, using IDCMP\n");
+    }
+
+    auto messages = Messages::instance();
+    sInstance->mMessageId = messages->addHandler(IDCMP_RAWKEY, [that = sInstance](IntuiMessage* msg) -> void {
+        that->dispatchKeyboard(msg);
+    });
+}
+
+bool Input::openGameport()
+{
     auto inputPort = CreatePort("RKM_game_port", 0);
+    if (!inputPort) {
+        printf("Failed to create gameport port\n");
+        return false;
+    }
 
     GamePortTrigger joytrigger;
     auto inputRequest = CreateExtIO(inputPort, sizeof(IOStdReq));
+    if (!inputRequest) {
+        DeletePort(inputPort);
+        printf("Failed to create gameport request\n");
+        return false;
+    }
     inputRequest->io_Message.mn_Node.ln_Type = NT_UNKNOWN;
     if (OpenDevice("gameport.device", 1, inputRequest, 0) != 0) {
-        DeleteMsgPort(inputPort);
-        inputPort = nullptr;
+        DeleteExtIO(inputRequest);
+        DeletePort(inputPort);
         printf("Failed to open gameport.device\n");
-        return;
+        return false;
     }
     if (!set_controller_type(GPCT_ABSJOYSTICK, reinterpret_cast<IOStdReq*>(inputRequest))) {
         CloseDevice(reinterpret_cast<IORequest*>(inputRequest));
-        DeleteMsgPort(inputPort);
-        inputPort = nullptr;
+        DeleteExtIO(inputRequest);
+        DeletePort(inputPort);
         printf("Failed to acquire joystick\n");
-        return;
+        return false;
     }
     set_trigger_conditions(&joytrigger, reinterpret_cast<IOStdReq*>(inputRequest));
     flush_buffer(reinterpret_cast<IOStdReq*>(inputRequest));
 
-    sInstance->mInputPort = inputPort;
-    sInstance->mInputRequest = inputRequest;
-    send_read_request(&sInstance->mGameEvent, reinterpret_cast<IOStdReq*>(inputRequest));
+    mInputPort = inputPort;
+    App::instance()->addSignal(inputPort->mp_SigBit, [this]() -> void {
+        processInput();
+    });
+    mReads[0].request = inputRequest;
+    for (int i = 1; i < ReadCount; ++i) {
+        auto request = CreateExtIO(inputPort, sizeof(IOStdReq));
+        if (!request) {
+            break;
+        }
+        // share the unit opened by the first request
+        request->io_Device = inputRequest->io_Device;
+        request->io_Unit = inputRequest->io_Unit;
+        mReads[i].request = request;
+    }
+    for (auto& read : mReads) {
+        if (read.request) {
+            send_read_request(&read.event, reinterpret_cast<IOStdReq*>(read.request));
+        }
+    }
+    return true;
+}
+
+void Input::closeGameport()
+{
+    if (!mInputPort) {
+        return;
+    }
+    App::instance()->removeSignal(mInputPort->mp_SigBit);
 
-    auto messages = Messages::instance();
-    sInstance->mMessageId = messages->addHandler(IDCMP_RAWKEY, [that = sInstance](IntuiMessage* msg) -> void {
-        if (that->mExclusiveKeyboard) {
-            // find the exclusive handler
-            const auto sz = that->mKeyboards.size();
-            for (std::size_t i = 0; i < sz; ++i) {
-                if (that->mKeyboards[i].id == that->mExclusiveKeyboard) {
-                    that->mKeyboards[i].handler(msg);
-                    break;
-                }
-            }
-            return;
+    for (auto& read : mReads) {
+        if (read.request && !CheckIO(read.request)) {
+            AbortIO(read.request);
+            WaitIO(read.request);
+        }
+    }
+
+    auto unitRequest = mReads[0].request;
+    free_gp_unit(reinterpret_cast<IOStdReq*>(unitRequest));
+
+    WaitIO(unitRequest);
+
+    CloseDevice(unitRequest);
+    for (auto& read : mReads) {
+        if (read.request) {
+            DeleteExtIO(read.request);
+            read.request = nullptr;
+        }
+    }
+    DeletePort(mInputPort);
+    mInputPort = nullptr;
+}
+
+static InputEvent* input_handler(REG(a0, InputEvent* events), REG(a1, Input* that))
+{
+    that->queueKeyEvents(events);
+    return events;
+}
+
+void Input::queueKeyEvents(InputEvent* events)
+{
+    // only look at keys meant for our window
+    if (IntuitionBase->ActiveWindow != mGraphics->window) {
+        return;
+    }
+
+    bool queued = false;
+    for (auto event = events; event; event = event->ie_NextEvent) {
+        if (event->ie_Class == IECLASS_RAWKEY) {
+            mKeyEvents.push({ event->ie_Code, event->ie_Qualifier,
+                    event->ie_TimeStamp.tv_secs, event->ie_TimeStamp.tv_micro });
+            queued = true;
         }
+    }
+
+    if (queued) {
+        Signal(mHandlerTask, 1UL << mHandlerSignal);
+    }
+}
 
-        // call all handlers
-        const auto sz = that->mKeyboards.size();
-        for (std::size_t i = 0; i < sz; ++i) {
-            that->mKeyboards[i].handler(msg);
+bool Input::addInputHandler()
+{
+    // the handler signals the main task on a bit of its own, there may
+    // not be a gameport to share one with
+    mHandlerSignal = AllocSignal(-1);
+    if (mHandlerSignal < 0) {
+        return false;
+    }
+    mHandlerTask = FindTask(nullptr);
+    mHandlerPort = CreateMsgPort();
+    if (mHandlerPort) {
+        mHandlerRequest = reinterpret_cast<IOStdReq*>(CreateIORequest(mHandlerPort, sizeof(IOStdReq)));
+    }
+    if (!mHandlerRequest || OpenDevice("input.device", 0, reinterpret_cast<IORequest*>(mHandlerRequest), 0) != 0) {
+        if (mHandlerRequest) {
+            DeleteIORequest(mHandlerRequest);
+        }
+        if (mHandlerPort) {
+            DeleteMsgPort(mHandlerPort);
         }
+        FreeSignal(mHandlerSignal);
+        mHandlerRequest = nullptr;
+        mHandlerPort = nullptr;
+        mHandlerSignal = -1;
+        return false;
+    }
+    App::instance()->addSignal(static_cast<UBYTE>(mHandlerSignal), [this]() -> void {
+        drainKeyEvents();
     });
+
+    // ahead of Intuition which sits at 50
+    mHandlerInterrupt.is_Node.ln_Type = NT_INTERRUPT;
+    mHandlerInterrupt.is_Node.ln_Pri = 51;
+    mHandlerInterrupt.is_Node.ln_Name = const_cast<char*>("trost");
+    mHandlerInterrupt.is_Data = this;
+    mHandlerInterrupt.is_Code = reinterpret_cast<void (*)()>(&input_handler);
+
+    mHandlerRequest->io_Command = IND_ADDHANDLER;
+    mHandlerRequest->io_Data = &mHandlerInterrupt;
+    DoIO(reinterpret_cast<IORequest*>(mHandlerRequest));
+    return true;
 }
 
-void Input::cleanup()
+void Input::removeInputHandler()
 {
-    if (!sInstance) {
+    if (!mHandlerRequest) {
         return;
     }
 
-    Messages::instance()->removeHandler(sInstance->mMessageId);
+    mHandlerRequest->io_Command = IND_REMHANDLER;
+    mHandlerRequest->io_Data = &mHandlerInterrupt;
+    DoIO(reinterpret_cast<IORequest*>(mHandlerRequest));
 
-    auto that = sInstance;
-    if (!CheckIO(reinterpret_cast<IORequest*>(that->mInputRequest))) {
-        AbortIO(reinterpret_cast<IORequest*>(that->mInputRequest));
-        WaitIO(reinterpret_cast<IORequest*>(that->mInputRequest));
+    CloseDevice(reinterpret_cast<IORequest*>(mHandlerRequest));
+    DeleteIORequest(mHandlerRequest);
+    DeleteMsgPort(mHandlerPort);
+    mHandlerRequest = nullptr;
+    mHandlerPort = nullptr;
+
+    // nothing signals any more, whatever was queued last is dropped
+    App::instance()->removeSignal(static_cast<UBYTE>(mHandlerSignal));
+    FreeSignal(mHandlerSignal);
+    mHandlerSignal = -1;
+}
+
+void Input::drainKeyEvents()
+{
+    // handlers expect IntuiMessages, dress the queued keys up as one
+    IntuiMessage msg = {};
+    msg.Class = IDCMP_RAWKEY;
+    msg.IDCMPWindow = mGraphics->window;
+
+    KeyEvent event;
+    while (mKeyEvents.pop(&event)) {
+        msg.Code = event.code;
+        msg.Qualifier = event.qualifier;
+        msg.Seconds = event.seconds;
+        msg.Micros = event.micros;
+        dispatchKeyboard(&msg);
     }
+}
 
-    free_gp_unit(reinterpret_cast<IOStdReq*>(that->mInputRequest));
+// shifts, caps lock, ctrl, alts and amigas
+static bool is_qualifier_key(UWORD code)
+{
+    return code >= 0x60 && code <= 0x67;
+}
 
-    WaitIO(reinterpret_cast<IORequest*>(that->mInputRequest));
+void Input::dispatchKeyboard(IntuiMessage* msg)
+{
+    if (mRepeatOptions.keyboard && msg->Class == IDCMP_RAWKEY) {
+        // we do the repeating, drop the system's
+        if (msg->Qualifier & IEQUALIFIER_REPEAT) {
+            return;
+        }
+        const auto code = msg->Code & ~IECODE_UP_PREFIX;
+        if (is_qualifier_key(code)) {
+            // shift, ctrl and friends don't repeat and don't stop
+            // whatever key is repeating while they go down or up
+        } else if (msg->Code & IECODE_UP_PREFIX) {
+            releaseRepeat(KeyboardRepeat | code);
+        } else {
+            mRepeatQualifier = msg->Qualifier;
+            pressRepeat(KeyboardRepeat | msg->Code);
+        }
+    }
+
+    deliverKeyboard(msg);
+}
+
+void Input::deliverKeyboard(IntuiMessage* msg)
+{
+    if (mExclusiveKeyboard) {
+        if (auto handler = mKeyboards.get(mExclusiveKeyboard)) {
+            (*handler)(msg);
+        }
+        return;
+    }
+
+    // call all handlers
+    const auto sz = mKeyboards.size();
+    for (std::size_t i = 0; i < sz; ++i) {
+        mKeyboards[i](msg);
+    }
+}
+
+void Input::cleanup()
+{
+    if (!sInstance) {
+        return;
+    }
+
+    Messages::instance()->removeHandler(sInstance->mMessageId);
 
-    CloseDevice(reinterpret_cast<IORequest*>(that->mInputRequest));
-    DeleteExtIO(reinterpret_cast<IORequest*>(that->mInputRequest));
-    DeletePort(that->mInputPort);
+    auto that = sInstance;
+    that->removeInputHandler();
+    that->mRepeater.releaseAll();
+    that->scheduleRepeat();
+    that->closeGameport();
 
     delete sInstance;
     sInstance = nullptr;
@@ -276,133 +476,220 @@ Input* Input::instance()
 
 ULONG Input::addKeyboard(Function<void(IntuiMessage*)>&& handler, AddMode mode)
 {
-    ULONG id = ++mNextKeyboardId;
+    if (mode == AddMode::Exclusive && mExclusiveKeyboard != 0) {
+        return 0;
+    }
 
+    const auto id = mKeyboards.insert(std::move(handler));
     if (mode == AddMode::Exclusive) {
-        if (mExclusiveKeyboard != 0) {
-            return 0;
-        }
         mExclusiveKeyboard = id;
     }
-
-    mKeyboards.push_back({ id, std::move(handler) });
     return id;
 }
 
 ULONG Input::addJoystick(Function<void(JoystickEvent*)>&& handler, AddMode mode)
 {
-    ULONG id = ++mNextJoystickId;
+    if (mode == AddMode::Exclusive && mExclusiveJoystick != 0) {
+        return 0;
+    }
 
+    const auto id = mJoysticks.insert(std::move(handler));
     if (mode == AddMode::Exclusive) {
-        if (mExclusiveJoystick != 0) {
-            return 0;
-        }
         mExclusiveJoystick = id;
     }
-
-    mJoysticks.push_back({ id, std::move(handler) });
     return id;
 }
 
 void Input::removeKeyboard(ULONG id)
 {
-    const auto sz = mKeyboards.size();
-    for (std::size_t i = 0; i < sz; ++i) {
-        if (mKeyboards[i].id == id) {
-            mKeyboards.remove_at(i);
-
-            if (mExclusiveKeyboard == id) {
-                mExclusiveKeyboard = 0;
-            }
-
-            return;
-        }
+    if (mKeyboards.erase(id) && mExclusiveKeyboard == id) {
+        mExclusiveKeyboard = 0;
     }
 }
 
 void Input::removeJoystick(ULONG id)
 {
-    const auto sz = mJoysticks.size();
-    for (std::size_t i = 0; i < sz; ++i) {
-        if (mJoysticks[i].id == id) {
-            mJoysticks.remove_at(i);
-
-            if (mExclusiveJoystick == id) {
-                mExclusiveJoystick = 0;
-            }
+    if (mJoysticks.erase(id) && mExclusiveJoystick == id) {
+        mExclusiveJoystick = 0;
+    }
+}
 
-            return;
+void Input::dispatchJoystick(JoystickEvent* event)
+{
+    if (mExclusiveJoystick) {
+        if (auto handler = mJoysticks.get(mExclusiveJoystick)) {
+            (*handler)(event);
         }
+        return;
+    }
+
+    // call all handlers
+    const auto sz = mJoysticks.size();
+    for (std::size_t i = 0; i < sz; ++i) {
+        mJoysticks[i](event);
     }
 }
 
 void Input::processInput()
 {
+    // drain every read that has come back. button edges go out in order
+    // as they happen, movement is collapsed into one event per batch.
+    // a stick that was pushed and released within one batch still
+    // reports the push before the release
+    JoystickEvent event;
+    JoyDirection moved = JoyDirection::None;
+    bool pendingMove = false;
+
+    auto flushMove = [&]() {
+        if (!pendingMove) {
+            return;
+        }
+        if (mDirections == JoyDirection::None && moved != JoyDirection::None) {
+            event = { moved, JoyButton::None };
+            dispatchJoystick(&event);
+        }
+        event = { mDirections, JoyButton::None };
+        dispatchJoystick(&event);
+        moved = JoyDirection::None;
+        pendingMove = false;
+
+        if (mRepeatOptions.joystick) {
+            if (mDirections != JoyDirection::None) {
+                pressRepeat(JoystickRepeat | static_cast<ULONG>(mDirections));
+            } else if (mRepeater.active() && (mRepeater.token() & JoystickRepeat)) {
+                releaseRepeat(mRepeater.token());
+            }
+        }
+    };
+
     struct Message *imsg;
-    if ((imsg = GetMsg(mInputPort))) {
-        mJoystickEvent = { JoyDirection::None, JoyButton::None };
+    while ((imsg = GetMsg(mInputPort))) {
+        GameRead* read = nullptr;
+        for (auto& candidate : mReads) {
+            if (reinterpret_cast<Message*>(candidate.request) == imsg) {
+                read = &candidate;
+                break;
+            }
+        }
+        if (!read) {
+            continue;
+        }
+
+        // copy out before the buffer goes back to the device
+        const InputEvent gameEvent = read->event;
+        send_read_request(&read->event, reinterpret_cast<IOStdReq*>(read->request));
 
-        bool send = true;
-        switch (mGameEvent.ie_Code) {
+        auto button = JoyButton::None;
+        switch (gameEvent.ie_Code) {
         case IECODE_LBUTTON:
             // fire button pressed
-            mJoystickEvent.buttons |= JoyButton::Button1Down;
+            button = JoyButton::Button1Down;
             break;
         case IECODE_LBUTTON | IECODE_UP_PREFIX:
             // fire button released
-            mJoystickEvent.buttons |= JoyButton::Button1Up;
+            button = JoyButton::Button1Up;
             break;
         case IECODE_RBUTTON:
             // alt button pressed
-            mJoystickEvent.buttons |= JoyButton::Button2Down;
+            button = JoyButton::Button2Down;
             break;
         case IECODE_RBUTTON | IECODE_UP_PREFIX:
             // alt button released
-            mJoystickEvent.buttons |= JoyButton::Button2Up;
+            button = JoyButton::Button2Up;
             break;
         case IECODE_NOBUTTON: {
             // check for move
-            const auto xmove = mGameEvent.ie_X;
-            const auto ymove = mGameEvent.ie_Y;
+            const auto xmove = gameEvent.ie_X;
+            const auto ymove = gameEvent.ie_Y;
             if (xmove == 0 && ymove == 0) {
                 // this might be a timeout
-                if (mGameEvent.ie_TimeStamp.tv_secs >= (UWORD)(SysBase->VBlankFrequency) * 10) {
-                    send = false;
+                if (gameEvent.ie_TimeStamp.tv_secs >= timeout_ticks()) {
                     break; // timeout, ignore
                 }
             }
-            mJoystickEvent.directions = joyDirectionLookup[xmove + 1][ymove + 1];
-            //printf("Joystick moved: x=%d, y=%d, direction=%d\n", xmove, ymove, static_cast<UBYTE>(dir));
-
+            mDirections = joyDirectionLookup[xmove + 1][ymove + 1];
+            if (mDirections != JoyDirection::None) {
+                moved = mDirections;
+            }
+            pendingMove = true;
             break; }
         }
 
-        if (send) {
-            if (mExclusiveJoystick) {
-                // find the exclusive handler
-                const auto sz = mJoysticks.size();
-                for (std::size_t i = 0; i < sz; ++i) {
-                    if (mJoysticks[i].id == mExclusiveJoystick) {
-                        mJoysticks[i].handler(&mJoystickEvent);
-                        break;
-                    }
-                }
-            } else {
-                // call all handlers
-                const auto sz = mJoysticks.size();
-                for (std::size_t i = 0; i < sz; ++i) {
-                    mJoysticks[i].handler(&mJoystickEvent);
-                }
-            }
+        if (button != JoyButton::None) {
+            flushMove();
+            event = { JoyDirection::None, button };
+            dispatchJoystick(&event);
+        }
+    }
+
+    flushMove();
+}
+
+void Input::setRepeat(const RepeatOptions& options)
+{
+    mRepeatOptions = options;
+    mRepeater.configure(options.timing);
+    mRepeater.releaseAll();
+    scheduleRepeat();
+}
+
+void Input::pressRepeat(ULONG token)
+{
+    mRepeater.press(token, App::instance()->milliseconds());
+    scheduleRepeat();
+}
+
+void Input::releaseRepeat(ULONG token)
+{
+    if (!mRepeater.active()) {
+        return;
+    }
+    mRepeater.release(token);
+    scheduleRepeat();
+}
+
+void Input::scheduleRepeat()
+{
+    auto app = App::instance();
+    if (mRepeatTimer) {
+        app->removeTimer(mRepeatTimer);
+        mRepeatTimer = 0;
+    }
+
+    // nothing held, nothing to wake up for
+    if (!mRepeater.active()) {
+        return;
+    }
+
+    mRepeatTimer = app->addTimer(mRepeater.remaining(app->milliseconds()), [this]() -> void {
+        mRepeatTimer = 0;
+        fireRepeat();
+    });
+}
+
+void Input::fireRepeat()
+{
+    if (mRepeater.fire(App::instance()->milliseconds())) {
+        const auto token = mRepeater.token();
+        if (token & JoystickRepeat) {
+            JoystickEvent event = { static_cast<JoyDirection>(token & ~JoystickRepeat), JoyButton::None, true };
+            dispatchJoystick(&event);
+        } else {
+            IntuiMessage msg = {};
+            msg.Class = IDCMP_RAWKEY;
+            msg.Code = static_cast<UWORD>(token & ~KeyboardRepeat);
+            msg.Qualifier = mRepeatQualifier | IEQUALIFIER_REPEAT;
+            msg.IDCMPWindow = mGraphics->window;
+            deliverKeyboard(&msg);
         }
     }
 
-    send_read_request(&mGameEvent, reinterpret_cast<IOStdReq*>(mInputRequest));
+    scheduleRepeat();
 }
 
 UBYTE Input::sigBit() const
 {
-    return mInputPort->mp_SigBit;
+    return mInputPort ? mInputPort->mp_SigBit : 0xff;
 }
 
 }
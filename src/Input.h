@@ -2,18 +2,31 @@
 
 #include "Graphics.h"
 #include "util/Function.h"
-#include "util/Vector.h"
+#include "util/Repeater.h"
+#include "util/RingBuffer.h"
+#include "util/SlotMap.h"
 #include "Rect.h"
 #include "util/Flags.h"
 #include <clib/intuition_protos.h>
 #include <devices/inputevent.h>
+#include <exec/interrupts.h>
 
 namespace trost {
 
 class Input
 {
 public:
-    static void initialize(const Graphics* graphics);
+    // where keyboard events come from. Intuition delivers RAWKEY messages
+    // through the window, InputHandler installs an input.device handler
+    // that queues keys at interrupt level ahead of Intuition. the events
+    // are passed on, so Intuition still sees them for its own shortcuts,
+    // but no RAWKEY messages are asked for and none are dispatched
+    enum class KeyboardSource {
+        Intuition,
+        InputHandler,
+    };
+
+    static void initialize(const Graphics* graphics, KeyboardSource source = KeyboardSource::Intuition);
     static void cleanup();
 
     static Input* instance();
@@ -39,10 +52,13 @@ public:
         Button2Up    = 0x8,
     };
 
+    // repeat is set for events generated by auto-repeat while the stick
+    // is held, directions is the held direction
     struct JoystickEvent
     {
         JoyDirection directions;
         JoyButton buttons;
+        bool repeat = false;
     };
 
     ULONG addKeyboard(Function<void(IntuiMessage*)>&& handler, AddMode mode = AddMode::Normal);
@@ -53,47 +69,98 @@ public:
 
     void processInput();
 
+    // the gameport's signal, 0xff without a joystick
     UBYTE sigBit() const;
 
+    // auto-repeat for a held stick direction and, if keyboard is set, for
+    // held keys in place of the system key repeat. repeated keys carry
+    // IEQUALIFIER_REPEAT. nothing is scheduled while nothing is held
+    struct RepeatOptions
+    {
+        Repeater::Config timing;
+        bool joystick = true;
+        bool keyboard = false;
+    };
+    void setRepeat(const RepeatOptions& options);
+
+    // called by the input.device handler at interrupt level
+    void queueKeyEvents(InputEvent* events);
+
 private:
     Input() = default;
 
     void initialize();
 
+    bool openGameport();
+    void closeGameport();
+    bool addInputHandler();
+    void removeInputHandler();
+    void drainKeyEvents();
+    void dispatchKeyboard(IntuiMessage* msg);
+    void deliverKeyboard(IntuiMessage* msg);
+    void dispatchJoystick(JoystickEvent* event);
+
+    void pressRepeat(ULONG token);
+    void releaseRepeat(ULONG token);
+    void scheduleRepeat();
+    void fireRepeat();
+
 private:
     const Graphics* mGraphics = nullptr;
 
     MsgPort* mInputPort = nullptr;
-    IORequest* mInputRequest = nullptr;
-    InputEvent mGameEvent;
-    JoystickEvent mJoystickEvent;
-
-    struct KeyboardEntry
+    // several reads stay queued with gameport.device so transitions that
+    // happen while we're busy aren't lost, the first request owns the unit
+    static constexpr int ReadCount = 4;
+    struct GameRead
     {
-        ULONG id;
-        trost::Function<void(IntuiMessage*)> handler;
+        IORequest* request;
+        InputEvent event;
     };
-    Vector<KeyboardEntry> mKeyboards;
+    GameRead mReads[ReadCount] = {};
+    JoyDirection mDirections = JoyDirection::None;
+
+    SlotMap<trost::Function<void(IntuiMessage*)>> mKeyboards;
     ULONG mExclusiveKeyboard = 0;
 
-    struct JoystickEntry
-    {
-        ULONG id;
-        trost::Function<void(JoystickEvent*)> handler;
-    };
-    Vector<JoystickEntry> mJoysticks;
+    SlotMap<trost::Function<void(JoystickEvent*)>> mJoysticks;
     ULONG mExclusiveJoystick = 0;
 
-    ULONG mNextKeyboardId = 0, mNextJoystickId = 0;
     ULONG mMessageId = 0;
 
+    // keyboard events queued by the input.device handler, drained on the
+    // main task whenever the handler signals mHandlerSignal
+    struct KeyEvent
+    {
+        UWORD code;
+        UWORD qualifier;
+        ULONG seconds;
+        ULONG micros;
+    };
+    RingBuffer<KeyEvent, 64> mKeyEvents;
+    MsgPort* mHandlerPort = nullptr;
+    IOStdReq* mHandlerRequest = nullptr;
+    Interrupt mHandlerInterrupt;
+    Task* mHandlerTask = nullptr;
+    BYTE mHandlerSignal = -1;
+
+    // App timer aimed at the next repeat, 0 while nothing is held
+    ULONG mRepeatTimer = 0;
+    Repeater mRepeater;
+    RepeatOptions mRepeatOptions;
+    UWORD mRepeatQualifier = 0;
+
     static Input* sInstance;
 };
 
+// buffer is what was typed, key the same as a collation key ready for
+// DB::find
 struct KeyInput
 {
     char buffer[128];
     int length;
+    char key[128];
+    int keyLength;
 };
 
 struct KeyInputOptions
@@ -104,7 +171,10 @@ struct KeyInputOptions
     int messageLength = 0;
 };
 
-bool acquireKeyInput(const KeyInputOptions& options, KeyInput* input);
+// shows a text field and returns right away with the id of the App task
+// driving it. done is called from the main loop with the text, or with
+// nullptr if the prompt was cancelled. App::removeTask closes it early
+ULONG acquireKeyInput(const KeyInputOptions& options, Function<void(const KeyInput*)>&& done);
 
 template<>
 struct EnableBitMaskOperators<Input::JoyDirection>
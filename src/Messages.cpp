@@ -1,4 +1,5 @@
 #include "Messages.h"
+#include "App.h"
 #include <clib/exec_protos.h>
 
 using namespace trost;
@@ -14,6 +15,9 @@ void Messages::initialize(const Graphics* graphics)
     sInstance = new Messages();
     sInstance->mGraphics = graphics;
     sInstance->mUserPort = graphics->window->UserPort;
+    App::instance()->addSignal(sInstance->mUserPort->mp_SigBit, [that = sInstance]() -> void {
+        that->processMessages();
+    });
 }
 
 void Messages::cleanup()
@@ -22,6 +26,7 @@ void Messages::cleanup()
         return;
     }
 
+    App::instance()->removeSignal(sInstance->mUserPort->mp_SigBit);
     delete sInstance;
     sInstance = nullptr;
 }
@@ -33,20 +38,83 @@ Messages* Messages::instance()
 
 ULONG Messages::addHandler(ULONG clazz, trost::Function<void(IntuiMessage*)>&& handler)
 {
-    ULONG id = mNextId++;
-    mHandlers.push_back({ id, clazz, std::move(handler) });
+    const auto id = mHandlers.insert({ clazz, false, std::move(handler) });
+    if (!id) {
+        return 0;
+    }
+    for (UBYTE bit = 0; bit < 32; ++bit) {
+        if (clazz & (1UL << bit)) {
+            mBuckets[bit].push_back(id);
+        }
+    }
+    updateIDCMP();
     return id;
 }
 
 void Messages::removeHandler(ULONG id)
 {
-    const auto sz = mHandlers.size();
-    for (std::size_t i = 0; i < sz; ++i) {
-        if (mHandlers[i].id == id) {
-            mHandlers.remove_at(i);
-            return;
+    const auto entry = mHandlers.get(id);
+    if (!entry || entry->removed) {
+        return;
+    }
+
+    // a handler can remove itself or others while a message is being
+    // dispatched, the buckets and the handler that's running have to stay
+    // put until it's done
+    if (mDispatching) {
+        entry->removed = true;
+        mRemoved.push_back(id);
+        return;
+    }
+    eraseHandler(id, entry->clazz);
+}
+
+void Messages::eraseHandler(ULONG id, ULONG clazz)
+{
+    for (UBYTE bit = 0; bit < 32; ++bit) {
+        if (!(clazz & (1UL << bit))) {
+            continue;
+        }
+        auto& bucket = mBuckets[bit];
+        const auto sz = bucket.size();
+        for (std::size_t i = 0; i < sz; ++i) {
+            if (bucket[i] == id) {
+                bucket.remove_at(i);
+                break;
+            }
+        }
+    }
+    mHandlers.erase(id);
+    updateIDCMP();
+}
+
+void Messages::updateIDCMP()
+{
+    ULONG classes = 0;
+    for (UBYTE bit = 0; bit < 32; ++bit) {
+        if (mBuckets[bit].size() > 0) {
+            classes |= 1UL << bit;
         }
     }
+    if (classes == mSubscribed) {
+        return;
+    }
+    mSubscribed = classes;
+
+    auto window = mGraphics->window;
+    if (classes) {
+        ModifyIDCMP(window, classes);
+        return;
+    }
+
+    // clearing the IDCMP would make Intuition free the user port, which
+    // is ours, so hide it for the duration. anything already queued stays
+    // there and is replied to as usual
+    Forbid();
+    window->UserPort = nullptr;
+    ModifyIDCMP(window, 0);
+    window->UserPort = mUserPort;
+    Permit();
 }
 
 UBYTE Messages::sigBit() const
@@ -54,37 +122,54 @@ UBYTE Messages::sigBit() const
     return mUserPort->mp_SigBit;
 }
 
+void Messages::dispatch(IntuiMessage* msg)
+{
+    // IDCMP classes are single bits
+    const auto bit = __builtin_ctzl(msg->Class);
+    const auto& bucket = mBuckets[bit];
+    // handlers added on the way only get the next message
+    const auto sz = bucket.size();
+    ++mDispatching;
+    for (std::size_t i = 0; i < sz; ++i) {
+        const auto entry = mHandlers.get(bucket[i]);
+        if (entry && !entry->removed) {
+            entry->handler(msg);
+        }
+    }
+    if (--mDispatching == 0 && mRemoved.size() > 0) {
+        // erasing can't add more, there's nothing being dispatched
+        const auto removed = std::move(mRemoved);
+        for (std::size_t i = 0; i < removed.size(); ++i) {
+            if (const auto entry = mHandlers.get(removed[i])) {
+                eraseHandler(removed[i], entry->clazz);
+            }
+        }
+    }
+}
+
 void Messages::processMessages()
 {
     IntuiMessage* msg;
-    while ((msg = reinterpret_cast<IntuiMessage*>(GetMsg(mGraphics->window->UserPort))) != nullptr) {
-        const auto sz = mHandlers.size();
-        for (std::size_t i = 0; i < sz; ++i) {
-            auto& entry = mHandlers[i];
-            if (entry.clazz == msg->Class) {
-                entry.handler(msg);
-            }
+    while ((msg = reinterpret_cast<IntuiMessage*>(GetMsg(mUserPort))) != nullptr) {
+        if (msg->Class) {
+            dispatch(msg);
         }
         ReplyMsg((struct Message*)msg);
     }
 }
 
-void Messages::processOneMessage(ULONG clazz)
+bool Messages::processOneMessage(ULONG clazz)
 {
     IntuiMessage* msg;
-    WaitPort(mGraphics->window->UserPort);
-    while ((msg = reinterpret_cast<IntuiMessage*>(GetMsg(mGraphics->window->UserPort))) != nullptr) {
-        const auto sz = mHandlers.size();
-        for (std::size_t i = 0; i < sz; ++i) {
-            auto& entry = mHandlers[i];
-            if (entry.clazz == msg->Class) {
-                entry.handler(msg);
-                if (entry.clazz == clazz) {
-                    ReplyMsg((struct Message*)msg);
-                    return;
-                }
-            }
+    while ((msg = reinterpret_cast<IntuiMessage*>(GetMsg(mUserPort))) != nullptr) {
+        const bool found = (msg->Class & clazz) != 0;
+        if (msg->Class) {
+            dispatch(msg);
         }
         ReplyMsg((struct Message*)msg);
+        if (found) {
+            return true;
+        }
     }
+    return false;
 }
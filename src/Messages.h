@@ -2,6 +2,7 @@
 
 #include "Graphics.h"
 #include "util/Function.h"
+#include "util/SlotMap.h"
 #include "util/Vector.h"
 #include <clib/intuition_protos.h>
 
@@ -15,29 +16,43 @@ public:
 
     static Messages* instance();
 
+    // clazz is a mask of IDCMP classes, the window is subscribed to
+    // exactly the classes that have at least one handler. 0 if there's no
+    // room for another
     ULONG addHandler(ULONG clazz, trost::Function<void(IntuiMessage*)>&& handler);
     void removeHandler(ULONG id);
 
     void processMessages();
-    void processOneMessage(ULONG clazz);
+    // doesn't wait, returns true once a message of clazz was handled
+    bool processOneMessage(ULONG clazz);
 
     UBYTE sigBit() const;
 
 private:
     Messages() = default;
 
+    void dispatch(IntuiMessage* msg);
+    void eraseHandler(ULONG id, ULONG clazz);
+    void updateIDCMP();
+
     const Graphics* mGraphics = nullptr;
     MsgPort* mUserPort = nullptr;
 
     struct Entry
     {
-        ULONG id;
         ULONG clazz;
+        // removed while dispatching, erased once that's done
+        bool removed;
         trost::Function<void(IntuiMessage*)> handler;
     };
 
-    Vector<Entry> mHandlers;
-    ULONG mNextId = 0;
+    SlotMap<Entry> mHandlers;
+    int mDispatching = 0;
+    Vector<ULONG> mRemoved;
+
+    // handler ids per IDCMP class bit
+    Vector<ULONG> mBuckets[32];
+    ULONG mSubscribed = 0;
 
     static Messages* sInstance;
 };
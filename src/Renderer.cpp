@@ -1,4 +1,5 @@
 #include "Renderer.h"
+#include "App.h"
 #include "Messages.h"
 #include <clib/alib_protos.h>
 #include <clib/exec_protos.h>
@@ -9,14 +10,14 @@ using namespace trost;
 
 Renderer* Renderer::sInstance = nullptr;
 
-bool Renderer::initialize()
+bool Renderer::initialize(UWORD bufferCount)
 {
     if (sInstance) {
         return true;
     }
 
     sInstance = new Renderer();
-    sInstance->mStacks.push_back(Stack {});
+    sInstance->mStacks.push_back(0);
     auto graphics = &sInstance->mGraphics;
 
     graphics->screen = OpenScreenTags(NULL,
@@ -30,7 +31,9 @@ bool Renderer::initialize()
                                      TAG_DONE);
     if (!graphics->screen) {
         printf("Failed to open screen\n");
-        return 1;
+        delete sInstance;
+        sInstance = nullptr;
+        return false;
     }
 
     graphics->window = OpenWindowTags(NULL,
@@ -38,7 +41,7 @@ bool Renderer::initialize()
                                      WA_Top,         0,
                                      WA_Width,       320,
                                      WA_Height,      256,
-                                     WA_IDCMP,       IDCMP_RAWKEY,
+                                     WA_IDCMP,       0,
                                      WA_Flags,       WFLG_SIMPLE_REFRESH |
                                      WFLG_BACKDROP |
                                      WFLG_BORDERLESS |
@@ -48,30 +51,63 @@ bool Renderer::initialize()
     if (!graphics->window) {
         printf("Failed to open window\n");
         CloseScreen(graphics->screen);
-        return 1;
+        delete sInstance;
+        sInstance = nullptr;
+        return false;
     }
 
-    //sInstance->mUserPort = CreateMsgPort();
-    //graphics->window->UserPort = sInstance->mUserPort;
-    sInstance->mUserPort = graphics->window->UserPort;
+    // the window is opened without any IDCMP classes so we can hand it our
+    // own port, Messages subscribes to classes as handlers are added
+    sInstance->mUserPort = CreateMsgPort();
+    graphics->window->UserPort = sInstance->mUserPort;
 
     // Your drawing logic or other code here
     SetRGB4(&(graphics->screen->ViewPort), 0, 15, 0, 0);
     // set pen color to white
     SetRGB4(&(graphics->screen->ViewPort), 1, 15, 15, 15);
 
-    sInstance->mBuffers[0] = AllocScreenBuffer(graphics->screen, nullptr, SB_SCREEN_BITMAP);
-    sInstance->mBuffers[1] = AllocScreenBuffer(graphics->screen, nullptr, SB_COPY_BITMAP);
-    sInstance->mBuffers[0]->sb_DBufInfo->dbi_UserData1 = reinterpret_cast<APTR>(0);
-    sInstance->mBuffers[1]->sb_DBufInfo->dbi_UserData1 = reinterpret_cast<APTR>(1);
+    if (bufferCount < 2) {
+        bufferCount = 2;
+    } else if (bufferCount > MaxBuffers) {
+        bufferCount = MaxBuffers;
+    }
 
-    InitRastPort(&sInstance->mRastPorts[0]);
-    sInstance->mRastPorts[0].BitMap = sInstance->mBuffers[0]->sb_BitMap;
+    for (UWORD i = 0; i < bufferCount; ++i) {
+        auto buffer = AllocScreenBuffer(graphics->screen, nullptr, i == 0 ? SB_SCREEN_BITMAP : SB_COPY_BITMAP);
+        if (!buffer) {
+            if (i < 2) {
+                printf("Failed to allocate screen buffer\n");
+                for (UWORD j = i; j > 0; --j) {
+                    FreeScreenBuffer(graphics->screen, sInstance->mBuffers[j - 1]);
+                }
+                graphics->window->UserPort = nullptr;
+                CloseWindow(graphics->window);
+                CloseScreen(graphics->screen);
+                if (sInstance->mUserPort) {
+                    DeleteMsgPort(sInstance->mUserPort);
+                }
+                delete sInstance;
+                sInstance = nullptr;
+                return false;
+            }
+            // run with what we got
+            printf("Failed to allocate screen buffer %u, using %u\n", i, i);
+            break;
+        }
+        buffer->sb_DBufInfo->dbi_UserData1 = reinterpret_cast<APTR>(static_cast<ULONG>(i));
 
-    InitRastPort(&sInstance->mRastPorts[1]);
-    sInstance->mRastPorts[1].BitMap = sInstance->mBuffers[1]->sb_BitMap;
+        sInstance->mBuffers[i] = buffer;
+        InitRastPort(&sInstance->mRastPorts[i]);
+        sInstance->mRastPorts[i].BitMap = buffer->sb_BitMap;
+        ++sInstance->mBufferCount;
+    }
+    // every buffer starts out wiped
+    sInstance->invalidate();
 
     sInstance->mDbufPort = CreateMsgPort();
+    App::instance()->addSignal(sInstance->mDbufPort->mp_SigBit, [that = sInstance]() -> void {
+        that->processDbuf();
+    });
 
     return true;
 }
@@ -88,18 +124,34 @@ const Graphics* Renderer::graphics() const
 
 bool Renderer::isWaiting() const
 {
-    return mStatus[mDraw] == RedrawStatus::Wait;
+    return mStatus[mDraw] != RedrawStatus::Redraw;
 }
 
 void Renderer::processDbuf()
 {
     struct Message *dbmsg;
     while ((dbmsg = GetMsg(mDbufPort))) {
-        ULONG buffer = reinterpret_cast<ULONG>(*(reinterpret_cast<APTR**>(dbmsg + 1)));
-        mStatus[buffer ^ 1] = RedrawStatus::Redraw;
+        // the safe message arrives once the buffer that was shown before
+        // this one can be written to again
+        const auto buffer = static_cast<UWORD>(reinterpret_cast<ULONG>(*(reinterpret_cast<APTR**>(dbmsg + 1))));
+        if (buffer != mShown) {
+            mStatus[mShown] = RedrawStatus::Redraw;
+            mShown = buffer;
+        }
+        mSwapPending = false;
     }
 }
 
+const Renderer::Stats& Renderer::stats() const
+{
+    return mStats;
+}
+
+void Renderer::resetStats()
+{
+    mStats = {};
+}
+
 UBYTE Renderer::sigBit() const
 {
     return mDbufPort->mp_SigBit;
@@ -107,9 +159,8 @@ UBYTE Renderer::sigBit() const
 
 void Renderer::render()
 {
-    // if there are no handlers or if there's nothing to do, just wait for a refresh
-    const auto& handlers = mStacks.back().entries;
-    if (handlers.size() == 0 || mStatus[mDraw] == RedrawStatus::Wait) {
+    // if there are no handlers, just wait for a refresh
+    if (mStacks.back() == 0) {
         WaitTOF();
         return;
     }
@@ -117,34 +168,45 @@ void Renderer::render()
     if (mStatus[mDraw] == RedrawStatus::Redraw) {
         // draw into the buffer
 
-        Context context{ &mRastPorts[mDraw] };
+        Context context{ &mRastPorts[mDraw], mDraw, mClear[mDraw] };
 
-        SetAPen(context.rastPort, 0);
-        RectFill(context.rastPort, 0, 0, mGraphics.screen->Width - 1, mGraphics.screen->Height - 1);
+        // only wipe the buffer when something asked for it, renderers
+        // are expected to overdraw their own area otherwise
+        if (mClear[mDraw]) {
+            SetAPen(context.rastPort, 0);
+            RectFill(context.rastPort, 0, 0, mGraphics.screen->Width - 1, mGraphics.screen->Height - 1);
+            mClear[mDraw] = false;
+        }
         SetAPen(context.rastPort, 1);
         SetBPen(context.rastPort, 0);
 
-        const auto sz = handlers.size();
+        const auto top = static_cast<UWORD>(mStacks.size() - 1);
+        const auto sz = mEntries.size();
         for (std::size_t i = 0; i < sz; ++i) {
-            auto& entry = handlers[i];
-            entry.handler(&context);
+            auto& entry = mEntries[i];
+            if (entry.stack == top) {
+                entry.handler(&context);
+            }
         }
 
         mStatus[mDraw] = RedrawStatus::Swapin;
-        mDraw ^= 1;
-    }
-
-    if (mStatus[mSwap] == RedrawStatus::Swapin) {
-        for (;;) {
-            mBuffers[mSwap]->sb_DBufInfo->dbi_SafeMessage.mn_ReplyPort = mDbufPort;
-            if (ChangeScreenBuffer(mGraphics.screen, mBuffers[mSwap]) != 0) {
-                mStatus[mSwap] = RedrawStatus::Wait;
-                mSwap ^= 1;
-                break;
-            } else {
-                WaitTOF();
-            }
+        mDraw = (mDraw + 1) % mBufferCount;
+        ++mStats.frames;
+    } else {
+        ++mStats.starved;
+    }
+
+    // only one swap can be in flight, the next one goes out when
+    // processDbuf sees the safe message for this one
+    if (mStatus[mSwap] == RedrawStatus::Swapin && !mSwapPending) {
+        mBuffers[mSwap]->sb_DBufInfo->dbi_SafeMessage.mn_ReplyPort = mDbufPort;
+        while (ChangeScreenBuffer(mGraphics.screen, mBuffers[mSwap]) == 0) {
+            WaitTOF();
+            ++mStats.stallTicks;
         }
+        mStatus[mSwap] = RedrawStatus::Wait;
+        mSwapPending = true;
+        mSwap = (mSwap + 1) % mBufferCount;
     }
 }
 
@@ -163,38 +225,47 @@ void Renderer::cleanup()
         return;
     }
 
-    // wait for all screen buffers to become available
-    while (that->mStatus[0] == RedrawStatus::Wait || that->mStatus[1] == RedrawStatus::Wait) {
+    // wait for the last swap to settle, then put buffer 0 back on
+    // screen and wait for that to settle as well
+    while (that->mSwapPending) {
         Wait(1 << that->mDbufPort->mp_SigBit);
         that->processDbuf();
     }
 
-    // change screen to show buffer 0
-    while (ChangeScreenBuffer(that->mGraphics.screen, that->mBuffers[0]) == 0) {
-        WaitTOF();
+    if (that->mShown != 0) {
+        that->mBuffers[0]->sb_DBufInfo->dbi_SafeMessage.mn_ReplyPort = that->mDbufPort;
+        while (ChangeScreenBuffer(that->mGraphics.screen, that->mBuffers[0]) == 0) {
+            WaitTOF();
+        }
+        that->mSwapPending = true;
+        while (that->mSwapPending) {
+            Wait(1 << that->mDbufPort->mp_SigBit);
+            that->processDbuf();
+        }
     }
 
-    // clear any dbuf messages
-    while (GetMsg(that->mDbufPort)) {
-        // just clear the messages
-    }
+    App::instance()->removeSignal(that->mDbufPort->mp_SigBit);
 
     Forbid();
 
-    ModifyIDCMP(that->mGraphics.window, 0);
+    // detach our port before clearing the IDCMP so Intuition
+    // doesn't try to free it
     StripIntuiMessages(that->mGraphics.window);
+    that->mGraphics.window->UserPort = nullptr;
+    ModifyIDCMP(that->mGraphics.window, 0);
 
     Permit();
 
     CloseWindow(that->mGraphics.window);
 
-    FreeScreenBuffer(that->mGraphics.screen, that->mBuffers[1]);
-    FreeScreenBuffer(that->mGraphics.screen, that->mBuffers[0]);
+    for (UWORD i = that->mBufferCount; i > 0; --i) {
+        FreeScreenBuffer(that->mGraphics.screen, that->mBuffers[i - 1]);
+    }
 
     CloseScreen(that->mGraphics.screen);
 
     DeleteMsgPort(that->mDbufPort);
-    //DeleteMsgPort(that->mUserPort);
+    DeleteMsgPort(that->mUserPort);
 
     delete sInstance;
     sInstance = nullptr;
@@ -202,32 +273,60 @@ void Renderer::cleanup()
 
 void Renderer::pushStack()
 {
-    mStacks.push_back(Stack{});
+    mStacks.push_back(0);
+    invalidate();
 }
 
 void Renderer::popStack()
 {
+    // drop whatever is still registered on the top stack
+    const auto top = static_cast<UWORD>(mStacks.size() - 1);
+    for (std::size_t i = mEntries.size(); i > 0; --i) {
+        if (mEntries[i - 1].stack == top) {
+            mEntries.eraseOrdered(mEntries.handleAt(i - 1));
+        }
+    }
     mStacks.pop_back();
+    invalidate();
+}
+
+void Renderer::invalidate()
+{
+    for (UWORD i = 0; i < mBufferCount; ++i) {
+        mClear[i] = true;
+    }
+}
+
+void Renderer::setColors(const UWORD* colors, UWORD first, UWORD count)
+{
+    auto vp = &mGraphics.screen->ViewPort;
+    for (UWORD i = 0; i < count; ++i) {
+        const auto rgb = colors[i];
+        SetRGB4(vp, first + i, (rgb >> 8) & 0xf, (rgb >> 4) & 0xf, rgb & 0xf);
+    }
 }
 
 ULONG Renderer::addRenderer(trost::Function<void(Context*)>&& handler)
 {
-    ULONG id = mNextId++;
-    mStacks.back().entries.push_back({ id, std::move(handler) });
+    const auto top = static_cast<UWORD>(mStacks.size() - 1);
+    const auto id = mEntries.insert({ top, std::move(handler) });
+    if (!id) {
+        return 0;
+    }
+    ++mStacks.back();
+    invalidate();
     return id;
 }
 
 void Renderer::removeRenderer(ULONG id)
 {
-    auto stackIdx = mStacks.size();
-    while (stackIdx > 0) {
-        auto& handlers = mStacks[--stackIdx].entries;
-        const auto sz = handlers.size();
-        for (std::size_t i = 0; i < sz; ++i) {
-            if (handlers[i].id == id) {
-                handlers.remove_at(i);
-                return;
-            }
-        }
+    const auto entry = mEntries.get(id);
+    if (!entry) {
+        return;
     }
+
+    --mStacks[entry->stack];
+    // draw order matters, keep it
+    mEntries.eraseOrdered(id);
+    invalidate();
 }
@@ -2,6 +2,7 @@
 
 #include "Graphics.h"
 #include "util/Function.h"
+#include "util/SlotMap.h"
 #include "util/Vector.h"
 #include <clib/intuition_protos.h>
 
@@ -10,7 +11,10 @@ namespace trost {
 class Renderer
 {
 public:
-    static bool initialize();
+    // bufferCount is the number of screen buffers to cycle through, with
+    // more than two the next frame can be drawn while one buffer is shown
+    // and another one is waiting to be swapped in
+    static bool initialize(UWORD bufferCount = 2);
     static void cleanup();
 
     static Renderer* instance();
@@ -18,10 +22,17 @@ public:
     // renders the current stack of renderers
     void render();
 
-    // manages renderers
+    static constexpr UWORD MaxBuffers = 4;
+
+    // manages renderers, buffer is the index of the screen buffer being
+    // drawn and cleared is true if that buffer was wiped before this frame.
+    // renderers that only draw what changed need to track their state
+    // per buffer and start over whenever cleared is set
     struct Context
     {
         RastPort* rastPort;
+        UWORD buffer;
+        bool cleared;
     };
     ULONG addRenderer(trost::Function<void(Context*)>&& handler);
     void removeRenderer(ULONG id);
@@ -31,39 +42,64 @@ public:
     void pushStack();
     void popStack();
 
+    // forces all buffers to be cleared before they're drawn next
+    void invalidate();
+
+    // loads count 0x0RGB colors into the pens starting at first
+    void setColors(const UWORD* colors, UWORD first, UWORD count);
+
     bool isWaiting() const;
     void processDbuf();
 
     const Graphics* graphics() const;
     UBYTE sigBit() const;
 
+    // frames is the number of frames drawn, stallTicks counts the
+    // vertical blanks spent waiting for ChangeScreenBuffer to succeed
+    // and starved counts render calls that found no buffer to draw into
+    struct Stats
+    {
+        ULONG frames;
+        ULONG stallTicks;
+        ULONG starved;
+    };
+    const Stats& stats() const;
+    void resetStats();
+
 private:
     Renderer() = default;
 
 private:
     Graphics mGraphics;
-    ScreenBuffer* mBuffers[2] = { nullptr, nullptr };
-    RastPort mRastPorts[2];
+    ScreenBuffer* mBuffers[MaxBuffers] = {};
+    RastPort mRastPorts[MaxBuffers];
+    UWORD mBufferCount = 0;
     MsgPort* mDbufPort = nullptr;
     MsgPort* mUserPort = nullptr;
 
     enum class RedrawStatus { Redraw, Swapin, Wait };
-    RedrawStatus mStatus[2] = { RedrawStatus::Redraw, RedrawStatus::Redraw };
+    // Redraw buffers are free, Swapin buffers are drawn and queued to be
+    // shown in ring order and Wait buffers are on screen or about to be
+    RedrawStatus mStatus[MaxBuffers] = {};
+    bool mClear[MaxBuffers] = {};
 
     UWORD mDraw = 0;
     UWORD mSwap = 0;
+    UWORD mShown = 0;
+    bool mSwapPending = false;
+
+    Stats mStats = {};
 
+    // renderers of all stacks live in one map so handles stay unique,
+    // stack is the depth the renderer was added at
     struct Entry
     {
-        ULONG id;
+        UWORD stack;
         trost::Function<void(Context*)> handler;
     };
-    struct Stack
-    {
-        Vector<Entry> entries;
-    };
-    Vector<Stack> mStacks;
-    ULONG mNextId = 0;
+    SlotMap<Entry> mEntries;
+    // number of renderers on each stack
+    Vector<ULONG> mStacks;
 
     static Renderer* sInstance;
 };
@@ -0,0 +1,220 @@
+#include "TextField.h"
+#include "App.h"
+#include <clib/keymap_protos.h>
+#include <clib/graphics_protos.h>
+#include <cstring>
+
+using namespace trost;
+
+// milliseconds the cursor stays on or off
+static constexpr ULONG BlinkInterval = 500;
+
+TextField::TextField(const Rect& rect, const char* message, int messageLength)
+    : mRect(rect), mMessage(message), mMessageLength(messageLength)
+{
+    if (mMessage && !mMessageLength) {
+        mMessageLength = strlen(mMessage);
+    }
+    mBuffer[0] = '\0';
+    for (auto& shown : mShown) {
+        shown.length = 0;
+        shown.cursor = 0;
+        shown.cursorVisible = false;
+        shown.valid = false;
+    }
+    restartBlink();
+}
+
+TextField::~TextField()
+{
+    App::instance()->removeTimer(mBlinkTimer);
+}
+
+void TextField::restartBlink()
+{
+    auto app = App::instance();
+    app->removeTimer(mBlinkTimer);
+    mCursorOn = true;
+    mBlinkTimer = app->addPeriodicTimer(BlinkInterval, [this]() -> void {
+        mCursorOn = !mCursorOn;
+    });
+}
+
+TextField::Result TextField::handleKey(IntuiMessage* msg)
+{
+    static auto keymap = AskKeyMapDefault();
+
+    const auto code = msg->Code;
+    if (code & IECODE_UP_PREFIX) {
+        return Result::None;
+    }
+
+    switch (code) {
+    case 0x45: // Escape key
+        return Result::Cancel;
+    case 0x44: // Enter key
+        return Result::Accept;
+    case 0x41: // Backspace key
+        if (mCursor == 0) {
+            return Result::None;
+        }
+        memmove(mBuffer + mCursor - 1, mBuffer + mCursor, mLength - mCursor + 1);
+        --mCursor;
+        --mLength;
+        break;
+    case 0x46: // Delete key
+        if (mCursor == mLength) {
+            return Result::None;
+        }
+        memmove(mBuffer + mCursor, mBuffer + mCursor + 1, mLength - mCursor);
+        --mLength;
+        break;
+    case 0x4F: // Cursor left
+        if (mCursor == 0) {
+            return Result::None;
+        }
+        --mCursor;
+        break;
+    case 0x4E: // Cursor right
+        if (mCursor == mLength) {
+            return Result::None;
+        }
+        ++mCursor;
+        break;
+    default: {
+        InputEvent ie;
+        char output[10];
+        ie.ie_Class = IECLASS_RAWKEY;
+        ie.ie_SubClass = 0;
+        ie.ie_Code = code;
+        ie.ie_Qualifier = msg->Qualifier;
+        ie.ie_EventAddress = NULL;
+        if (MapRawKey(&ie, (STRPTR)output, sizeof(output), keymap) <= 0) {
+            // map failed, should surface this somehow
+            return Result::None;
+        }
+        const char ch = output[0];
+        if (mLength >= MaxLength || ch < 32 || ch > 126) {
+            return Result::None;
+        }
+        memmove(mBuffer + mCursor + 1, mBuffer + mCursor, mLength - mCursor + 1);
+        mBuffer[mCursor++] = ch;
+        ++mLength;
+        break; }
+    }
+
+    // keep the cursor solid while typing
+    restartBlink();
+    return Result::Changed;
+}
+
+int TextField::columns(RastPort* rp) const
+{
+    // there's no layer to clip for us, anything past the bitmap's edge
+    // would land in whatever memory follows the row
+    long right = rp->BitMap->BytesPerRow * 8;
+    if (mRect.w && mRect.x + static_cast<long>(mRect.w) < right) {
+        right = mRect.x + static_cast<long>(mRect.w);
+    }
+    const long cells = (right - mRect.x) / rp->TxWidth;
+    if (cells <= 0) {
+        return 0;
+    }
+    return cells > MaxLength + 1 ? MaxLength + 1 : static_cast<int>(cells);
+}
+
+void TextField::drawCells(RastPort* rp, const char* text, int start, int end)
+{
+    const auto visible = columns(rp);
+    if (end > visible) {
+        end = visible;
+    }
+    if (start >= end) {
+        return;
+    }
+    Move(rp, mRect.x + start * rp->TxWidth, mRect.y + 20);
+    Text(rp, text + start, end - start);
+}
+
+void TextField::drawCursor(RastPort* rp, int pos)
+{
+    if (pos >= columns(rp)) {
+        return;
+    }
+    const long x = mRect.x + pos * rp->TxWidth;
+    const long bottom = mRect.y + 20 - rp->TxBaseline + rp->TxHeight - 1;
+    SetAPen(rp, 1);
+    RectFill(rp, x, bottom - 1, x + rp->TxWidth - 1, bottom);
+}
+
+void TextField::render(Renderer::Context* ctx)
+{
+    auto rp = ctx->rastPort;
+    auto& shown = mShown[ctx->buffer];
+
+    if (ctx->cleared || !shown.valid) {
+        const auto visible = columns(rp);
+        if (!ctx->cleared && visible > 0) {
+            // wipe our line, the rest of the buffer belongs to someone else
+            const long top = mRect.y + 20 - rp->TxBaseline;
+            SetAPen(rp, 0);
+            RectFill(rp, mRect.x, top, mRect.x + visible * rp->TxWidth - 1, top + rp->TxHeight - 1);
+            SetAPen(rp, 1);
+        }
+        if (mMessage && visible > 0) {
+            Move(rp, mRect.x, mRect.y);
+            Text(rp, mMessage, mMessageLength < visible ? mMessageLength : visible);
+        }
+        shown.length = 0;
+        shown.cursorVisible = false;
+        shown.valid = true;
+    }
+
+    const bool cursorVisible = mCursorOn;
+
+    // cells past the end of either string compare as blanks, a blank
+    // drawn with JAM2 erases whatever glyph was there before
+    char line[MaxLength + 2];
+    const int cells = (mLength > shown.length ? mLength : shown.length) + 1;
+    memcpy(line, mBuffer, mLength);
+    memset(line + mLength, ' ', cells - mLength);
+
+    bool cursorDamaged = false;
+    int run = -1;
+    for (int i = 0; i <= cells; ++i) {
+        bool changed = false;
+        if (i < cells) {
+            const char old = i < shown.length ? shown.text[i] : ' ';
+            changed = old != line[i];
+            // the cursor bar lives in its cell, hiding or moving it means
+            // putting the glyph back
+            if (!changed && shown.cursorVisible && i == shown.cursor
+                && (!cursorVisible || shown.cursor != mCursor)) {
+                changed = true;
+            }
+        }
+        if (changed) {
+            if (run < 0) {
+                run = i;
+            }
+            if (i == shown.cursor) {
+                cursorDamaged = true;
+            }
+        } else if (run >= 0) {
+            drawCells(rp, line, run, i);
+            run = -1;
+        }
+    }
+
+    if (cursorDamaged) {
+        shown.cursorVisible = false;
+    }
+    if (cursorVisible && (!shown.cursorVisible || shown.cursor != mCursor)) {
+        drawCursor(rp, mCursor);
+        shown.cursorVisible = true;
+    }
+
+    memcpy(shown.text, mBuffer, mLength);
+    shown.length = mLength;
+    shown.cursor = mCursor;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Rect.h"
+#include "Renderer.h"
+#include <clib/intuition_protos.h>
+
+namespace trost {
+
+// single line text input that only redraws the glyph cells that changed
+// since the last time each screen buffer was drawn
+class TextField
+{
+public:
+    static constexpr int MaxLength = 127;
+
+    TextField(const Rect& rect, const char* message = nullptr, int messageLength = 0);
+    ~TextField();
+
+    TextField(const TextField&) = delete;
+    TextField& operator=(const TextField&) = delete;
+
+    enum class Result {
+        None,
+        Changed,
+        Accept,
+        Cancel,
+    };
+
+    Result handleKey(IntuiMessage* msg);
+
+    void render(Renderer::Context* ctx);
+
+    const char* buffer() const;
+    int length() const;
+
+private:
+    // cells that fit in the field and on the bitmap, everything drawn is
+    // kept to those. a field without a width runs to the bitmap's edge
+    int columns(RastPort* rp) const;
+    void drawCells(RastPort* rp, const char* text, int start, int end);
+    void drawCursor(RastPort* rp, int pos);
+    void restartBlink();
+
+private:
+    Rect mRect;
+    const char* mMessage;
+    int mMessageLength;
+
+    char mBuffer[MaxLength + 1];
+    int mLength = 0;
+    int mCursor = 0;
+    bool mCursorOn = true;
+    ULONG mBlinkTimer = 0;
+
+    // what's currently on screen in each buffer
+    struct Shown
+    {
+        char text[MaxLength + 1];
+        int length;
+        int cursor;
+        bool cursorVisible;
+        bool valid;
+    };
+    Shown mShown[Renderer::MaxBuffers];
+};
+
+inline const char* TextField::buffer() const
+{
+    return mBuffer;
+}
+
+inline int TextField::length() const
+{
+    return mLength;
+}
+
+} // namespace trost
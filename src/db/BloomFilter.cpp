@@ -0,0 +1,105 @@
+#include "BloomFilter.h"
+#include "PerfectHash.h"
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+using namespace trost;
+
+BloomFilter::~BloomFilter()
+{
+    release();
+}
+
+BloomFilter::BloomFilter(BloomFilter&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+BloomFilter& BloomFilter::operator=(BloomFilter&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        mData = other.mData;
+        mBytes = other.mBytes;
+        mHashes = other.mHashes;
+        other.mData = nullptr;
+        other.mBytes = 0;
+        other.mHashes = 0;
+    }
+    return *this;
+}
+
+void BloomFilter::size(std::uint32_t count, std::uint16_t perMille, std::uint32_t* bytes, std::uint8_t* hashes)
+{
+    if (!perMille || perMille >= 1000) {
+        *bytes = 0;
+        *hashes = 0;
+        return;
+    }
+    // nothing in it, a cleared byte turns everything down
+    if (!count) {
+        *bytes = 1;
+        *hashes = 1;
+        return;
+    }
+    // m = -n ln p / ln(2)^2 and k = m / n ln 2
+    const double ln2 = 0.6931471805599453;
+    const double bits = -static_cast<double>(count) * std::log(perMille / 1000.0) / (ln2 * ln2);
+    const double k = bits / count * ln2 + 0.5;
+    *bytes = static_cast<std::uint32_t>(bits / 8) + 1;
+    *hashes = k < 1 ? 1 : (k > 16 ? 16 : static_cast<std::uint8_t>(k));
+}
+
+bool BloomFilter::allocate(std::uint32_t bytes, std::uint8_t hashes)
+{
+    release();
+    if (!bytes || !hashes) {
+        return true;
+    }
+    mData = new std::uint8_t[bytes];
+    if (!mData) {
+        return false;
+    }
+    memset(mData, 0, bytes);
+    mBytes = bytes;
+    mHashes = hashes;
+    return true;
+}
+
+void BloomFilter::release()
+{
+    delete[] mData;
+    mData = nullptr;
+    mBytes = 0;
+    mHashes = 0;
+}
+
+void BloomFilter::add(const char* name, std::size_t length)
+{
+    if (!mData) {
+        return;
+    }
+    const auto key = PerfectHash::hash(name, length);
+    const auto bits = mBytes * 8;
+    for (std::uint8_t i = 0; i < mHashes; ++i) {
+        const auto bit = (key.bucket + i * key.slot) % bits;
+        mData[bit >> 3] |= 1 << (bit & 7);
+    }
+}
+
+bool BloomFilter::mayContain(const char* name, std::size_t length) const
+{
+    if (!mData) {
+        return true;
+    }
+    const auto key = PerfectHash::hash(name, length);
+    const auto bits = mBytes * 8;
+    for (std::uint8_t i = 0; i < mHashes; ++i) {
+        const auto bit = (key.bucket + i * key.slot) % bits;
+        if (!(mData[bit >> 3] & (1 << (bit & 7)))) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace trost {
+
+// Bloom filter over collation keys. The letter files add every prefix of
+// every key so a prefix search can be turned down without touching the
+// disk. Positions come from the two hashes PerfectHash::hash makes,
+// combined as a + i * b.
+class BloomFilter
+{
+public:
+    BloomFilter() = default;
+    ~BloomFilter();
+
+    BloomFilter(BloomFilter&& other) noexcept;
+    BloomFilter& operator=(BloomFilter&& other) noexcept;
+
+    BloomFilter(const BloomFilter&) = delete;
+    BloomFilter& operator=(const BloomFilter&) = delete;
+
+    // bytes and hash count for count keys at a false positive rate of
+    // perMille / 1000, 0 bytes if perMille asks for no filter at all
+    static void size(std::uint32_t count, std::uint16_t perMille, std::uint32_t* bytes, std::uint8_t* hashes);
+
+    // all clear, bytes can be 0 for a filter that lets everything through
+    bool allocate(std::uint32_t bytes, std::uint8_t hashes);
+    void release();
+
+    void add(const char* name, std::size_t length);
+    bool mayContain(const char* name, std::size_t length) const;
+
+    bool isValid() const;
+    std::uint32_t bytes() const;
+    std::uint8_t hashes() const;
+    std::uint8_t* data();
+    const std::uint8_t* data() const;
+
+private:
+    std::uint8_t* mData = nullptr;
+    std::uint32_t mBytes = 0;
+    std::uint8_t mHashes = 0;
+};
+
+inline bool BloomFilter::isValid() const
+{
+    return mData != nullptr;
+}
+
+inline std::uint32_t BloomFilter::bytes() const
+{
+    return mBytes;
+}
+
+inline std::uint8_t BloomFilter::hashes() const
+{
+    return mHashes;
+}
+
+inline std::uint8_t* BloomFilter::data()
+{
+    return mData;
+}
+
+inline const std::uint8_t* BloomFilter::data() const
+{
+    return mData;
+}
+
+} // namespace trost
@@ -0,0 +1,191 @@
+#include "Cursor.h"
+#include <utility>
+
+using namespace trost;
+
+Cursor::Cursor(DB* db, int window)
+    : mDB(db), mWindow(window > 0 ? window : 1)
+{
+}
+
+Cursor::~Cursor()
+{
+    reset();
+}
+
+std::uint32_t Cursor::span() const
+{
+    const auto left = mSize - mPosition;
+    return left < static_cast<std::uint32_t>(mWindow) ? left : static_cast<std::uint32_t>(mWindow);
+}
+
+DB::Id Cursor::idAt(std::uint32_t position) const
+{
+    return mOrdered ? mOrder.at(mFirst + position) : mFirst + position;
+}
+
+bool Cursor::start(DB::Id first)
+{
+    reset();
+    const auto count = mDB->entryCount();
+    if (first >= count) {
+        return false;
+    }
+    mFirst = first;
+    mSize = count - first;
+    load(0, 0, false);
+    return true;
+}
+
+bool Cursor::start(Order&& order, std::uint32_t first)
+{
+    reset();
+    // an order from before the index was rebuilt may name ids that are
+    // gone, it ends at the first of those like DB::entries() does
+    const auto count = mDB->entryCount();
+    std::uint32_t size = 0;
+    while (size < order.size() && order.at(size) < count) {
+        ++size;
+    }
+    if (first >= size) {
+        return false;
+    }
+    mOrder = std::move(order);
+    mOrdered = true;
+    mFirst = first;
+    mSize = size - first;
+    load(0, 0, false);
+    return true;
+}
+
+void Cursor::reset()
+{
+    const bool loading = cancel();
+    const auto count = span();
+    for (std::uint32_t i = 0; i < count; ++i) {
+        const auto p = mPosition + i;
+        if (holds(mPosition, count, loading, p)) {
+            mDB->dispose(idAt(p), 1);
+        }
+    }
+    mMissing = Vector<DB::Id>();
+    mOrder.release();
+    mOrdered = false;
+    mFirst = 0;
+    mSize = 0;
+    mPosition = 0;
+}
+
+void Cursor::setAsync(Function<void()>&& changed)
+{
+    mChanged = std::move(changed);
+    mAsync = true;
+}
+
+void Cursor::seek(std::uint32_t position)
+{
+    if (mSize > static_cast<std::uint32_t>(mWindow) && position > mSize - mWindow) {
+        position = mSize - mWindow;
+    } else if (mSize <= static_cast<std::uint32_t>(mWindow)) {
+        position = 0;
+    }
+    if (position == mPosition) {
+        return;
+    }
+
+    // whatever was loading is asked for again along with the new ones
+    const bool loading = cancel();
+    const auto from = mPosition;
+    const auto count = span();
+    mPosition = position;
+    const auto next = span();
+    for (std::uint32_t i = 0; i < count; ++i) {
+        const auto p = from + i;
+        if ((p < position || p >= position + next) && holds(from, count, loading, p)) {
+            mDB->dispose(idAt(p), 1);
+        }
+    }
+    load(from, count, loading);
+}
+
+void Cursor::scroll(long delta)
+{
+    if (delta < 0 && static_cast<std::uint32_t>(-delta) > mPosition) {
+        seek(0);
+    } else {
+        seek(static_cast<std::uint32_t>(mPosition + delta));
+    }
+}
+
+const DB::Entry* Cursor::at(std::uint32_t position) const
+{
+    if (position < mPosition || position - mPosition >= span()) {
+        return nullptr;
+    }
+    // not ours until its load is done, even if someone else has it
+    if (mJob && pending(idAt(position))) {
+        return nullptr;
+    }
+    return mDB->entry(idAt(position));
+}
+
+bool Cursor::pending(DB::Id id) const
+{
+    for (std::size_t i = 0; i < mMissing.size(); ++i) {
+        if (mMissing[i] == id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Cursor::holds(std::uint32_t from, std::uint32_t count, bool loading, std::uint32_t position) const
+{
+    if (position < from || position - from >= count) {
+        return false;
+    }
+    return !loading || !pending(idAt(position));
+}
+
+void Cursor::load(std::uint32_t from, std::uint32_t count, bool loading)
+{
+    // everything in the window the cursor doesn't hold yet, the DB only
+    // reads the ones nobody else has loaded either
+    Vector<DB::Id> missing;
+    const auto span = this->span();
+    for (std::uint32_t i = 0; i < span; ++i) {
+        const auto p = mPosition + i;
+        if (!holds(from, count, loading, p)) {
+            missing.push_back(idAt(p));
+        }
+    }
+    mMissing = std::move(missing);
+    if (!mMissing.size()) {
+        return;
+    }
+
+    const auto size = static_cast<int>(mMissing.size());
+    if (!mAsync) {
+        mDB->hydrateIds(&mMissing[0], size);
+        mMissing = Vector<DB::Id>();
+        return;
+    }
+    // one job for everything in the window that isn't held yet
+    mJob = mDB->hydrateIdsAsync(&mMissing[0], size, [this]() -> void {
+        mJob = 0;
+        mMissing = Vector<DB::Id>();
+        if (mChanged) {
+            mChanged();
+        }
+    });
+}
+
+bool Cursor::cancel()
+{
+    if (!mJob) {
+        return false;
+    }
+    mDB->cancel(mJob);
+    mJob = 0;
+    return true;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "DB.h"
+#include "util/Function.h"
+#include "util/Vector.h"
+#include <cstdint>
+
+namespace trost {
+
+// Walks the ids in name order from some starting one, e.g. what find()
+// returned, or the ids of an Order from DB::order(), keeping the window
+// ones hydrated and nothing else. Entries are hydrated as they come into
+// the window and disposed as they leave it, so however far the walk goes
+// only the window's worth is ever around.
+//
+// Positions count from the starting one. The cursor holds every id in its
+// window once, see DB::hydrate, so whatever else hydrates or disposes the
+// same ids the entries at() hands out stay valid until they leave the
+// window.
+class Cursor
+{
+public:
+    Cursor(DB* db, int window);
+    ~Cursor();
+
+    Cursor(const Cursor&) = delete;
+    Cursor& operator=(const Cursor&) = delete;
+
+    // from id first on, 0 for all of them. false if there is no such id.
+    // the window starts at position 0 and is hydrated right away
+    bool start(DB::Id first);
+    // the same through order from its first-th id on, the cursor keeps it
+    // until the next start() or reset()
+    bool start(Order&& order, std::uint32_t first = 0);
+    // disposes the window and cancels whatever was loading
+    void reset();
+
+    // hydrates through the loader from now on, changed is called from the
+    // main loop whenever entries in the window have been filled in
+    void setAsync(Function<void()>&& changed);
+
+    // moves the window to start at position, as far as there are entries
+    // to fill it
+    void seek(std::uint32_t position);
+    void scroll(long delta);
+
+    // the entry at position if it's in the window and the cursor holds it
+    const DB::Entry* at(std::uint32_t position) const;
+    bool isLoading() const;
+
+    // positions there are, from the starting id to the last one
+    std::uint32_t size() const;
+    std::uint32_t position() const;
+    int window() const;
+
+private:
+    std::uint32_t span() const;
+    DB::Id idAt(std::uint32_t position) const;
+    // whether the window that started at from with count positions holds
+    // position, loading if the ones in mMissing were still on their way
+    bool holds(std::uint32_t from, std::uint32_t count, bool loading, std::uint32_t position) const;
+    bool pending(DB::Id id) const;
+    // asks for everything in the window the old one didn't hold
+    void load(std::uint32_t from, std::uint32_t count, bool loading);
+    // true if something was loading, none of which is held
+    bool cancel();
+
+    DB* mDB;
+    int mWindow;
+
+    // where position 0 is in name order, or in mOrder when there is one
+    std::uint32_t mFirst = 0;
+    Order mOrder;
+    bool mOrdered = false;
+    std::uint32_t mSize = 0;
+    std::uint32_t mPosition = 0;
+
+    bool mAsync = false;
+    Function<void()> mChanged;
+    std::uint32_t mJob = 0;
+    // the window's ids that were asked for and aren't held yet
+    Vector<DB::Id> mMissing;
+};
+
+inline bool Cursor::isLoading() const
+{
+    return mJob != 0;
+}
+
+inline std::uint32_t Cursor::size() const
+{
+    return mSize;
+}
+
+inline std::uint32_t Cursor::position() const
+{
+    return mPosition;
+}
+
+inline int Cursor::window() const
+{
+    return mWindow;
+}
+
+} // namespace trost
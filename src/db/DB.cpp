@@ -1,5 +1,18 @@
 #include "DB.h"
-#include <App.h>
+#include "BloomFilter.h"
+#include "EntrySet.h"
+#include "ExternalSort.h"
+#include "Format.h"
+#include "History.h"
+#include "Order.h"
+#include "PerfectHash.h"
+#include "Thumbnail.h"
+#include "util/Collation.h"
+#include "util/Vector.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
 
 using namespace trost;
 
@@ -8,19 +21,50 @@ using namespace trost;
 
   In the app directory there's a directory called "db" which contains one file per
   starting character (0.idx, A.idx - Z.idx) where each file contains a sorted list
-  of names where each name is followed by an index into a separate data.idx file that
-  contains an on disk linked list of entries. the first entry in the data.idx file
-  is a header that points to the first entry and each entry points to the next entry
-  in the list. Bitmaps are stored as .iff files in "db/bitmaps" with the name of the
-  bitmap being the same as the name of the entry in the data.idx file.
+  of names where each name is followed by the offset of its record in a separate
+  data.idx file. data.idx is a header followed by the records back to back in name
+  order, nothing in it points from one record to another. Bitmaps are stored as
+  .iff files in "db/bitmaps" named after the offset of the entry's record in
+  data.idx, so any name can have one.
+
+  The letter files don't hold the names as shown but their collation keys, upper
+  cased with accents and a leading "The" dropped (see util/Collation.h), and
+  everything is sorted by those. So "The Secret of Monkey Island" is in S.idx.
 
   This allows for fast lookups of entries by name, the find() function will return
-  the first entry that matches the name, or nullptr if no entry is found.
-  the Entry structure intially just contains the index and the app has to call the
-  hydrate() function to load the entry (and optionally a count of subsequent entries)
-  this will load the entry name, path and optionally a BitMap. BitMaps are cached
+  the id of the first entry that matches the name, or NoEntry if no entry is found. Whole
+  names can skip the letter files, exact() goes through a perfect hash in
+  exact.idx straight to the record.
+  Entries are known by id, their position in name order, and all that's kept
+  for one that isn't hydrated is its record offset in an array by id read from
+  ids.idx. The app calls hydrate() with an id (and optionally a count of
+  subsequent ones), which loads the entry name, path and optionally a BitMap
+  into an Entry that entry() hands out until it's disposed. BitMaps are cached
   separately in an LRU data structure so that going back and forth between pages
   don't incur loading the BitMap again.
+
+  Every record also carries a tiny downscaled copy of its thumbnail, so a page
+  can be drawn from the records alone and upgraded as the BitMaps arrive.
+
+  Nothing links one entry to the next, so how far the app walks doesn't
+  matter, only how many it keeps hydrated. Cursor.h keeps that to a window.
+
+  Besides name order there are orders by attribute, e.g. year, kept as arrays
+  of entry ids in orders.idx. order() reads one and entries() gives a page of
+  its ids to hydrate like any other, without the rest of the records ever
+  being read or sorted.
+
+  Every play is appended to history.log by id, see History.h, which recent()
+  and favourites() are made from. createIndex() moves the plays over to the
+  new ids by name.
+
+  createIndex() builds all of this from a games.txt in the db directory, one
+  "name<TAB>path<TAB>image<TAB>attributes" per line, the last two optional and
+  the attributes as "year=1991; genre=Platform". When the image is given it's scaled down
+  and quantized to a palette shared by every thumbnail, chosen over all of them,
+  so a page of thumbnails fits on one screen. hydrateAsync() does the same work as hydrate() on a
+  separate loader process so the display keeps running while the disk is busy,
+  see Loader.h.
 */
 
 DB::DB(const String& dir)
@@ -28,22 +72,1763 @@ DB::DB(const String& dir)
 {
 }
 
-void DB::createIndex()
+DB::~DB()
+{
+    mLoader.stop();
+    clearEntries();
+}
+
+DB::Entry* DB::acquire(Id id)
+{
+    auto& slot = mSlots[id];
+    if (slot.entry) {
+        return mEntries[slot.entry - 1];
+    }
+    auto entry = new Entry();
+    entry->id = id;
+    entry->offset = slot.offset;
+    if (mFree.size() > 0) {
+        const auto index = mFree[mFree.size() - 1];
+        mFree.pop_back();
+        mEntries[index] = entry;
+        slot.entry = index + 1;
+    } else {
+        mEntries.push_back(entry);
+        slot.entry = static_cast<std::uint32_t>(mEntries.size());
+    }
+    return entry;
+}
+
+void DB::release(Id id)
+{
+    // the entry goes once the last holder lets go of it
+    if (id >= mSlots.size() || !mSlots[id].holds || --mSlots[id].holds || !mSlots[id].entry) {
+        return;
+    }
+    const auto index = mSlots[id].entry - 1;
+    delete mEntries[index];
+    mEntries[index] = nullptr;
+    mFree.push_back(index);
+    mSlots[id].entry = 0;
+}
+
+void DB::clearEntries()
+{
+    for (std::size_t i = 0; i < mEntries.size(); ++i) {
+        delete mEntries[i];
+    }
+    mEntries = Vector<Entry*>();
+    mFree = Vector<std::uint32_t>();
+    for (std::size_t i = 0; i < mSlots.size(); ++i) {
+        mSlots[i].entry = 0;
+        mSlots[i].holds = 0;
+    }
+}
+
+bool DB::openData()
+{
+    if (mData.isOpen()) {
+        return true;
+    }
+    char path[256];
+    return format::joinPath(path, sizeof(path), mDir.c_str(), "data.idx") && mData.open(path, File::Mode::Read);
+}
+
+bool DB::openExact()
+{
+    if (mExact.isOpen()) {
+        return true;
+    }
+    char path[256];
+    format::ExactHeader header;
+    if (!format::joinPath(path, sizeof(path), mDir.c_str(), "exact.idx") || !mExact.open(path, File::Mode::Read)
+        || !format::readExactHeader(mExact, &header) || header.buckets != PerfectHash::bucketsFor(header.count)) {
+        mExact.close();
+        return false;
+    }
+
+    // the seeds follow the header that was just read
+    mSeeds = Vector<std::uint32_t>();
+    std::uint8_t buffer[256];
+    FileReader reader(&mExact, buffer, sizeof(buffer));
+    for (std::uint32_t i = 0; i < header.buckets; ++i) {
+        std::uint8_t seed[4];
+        if (!reader.read(seed, sizeof(seed))) {
+            mExact.close();
+            return false;
+        }
+        mSeeds.push_back(format::get32(seed));
+    }
+    mExactCount = header.count;
+    return true;
+}
+
+namespace {
+// an entry from games.txt as it goes through the sort, the columns point
+// into the sorted record and are 0 terminated
+struct Item
+{
+    // what it sorts and is looked up by, see util/Collation.h
+    const char* key;
+    const char* name;
+    const char* path;
+    const char* image;
+    // attribute=value pairs separated by ;
+    const char* attributes;
+    std::uint8_t keyLength;
+    std::uint8_t nameLength;
+    std::uint8_t pathLength;
+    std::uint8_t imageLength;
+    std::uint16_t attributesLength;
+};
+
+// a played entry from the history of the index being replaced
+struct Played
+{
+    String key;
+    String name;
+    History::Stat stat;
+};
+
+// a set in attrs.idx as the sorted pairs are counted, what the directory
+// needs before any members are written
+struct SetTally
+{
+    String attribute;
+    String value;
+    std::uint32_t members;
+    std::uint32_t deltasSize;
+    std::uint32_t last;
+};
+
+// where the names starting with letter are in the sorted items. 0.idx
+// gets two of these, the keys before A and the ones after Z
+struct LetterRun
+{
+    char letter;
+    std::uint32_t position;
+    std::uint32_t first;
+    std::uint32_t count;
+};
+} // anonymous namespace
+
+// games.txt lines are read up to this long
+static constexpr std::uint32_t LineSize = 1024;
+
+// u8 key, name, path and image lengths and a u16 attributes length, then
+// the five of them with a 0 after each. the image and the attributes
+// share a line
+static constexpr std::uint32_t ItemHeaderSize = 6;
+static constexpr std::uint32_t MaxItemSize = ItemHeaderSize + 3 * (format::MaxNameLength + 1) + LineSize + 2;
+
+static std::uint32_t encode_item(const char* key, std::size_t keyLength, const char* name, const char* path,
+                                 const char* image, const char* attributes, std::uint8_t* out)
+{
+    const std::size_t lengths[] = { keyLength, strlen(name), strlen(path), strlen(image), strlen(attributes) };
+    const char* columns[] = { key, name, path, image, attributes };
+    out[0] = static_cast<std::uint8_t>(lengths[0]);
+    out[1] = static_cast<std::uint8_t>(lengths[1]);
+    out[2] = static_cast<std::uint8_t>(lengths[2]);
+    out[3] = static_cast<std::uint8_t>(lengths[3]);
+    format::put16(out + 4, static_cast<std::uint16_t>(lengths[4]));
+    auto p = out + ItemHeaderSize;
+    for (int i = 0; i < 5; ++i) {
+        memcpy(p, columns[i], lengths[i]);
+        p += lengths[i];
+        *p++ = 0;
+    }
+    return static_cast<std::uint32_t>(p - out);
+}
+
+static void decode_item(const std::uint8_t* record, Item* item)
+{
+    item->keyLength = record[0];
+    item->nameLength = record[1];
+    item->pathLength = record[2];
+    item->imageLength = record[3];
+    item->attributesLength = format::get16(record + 4);
+    auto p = reinterpret_cast<const char*>(record + ItemHeaderSize);
+    item->key = p;
+    item->name = p += item->keyLength + 1;
+    item->path = p += item->nameLength + 1;
+    item->image = p += item->pathLength + 1;
+    item->attributes = p + item->imageLength + 1;
+}
+
+// by key, names with the same key keep some order between them. the rest
+// only breaks ties so the output never depends on how the sort went
+static int compare_items(const std::uint8_t* a, std::uint32_t alength, const std::uint8_t* b, std::uint32_t blength)
+{
+    Item ia, ib;
+    decode_item(a, &ia);
+    decode_item(b, &ib);
+    auto r = collation::compare(ia.key, ia.keyLength, ib.key, ib.keyLength);
+    if (!r) {
+        r = collation::compare(ia.name, ia.nameLength, ib.name, ib.nameLength);
+    }
+    if (!r) {
+        r = memcmp(a, b, alength < blength ? alength : blength);
+    }
+    return r ? r : static_cast<int>(alength) - static_cast<int>(blength);
+}
+
+static bool next_item(ExternalSort& items, Item* item)
+{
+    const std::uint8_t* record;
+    std::uint32_t length;
+    if (!items.next(&record, &length)) {
+        return false;
+    }
+    decode_item(record, item);
+    return true;
+}
+
+static String make_key(const char* text, std::size_t length)
+{
+    char key[collation::MaxKeyLength + 1];
+    key[collation::key(text, length, key, collation::MaxKeyLength)] = '\0';
+    return String(key);
+}
+
+// attribute names and values match the way names do
+static bool same_key(const char* a, std::size_t alen, const char* b, std::size_t blen)
+{
+    char ka[collation::MaxKeyLength], kb[collation::MaxKeyLength];
+    const auto la = collation::key(a, alen, ka, sizeof(ka));
+    const auto lb = collation::key(b, blen, kb, sizeof(kb));
+    return collation::compare(ka, la, kb, lb) == 0;
+}
+
+static int compare_keys(const String& a, const String& b)
+{
+    return collation::compare(a.c_str(), a.size(), b.c_str(), b.size());
+}
+
+// calls f with every attribute and value in "genre=Platform; year=1991",
+// trimmed and within format::MaxAttributeLength
+template<typename F>
+static void each_pair(const char* text, F&& f)
+{
+    auto trim = [](const char*& from, const char*& to) -> void {
+        while (from < to && *from == ' ') {
+            ++from;
+        }
+        while (to > from && to[-1] == ' ') {
+            --to;
+        }
+    };
+    while (*text) {
+        auto end = strchr(text, ';');
+        if (!end) {
+            end = text + strlen(text);
+        }
+        auto eq = static_cast<const char*>(memchr(text, '=', end - text));
+        if (eq) {
+            auto a = text, ae = eq, v = eq + 1, ve = end;
+            trim(a, ae);
+            trim(v, ve);
+            const auto alen = static_cast<std::size_t>(ae - a), vlen = static_cast<std::size_t>(ve - v);
+            if (alen && vlen && alen <= format::MaxAttributeLength && vlen <= format::MaxAttributeLength) {
+                f(a, alen, v, vlen);
+            }
+        }
+        text = *end ? end + 1 : end;
+    }
+}
+
+// an entry's attribute and value as they go through the sort, u8 key
+// length and key of each, the u32 entry id and then both as written with
+// u8 lengths. sorted that way the pairs come out set by set in the order
+// of the directory, each set's ids ascending
+static constexpr std::uint32_t MaxPairSize = 2 + 2 * collation::MaxKeyLength + 4 + 2 + 2 * format::MaxAttributeLength;
+
+static std::uint32_t encode_pair(const char* a, std::size_t alen, const char* v, std::size_t vlen, std::uint32_t id,
+                                 std::uint8_t* out)
+{
+    auto p = out;
+    p[0] = static_cast<std::uint8_t>(collation::key(a, alen, reinterpret_cast<char*>(p + 1), collation::MaxKeyLength));
+    p += 1 + p[0];
+    p[0] = static_cast<std::uint8_t>(collation::key(v, vlen, reinterpret_cast<char*>(p + 1), collation::MaxKeyLength));
+    p += 1 + p[0];
+    format::put32(p, id);
+    p += 4;
+    *p++ = static_cast<std::uint8_t>(alen);
+    memcpy(p, a, alen);
+    p += alen;
+    *p++ = static_cast<std::uint8_t>(vlen);
+    memcpy(p, v, vlen);
+    p += vlen;
+    return static_cast<std::uint32_t>(p - out);
+}
+
+// bytes of the two keys at the start of a pair
+static inline std::uint32_t pair_keys(const std::uint8_t* pair)
+{
+    return 2 + pair[0] + pair[1 + pair[0]];
+}
+
+static int compare_pairs(const std::uint8_t* a, std::uint32_t alength, const std::uint8_t* b, std::uint32_t blength)
+{
+    auto r = collation::compare(reinterpret_cast<const char*>(a + 1), a[0], reinterpret_cast<const char*>(b + 1), b[0]);
+    if (r) {
+        return r;
+    }
+    const auto av = a + 1 + a[0], bv = b + 1 + b[0];
+    r = collation::compare(reinterpret_cast<const char*>(av + 1), av[0], reinterpret_cast<const char*>(bv + 1), bv[0]);
+    if (r) {
+        return r;
+    }
+    // the id is big endian, so the rest compares as bytes
+    const auto ka = pair_keys(a);
+    return collation::compare(reinterpret_cast<const char*>(a + ka), alength - ka,
+                              reinterpret_cast<const char*>(b + ka), blength - ka);
+}
+
+static bool same_set(const std::uint8_t* a, const std::uint8_t* b)
+{
+    const auto keys = pair_keys(a);
+    return keys == pair_keys(b) && !memcmp(a, b, keys);
+}
+
+// any ILBM scaled down to thumbnail size
+static bool load_thumbnail(const char* path, std::uint8_t* scratch, std::uint32_t size,
+                           const DB::IndexOptions& options, Picture* picture)
+{
+    File file;
+    Picture source;
+    if (!file.open(path, File::Mode::Read) || !source.load(file, scratch, size)) {
+        printf("Failed to load %s\n", path);
+        return false;
+    }
+    return picture->fit(source, options.thumbnailWidth, options.thumbnailHeight);
+}
+
+// how many characters of key aren't shared with previous
+static std::size_t key_suffix(const char* previous, std::size_t previousLength, const char* key, std::size_t length)
+{
+    std::size_t shared = 0;
+    while (previous && shared < length && shared < previousLength && key[shared] == previous[shared]) {
+        ++shared;
+    }
+    return length - shared;
+}
+
+static bool write_ids(const char* dir, const Vector<std::uint32_t>& offsets)
+{
+    char path[256];
+    File file;
+    if (!format::joinPath(path, sizeof(path), dir, "ids.idx") || !file.open(path, File::Mode::Write)) {
+        printf("Failed to create %s\n", path);
+        return false;
+    }
+    std::uint8_t buffer[1024];
+    FileWriter out(&file, buffer, sizeof(buffer));
+    std::uint8_t header[format::IdsHeaderSize] = {};
+    format::put32(header, format::IdsMagic);
+    format::put16(header + 4, format::Version);
+    format::put32(header + 8, static_cast<std::uint32_t>(offsets.size()));
+    out.write(header, sizeof(header));
+    for (std::size_t i = 0; i < offsets.size(); ++i) {
+        std::uint8_t off[4];
+        format::put32(off, offsets[i]);
+        out.write(off, sizeof(off));
+    }
+    if (!out.flush()) {
+        printf("Failed to write %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+// every attribute and value of every entry goes through a sort, after
+// which each set's members are one run of ascending ids. counting them
+// gives the directory and a second read writes the members, so only the
+// set being written is ever in memory and only if it's a bitmap
+static bool write_attributes(const char* dir, ExternalSort& items, std::uint32_t count, const DB::IndexOptions& options)
+{
+    ExternalSort pairs(dir, "attrs", options.sortBudget, MaxPairSize, compare_pairs);
+    {
+        std::uint8_t pair[MaxPairSize];
+        Item item;
+        bool added = true;
+        items.rewind();
+        for (std::uint32_t id = 0; id < count && added; ++id) {
+            if (!next_item(items, &item)) {
+                added = false;
+                break;
+            }
+            each_pair(item.attributes, [&](const char* a, std::size_t alen, const char* v, std::size_t vlen) -> void {
+                added = added && pairs.add(pair, encode_pair(a, alen, v, vlen, id, pair));
+            });
+        }
+        if (!added || !pairs.finish()) {
+            printf("Failed to sort the attributes\n");
+            return false;
+        }
+    }
+
+    // the first spelling of a set in name order is the one it goes by,
+    // an entry listing the same pair twice is in the set once
+    Vector<SetTally> sets;
+    std::uint8_t previous[MaxPairSize];
+    const std::uint8_t* record;
+    std::uint32_t length;
+    while (pairs.next(&record, &length)) {
+        const auto keys = pair_keys(record);
+        const auto id = format::get32(record + keys);
+        if (!sets.size() || !same_set(previous, record)) {
+            const auto a = record + keys + 4;
+            const auto v = a + 1 + a[0];
+            char attribute[format::MaxAttributeLength + 1], value[format::MaxAttributeLength + 1];
+            memcpy(attribute, a + 1, a[0]);
+            attribute[a[0]] = '\0';
+            memcpy(value, v + 1, v[0]);
+            value[v[0]] = '\0';
+            sets.push_back({ String(attribute), String(value), 0, 0, 0 });
+            memcpy(previous, record, keys);
+        } else if (id == sets[sets.size() - 1].last) {
+            continue;
+        }
+        auto& set = sets[sets.size() - 1];
+        set.deltasSize += EntrySet::deltaSize(id - set.last);
+        set.last = id;
+        ++set.members;
+    }
+
+    char path[256];
+    File file;
+    if (!format::joinPath(path, sizeof(path), dir, "attrs.idx") || !file.open(path, File::Mode::Write)) {
+        printf("Failed to create %s\n", path);
+        return false;
+    }
+    std::uint8_t buffer[1024];
+    FileWriter out(&file, buffer, sizeof(buffer));
+    const auto setCount = static_cast<std::uint32_t>(sets.size());
+    const auto bitmapSize = (count + 7) >> 3;
+    std::uint8_t header[format::AttributesHeaderSize] = {};
+    format::put32(header, format::AttributesMagic);
+    format::put16(header + 4, format::Version);
+    format::put32(header + 8, count);
+    format::put32(header + 12, setCount);
+    out.write(header, sizeof(header));
+
+    // the directory comes first and its size only depends on the names,
+    // each set is encoded however is smaller the same as EntrySet does
+    std::uint32_t data = format::AttributesHeaderSize;
+    for (std::uint32_t i = 0; i < setCount; ++i) {
+        data += 1 + sets[i].attribute.size() + 1 + sets[i].value.size() + 13;
+    }
+    for (std::uint32_t i = 0; i < setCount; ++i) {
+        const auto& set = sets[i];
+        const auto encoding = set.deltasSize < bitmapSize ? EntrySet::Encoding::Deltas : EntrySet::Encoding::Bitmap;
+        const auto size = encoding == EntrySet::Encoding::Deltas ? set.deltasSize : bitmapSize;
+        std::uint8_t len = static_cast<std::uint8_t>(set.attribute.size());
+        out.write(&len, 1);
+        out.write(set.attribute.c_str(), len);
+        len = static_cast<std::uint8_t>(set.value.size());
+        out.write(&len, 1);
+        out.write(set.value.c_str(), len);
+        std::uint8_t tail[13];
+        tail[0] = static_cast<std::uint8_t>(encoding);
+        format::put32(tail + 1, set.members);
+        format::put32(tail + 5, data);
+        format::put32(tail + 9, size);
+        out.write(tail, sizeof(tail));
+        data += size;
+    }
+
+    pairs.rewind();
+    EntrySet members;
+    std::uint32_t current = 0;
+    std::uint32_t last = 0;
+    bool started = false;
+    auto flush = [&]() -> bool {
+        const bool ok = !members.size() || members.encode(EntrySet::Encoding::Bitmap, out);
+        members.release();
+        return ok;
+    };
+    while (pairs.next(&record, &length)) {
+        const auto id = format::get32(record + pair_keys(record));
+        if (started && same_set(previous, record)) {
+            if (id == last) {
+                continue;
+            }
+        } else {
+            if (started) {
+                ++current;
+                if (!flush()) {
+                    printf("Failed to write %s\n", path);
+                    return false;
+                }
+            }
+            started = true;
+            memcpy(previous, record, pair_keys(record));
+            last = 0;
+            if (sets[current].deltasSize >= bitmapSize && !members.allocate(count)) {
+                printf("Failed to allocate a set for %s\n", sets[current].attribute.c_str());
+                return false;
+            }
+        }
+        if (members.size()) {
+            members.add(id);
+        } else {
+            EntrySet::encodeDelta(id - last, out);
+        }
+        last = id;
+    }
+    if (!flush() || !out.flush()) {
+        printf("Failed to write %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+// an entry's value for an order as it goes through the sort, u8 flags,
+// u8 key length, the key and the u32 entry id
+enum : std::uint8_t {
+    ValuePresent = 0x1,
+    ValueNumber = 0x2,
+    ValueDescending = 0x4,
+};
+static constexpr std::uint32_t MaxValueSize = 2 + collation::MaxKeyLength + 4;
+
+// numbers compare by value and come before anything else, which compares
+// by collation key. entries without the attribute go last and ties stay
+// in name order
+static int compare_values(const std::uint8_t* a, std::uint32_t alength, const std::uint8_t* b, std::uint32_t blength)
 {
+    const bool present = a[0] & ValuePresent;
+    if (present != static_cast<bool>(b[0] & ValuePresent)) {
+        return present ? -1 : 1;
+    }
+    if (present) {
+        const bool number = a[0] & ValueNumber;
+        int r;
+        if (number != static_cast<bool>(b[0] & ValueNumber)) {
+            r = number ? -1 : 1;
+        } else if (number && a[1] != b[1]) {
+            r = a[1] < b[1] ? -1 : 1;
+        } else {
+            r = collation::compare(reinterpret_cast<const char*>(a + 2), a[1], reinterpret_cast<const char*>(b + 2), b[1]);
+        }
+        if (r) {
+            return (a[0] & ValueDescending) ? -r : r;
+        }
+    }
+    const auto ia = format::get32(a + alength - 4), ib = format::get32(b + blength - 4);
+    return ia < ib ? -1 : ia > ib;
+}
+
+static std::uint32_t encode_value(const char* attributes, const char* attribute, std::size_t length, bool descending,
+                                  std::uint32_t id, std::uint8_t* out)
+{
+    out[0] = descending ? ValueDescending : 0;
+    out[1] = 0;
+    each_pair(attributes, [&](const char* a, std::size_t alen, const char* v, std::size_t vlen) -> void {
+        if ((out[0] & ValuePresent) || !same_key(a, alen, attribute, length)) {
+            return;
+        }
+        out[0] |= ValuePresent | ValueNumber;
+        for (std::size_t i = 0; i < vlen; ++i) {
+            if (v[i] < '0' || v[i] > '9') {
+                out[0] &= ~ValueNumber;
+                break;
+            }
+        }
+        if (out[0] & ValueNumber) {
+            while (vlen > 1 && *v == '0') {
+                ++v;
+                --vlen;
+            }
+            memcpy(out + 2, v, vlen);
+            out[1] = static_cast<std::uint8_t>(vlen);
+        } else {
+            out[1] = static_cast<std::uint8_t>(collation::key(v, vlen, reinterpret_cast<char*>(out + 2), collation::MaxKeyLength));
+        }
+    });
+    format::put32(out + 2 + out[1], id);
+    return 2 + out[1] + 4;
+}
+
+// orders is "year;-rating;publisher", a leading - sorts that one descending.
+// each one is another sort of the entries, by value this time
+static bool write_orders(const char* dir, ExternalSort& items, std::uint32_t count, const DB::IndexOptions& options)
+{
+    struct Spec
+    {
+        const char* name;
+        std::uint8_t length;
+        bool descending;
+    };
+    Vector<Spec> specs;
+    for (auto p = options.orders ? options.orders : ""; *p;) {
+        auto end = strchr(p, ';');
+        if (!end) {
+            end = p + strlen(p);
+        }
+        while (p < end && *p == ' ') {
+            ++p;
+        }
+        const bool descending = p < end && *p == '-';
+        if (descending) {
+            ++p;
+        }
+        auto last = end;
+        while (last > p && last[-1] == ' ') {
+            --last;
+        }
+        if (last > p && static_cast<std::size_t>(last - p) <= format::MaxAttributeLength) {
+            specs.push_back({ p, static_cast<std::uint8_t>(last - p), descending });
+        }
+        p = *end ? end + 1 : end;
+    }
+
+    char path[256];
+    File file;
+    if (!format::joinPath(path, sizeof(path), dir, "orders.idx") || !file.open(path, File::Mode::Write)) {
+        printf("Failed to create %s\n", path);
+        return false;
+    }
+    std::uint8_t buffer[1024];
+    FileWriter out(&file, buffer, sizeof(buffer));
+    const auto width = Order::widthFor(count);
+    std::uint8_t header[format::OrdersHeaderSize] = {};
+    format::put32(header, format::OrdersMagic);
+    format::put16(header + 4, format::Version);
+    format::put32(header + 8, count);
+    format::put32(header + 12, static_cast<std::uint32_t>(specs.size()));
+    out.write(header, sizeof(header));
+
+    std::uint32_t data = format::OrdersHeaderSize;
+    for (std::size_t i = 0; i < specs.size(); ++i) {
+        data += 1 + specs[i].length + 6;
+    }
+    for (std::size_t i = 0; i < specs.size(); ++i) {
+        const auto& spec = specs[i];
+        std::uint8_t tail[6];
+        tail[0] = width;
+        tail[1] = spec.descending ? 1 : 0;
+        format::put32(tail + 2, data);
+        out.write(&spec.length, 1);
+        out.write(spec.name, spec.length);
+        out.write(tail, sizeof(tail));
+        data += count * width;
+    }
+
+    for (std::size_t i = 0; i < specs.size(); ++i) {
+        const auto& spec = specs[i];
+        ExternalSort values(dir, "order", options.sortBudget, MaxValueSize, compare_values);
+        std::uint8_t value[MaxValueSize];
+        Item item;
+        items.rewind();
+        for (std::uint32_t id = 0; id < count; ++id) {
+            if (!next_item(items, &item)
+                || !values.add(value, encode_value(item.attributes, spec.name, spec.length, spec.descending, id, value))) {
+                printf("Failed to sort by %.*s\n", spec.length, spec.name);
+                return false;
+            }
+        }
+        if (!values.finish()) {
+            printf("Failed to sort by %.*s\n", spec.length, spec.name);
+            return false;
+        }
+        const std::uint8_t* record;
+        std::uint32_t length;
+        while (values.next(&record, &length)) {
+            std::uint8_t id[4];
+            if (width == 2) {
+                format::put16(id, static_cast<std::uint16_t>(format::get32(record + length - 4)));
+            } else {
+                format::put32(id, format::get32(record + length - 4));
+            }
+            out.write(id, width);
+        }
+    }
+
+    if (!out.flush()) {
+        printf("Failed to write %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+// calls f with every item whose key starts with letter, its id and the
+// key of the one before it with the same letter, null for the first
+template<typename F>
+static bool each_letter_item(ExternalSort& items, const Vector<LetterRun>& runs, char letter, F&& f)
+{
+    char previous[collation::MaxKeyLength];
+    std::size_t previousLength = 0;
+    bool first = true;
+    Item item;
+    for (std::size_t r = 0; r < runs.size(); ++r) {
+        const auto& run = runs[r];
+        if (run.letter != letter) {
+            continue;
+        }
+        if (!items.seek(run.position)) {
+            return false;
+        }
+        for (std::uint32_t j = 0; j < run.count; ++j) {
+            if (!next_item(items, &item)) {
+                return false;
+            }
+            f(item, run.first + j, first ? nullptr : previous, previousLength);
+            memcpy(previous, item.key, item.keyLength);
+            previousLength = item.keyLength;
+            first = false;
+        }
+    }
+    return true;
+}
+
+bool DB::createIndex()
+{
+    return createIndex(IndexOptions());
+}
+
+bool DB::createIndex(const IndexOptions& options)
+{
+    char path[256];
+    File list;
+    if (!format::joinPath(path, sizeof(path), mDir.c_str(), "games.txt") || !list.open(path, File::Mode::Read)) {
+        printf("Failed to open %s\n", path);
+        return false;
+    }
+
+    // plays are logged by id and the ids are about to change, so they're
+    // remembered by name and matched up with the new ones in the data pass
+    Vector<Played> played;
+    bool carryHistory = false;
+    {
+        History old;
+        if (openIds() && openData() && old.open(mDir.c_str(), static_cast<std::uint32_t>(mSlots.size()))) {
+            carryHistory = true;
+            const auto& stats = old.stats();
+            for (std::size_t i = 0; i < stats.size(); ++i) {
+                if (format::readRecord(mData, mSlots[stats[i].id].offset, &mRecord, mRecordScratch)) {
+                    played.push_back({ make_key(mRecord.name, mRecord.nameLength), String(mRecord.name), stats[i] });
+                }
+            }
+            if (played.size() > 0) {
+                std::sort(&played[0], &played[0] + played.size(), [](const Played& a, const Played& b) -> bool {
+                    const auto r = compare_keys(a.key, b.key);
+                    return r ? r < 0 : strcmp(a.name.c_str(), b.name.c_str()) < 0;
+                });
+            }
+        }
+        mHistory.close();
+        // data.idx is about to be written over
+        mLoader.stop();
+        mData.close();
+    }
+
+    // one entry per line, name<TAB>path<TAB>image<TAB>attributes, anything
+    // after that is ignored. they're sorted by key through temp files in
+    // the db directory once there are more than options.sortBudget holds,
+    // and every pass after this reads them back in that order
+    static_assert(MaxItemSize <= sizeof(mImageScratch), "items are put together in mImageScratch");
+    ExternalSort items(mDir.c_str(), "items", options.sortBudget, MaxItemSize, compare_items);
+    {
+        std::uint8_t buffer[1024];
+        FileReader reader(&list, buffer, sizeof(buffer));
+        char line[LineSize];
+        std::size_t length = 0;
+        bool overflow = false;
+        int c;
+        do {
+            c = reader.get();
+            if (c >= 0 && c != '\n') {
+                if (length < sizeof(line) - 1) {
+                    line[length++] = static_cast<char>(c);
+                } else {
+                    overflow = true;
+                }
+                continue;
+            }
+            if (length > 0 && line[length - 1] == '\r') {
+                --length;
+            }
+            line[length] = '\0';
+            auto tab = static_cast<char*>(memchr(line, '\t', length));
+            if (length > 0 && line[0] != '#' && tab && !overflow) {
+                *tab = '\0';
+                auto image = strchr(tab + 1, '\t');
+                char* attributes = nullptr;
+                if (image) {
+                    *image++ = '\0';
+                    attributes = strchr(image, '\t');
+                    if (attributes) {
+                        *attributes++ = '\0';
+                        auto end = strchr(attributes, '\t');
+                        if (end) {
+                            *end = '\0';
+                        }
+                    }
+                }
+                if (strlen(line) > format::MaxNameLength || strlen(tab + 1) > format::MaxPathLength
+                    || (image && strlen(image) > format::MaxPathLength)) {
+                    printf("Skipping %s, name or path too long\n", line);
+                } else {
+                    char key[collation::MaxKeyLength];
+                    const auto size = encode_item(key, collation::key(line, strlen(line), key, sizeof(key)), line,
+                                                  tab + 1, image ? image : "", attributes ? attributes : "",
+                                                  mImageScratch);
+                    if (!items.add(mImageScratch, size)) {
+                        printf("Failed to sort %s\n", line);
+                        return false;
+                    }
+                }
+            }
+            length = 0;
+            overflow = false;
+        } while (c >= 0);
+    }
+    list.close();
+    if (!items.finish()) {
+        printf("Failed to sort the entries\n");
+        return false;
+    }
+
+    const auto count = items.count();
+    Item item;
+
+    // the palette has to be known before the first thumbnail can be
+    // written, so the pictures are read twice rather than all kept around
+    std::uint16_t palette[format::PaletteSize] = {};
+    std::uint16_t colors = 0;
+    {
+        PaletteBuilder builder;
+        bool any = false;
+        items.rewind();
+        while (next_item(items, &item)) {
+            Picture picture;
+            if (item.imageLength > 0
+                && load_thumbnail(item.image, mImageScratch, sizeof(mImageScratch), options, &picture)) {
+                builder.add(picture);
+                any = true;
+            }
+        }
+        if (any) {
+            const auto used = builder.build(palette + format::ReservedPens, format::PaletteSize - format::ReservedPens);
+            colors = used ? static_cast<std::uint16_t>(format::ReservedPens + used) : 0;
+        }
+    }
+    if (colors) {
+        char bitmaps[256];
+        if (!format::joinPath(bitmaps, sizeof(bitmaps), mDir.c_str(), "bitmaps") || !File::createDirectory(bitmaps)) {
+            printf("Failed to create %s\n", bitmaps);
+            return false;
+        }
+    }
+    Quantizer quantizer(palette, format::ReservedPens, colors ? colors - format::ReservedPens : 0);
+
+    // records follow the header back to back in name order and are found
+    // through the offsets kept here. everything else that's kept per entry
+    // is picked up on the way
+    Vector<std::uint32_t> offsets;
+    // names with the same key are adjacent and can't be told apart by the
+    // hash, the first one wins like it does for find()
+    Vector<PerfectHash::Key> hashes;
+    Vector<std::uint32_t> unique;
+    Vector<LetterRun> runs;
+    Vector<History::Stat> plays;
+
+    std::uint8_t buffer[1024];
+    File data;
+    if (!format::joinPath(path, sizeof(path), mDir.c_str(), "data.idx") || !data.open(path, File::Mode::Write)) {
+        printf("Failed to create %s\n", path);
+        return false;
+    }
+    FileWriter writer(&data, buffer, sizeof(buffer));
+    std::uint8_t head[format::DataHeaderSize] = {};
+    format::put32(head, format::DataMagic);
+    format::put16(head + 4, format::Version);
+    format::put16(head + 6, colors);
+    format::put32(head + 8, count);
+    for (std::uint32_t i = 0; i < format::PaletteSize; ++i) {
+        format::put16(head + 12 + i * 2, palette[i]);
+    }
+    writer.write(head, sizeof(head));
+    items.rewind();
+    char previous[collation::MaxKeyLength];
+    std::size_t previousLength = 0;
+    for (std::uint32_t i = 0; i < count; ++i) {
+        const auto position = items.position();
+        if (!next_item(items, &item)) {
+            printf("Failed to read the sorted entries\n");
+            return false;
+        }
+
+        // thumbnails are named by record offset, which no two entries
+        // share whatever their names. one left by an earlier index for
+        // an entry that has none now is removed so it can't be picked up.
+        // the preview comes from the thumbnail, entries without one
+        // simply don't get one
+        const auto offset = writer.position();
+        std::uint16_t previewLength = 0;
+        {
+            Picture picture;
+            Image thumbnail;
+            if (!format::bitmapPath(path, sizeof(path), mDir.c_str(), offset)) {
+                printf("Failed to make a thumbnail path in %s\n", mDir.c_str());
+                return false;
+            }
+            if (colors && item.imageLength > 0
+                && load_thumbnail(item.image, mImageScratch, sizeof(mImageScratch), options, &picture)
+                && quantizer.convert(picture, format::ThumbnailDepth, options.dither, &thumbnail)) {
+                File file;
+                if (!file.open(path, File::Mode::Write) || !thumbnail.saveILBM(file, palette, format::PaletteSize)) {
+                    printf("Failed to write %s\n", path);
+                    return false;
+                }
+                previewLength = format::encodePreview(thumbnail, mRecord.preview);
+            } else {
+                File::remove(path);
+            }
+        }
+
+        offsets.push_back(offset);
+
+        std::uint8_t rec[format::RecordHeaderSize];
+        rec[0] = item.nameLength;
+        rec[1] = item.pathLength;
+        format::put16(rec + 2, previewLength);
+        writer.write(rec, sizeof(rec));
+        writer.write(item.name, item.nameLength);
+        writer.write(item.path, item.pathLength);
+        writer.write(mRecord.preview, previewLength);
+
+        if (!i || collation::compare(previous, previousLength, item.key, item.keyLength) != 0) {
+            hashes.push_back(PerfectHash::hash(item.key, item.keyLength));
+            unique.push_back(offset);
+        }
+        const auto letter = format::letterFor(item.key, item.keyLength);
+        if (!runs.size() || runs[runs.size() - 1].letter != letter) {
+            runs.push_back({ letter, position, i, 0 });
+        }
+        ++runs[runs.size() - 1].count;
+        if (played.size() > 0) {
+            std::size_t lo = 0, hi = played.size();
+            while (lo < hi) {
+                const auto mid = (lo + hi) / 2;
+                const auto& p = played[mid];
+                auto r = collation::compare(p.key.c_str(), p.key.size(), item.key, item.keyLength);
+                if (!r) {
+                    r = strcmp(p.name.c_str(), item.name);
+                }
+                if (r < 0) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            if (lo < played.size() && !strcmp(played[lo].name.c_str(), item.name)) {
+                plays.push_back(played[lo].stat);
+                plays[plays.size() - 1].id = i;
+            }
+        }
+        memcpy(previous, item.key, item.keyLength);
+        previousLength = item.keyLength;
+    }
+    if (!writer.flush()) {
+        printf("Failed to write %s\n", path);
+        return false;
+    }
+    data.close();
+
+    if (!write_ids(mDir.c_str(), offsets) || !write_attributes(mDir.c_str(), items, count, options)
+        || !write_orders(mDir.c_str(), items, count, options)) {
+        return false;
+    }
+
+    // every letter gets a file, even an empty one, so stale files from an
+    // earlier index can't linger
+    static const char letters[] = "0ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    for (const char* letter = letters; *letter; ++letter) {
+        const char name[2] = { *letter, '\0' };
+        File file;
+        if (!format::joinPath(path, sizeof(path), mDir.c_str(), name, ".idx") || !file.open(path, File::Mode::Write)) {
+            printf("Failed to create %s\n", path);
+            return false;
+        }
+
+        // entry sizes only depend on the names, so the restart offsets can
+        // be worked out up front and written before the entries. the
+        // filter holds every distinct prefix, which is whatever each name
+        // doesn't share with the one before it
+        std::uint32_t entries = 0;
+        std::uint32_t prefixes = 0;
+        std::uint32_t position = 0;
+        Vector<std::uint32_t> restarts;
+        bool ok = each_letter_item(items, runs, *letter, [&](const Item& item, std::uint32_t, const char* previous,
+                                                             std::size_t previousLength) -> void {
+            const bool restart = entries % format::LetterInterval == 0;
+            if (restart) {
+                restarts.push_back(position);
+            }
+            prefixes += key_suffix(previous, previousLength, item.key, item.keyLength);
+            position += 2 + key_suffix(restart ? nullptr : previous, previousLength, item.key, item.keyLength) + 4;
+            ++entries;
+        });
+
+        BloomFilter filter;
+        {
+            std::uint32_t bytes;
+            std::uint8_t hashes;
+            BloomFilter::size(prefixes, options.filterPerMille, &bytes, &hashes);
+            filter.allocate(bytes, hashes);
+        }
+        ok = ok && each_letter_item(items, runs, *letter, [&filter](const Item& item, std::uint32_t, const char* previous,
+                                                                     std::size_t previousLength) -> void {
+            const auto suffix = key_suffix(previous, previousLength, item.key, item.keyLength);
+            for (auto length = item.keyLength - suffix; length < item.keyLength; ++length) {
+                filter.add(item.key, length + 1);
+            }
+        });
+
+        FileWriter out(&file, buffer, sizeof(buffer));
+        std::uint8_t header[format::LetterHeaderSize];
+        format::put32(header, format::LetterMagic);
+        format::put16(header + 4, format::Version);
+        format::put16(header + 6, format::LetterInterval);
+        format::put32(header + 8, entries);
+        format::put32(header + 12, static_cast<std::uint32_t>(restarts.size()));
+        format::put32(header + 16, filter.bytes());
+        header[20] = filter.hashes();
+        header[21] = header[22] = header[23] = 0;
+        out.write(header, sizeof(header));
+        const auto base = format::LetterHeaderSize + static_cast<std::uint32_t>(restarts.size()) * 4 + filter.bytes();
+        for (std::size_t r = 0; r < restarts.size(); ++r) {
+            std::uint8_t off[4];
+            format::put32(off, base + restarts[r]);
+            out.write(off, sizeof(off));
+        }
+        out.write(filter.data(), filter.bytes());
+
+        std::uint8_t entry[format::MaxNameEntrySize];
+        std::uint32_t written = 0;
+        ok = ok && each_letter_item(items, runs, *letter, [&](const Item& item, std::uint32_t id, const char* previous,
+                                                              std::size_t previousLength) -> void {
+            const bool restart = written++ % format::LetterInterval == 0;
+            const auto size = format::encodeName(restart ? nullptr : previous, static_cast<std::uint8_t>(previousLength),
+                                                 item.key, item.keyLength, offsets[id], entry);
+            out.write(entry, size);
+        });
+        if (!ok || !out.flush()) {
+            printf("Failed to write %s\n", path);
+            return false;
+        }
+    }
+
+    {
+        const auto keys = static_cast<std::uint32_t>(hashes.size());
+        const auto buckets = PerfectHash::bucketsFor(keys);
+        auto seeds = new std::uint32_t[buckets ? buckets : 1];
+        auto slots = new std::uint32_t[keys ? keys : 1];
+        const bool built = PerfectHash::build(keys ? &hashes[0] : nullptr, keys, seeds, slots);
+        if (!built) {
+            printf("Failed to build the exact name hash, exact() will search\n");
+        }
+
+        File file;
+        bool written = format::joinPath(path, sizeof(path), mDir.c_str(), "exact.idx") && file.open(path, File::Mode::Write);
+        if (written) {
+            FileWriter out(&file, buffer, sizeof(buffer));
+            std::uint8_t header[format::ExactHeaderSize] = {};
+            format::put32(header, format::ExactMagic);
+            format::put16(header + 4, format::Version);
+            format::put32(header + 8, built ? keys : 0);
+            format::put32(header + 12, built ? buckets : 0);
+            out.write(header, sizeof(header));
+            if (built) {
+                for (std::uint32_t b = 0; b < buckets; ++b) {
+                    std::uint8_t seed[4];
+                    format::put32(seed, seeds[b]);
+                    out.write(seed, sizeof(seed));
+                }
+                // slots are filled in key order, so invert the mapping
+                auto table = new std::uint32_t[keys ? keys : 1];
+                for (std::uint32_t k = 0; k < keys; ++k) {
+                    table[slots[k]] = unique[k];
+                }
+                for (std::uint32_t k = 0; k < keys; ++k) {
+                    std::uint8_t off[4];
+                    format::put32(off, table[k]);
+                    out.write(off, sizeof(off));
+                }
+                delete[] table;
+            }
+            written = out.flush();
+        }
+        delete[] seeds;
+        delete[] slots;
+        if (!written) {
+            printf("Failed to write %s\n", path);
+            return false;
+        }
+    }
+
+    if (carryHistory && !History::write(mDir.c_str(), plays.size() ? &plays[0] : nullptr,
+                                        static_cast<std::uint32_t>(plays.size()))) {
+        return false;
+    }
+
+    // whatever was open belongs to the old index, hydrated entries too
+    mLoader.stop();
+    mData.close();
+    mExact.close();
+    mFiltersLoaded = false;
+    clearEntries();
+    mIdsLoaded = false;
+    mHistory.close();
+    mCache.clear();
+    return true;
+}
+
+bool DB::openIds()
+{
+    if (mIdsLoaded) {
+        return mSlots.size() > 0;
+    }
+    mIdsLoaded = true;
+    mSlots = Vector<Slot>();
+
+    char path[256];
+    File file;
+    std::uint8_t header[format::IdsHeaderSize];
+    if (!format::joinPath(path, sizeof(path), mDir.c_str(), "ids.idx") || !file.open(path, File::Mode::Read)
+        || !file.readExact(header, sizeof(header)) || format::get32(header) != format::IdsMagic
+        || format::get16(header + 4) != format::Version) {
+        return false;
+    }
+    const auto count = format::get32(header + 8);
+    std::uint8_t buffer[512];
+    FileReader reader(&file, buffer, sizeof(buffer));
+    for (std::uint32_t i = 0; i < count; ++i) {
+        std::uint8_t off[4];
+        if (!reader.read(off, sizeof(off))) {
+            mSlots = Vector<Slot>();
+            return false;
+        }
+        mSlots.push_back({ format::get32(off), 0, 0 });
+    }
+    return mSlots.size() > 0;
+}
+
+std::uint32_t DB::entryCount()
+{
+    return openIds() ? static_cast<std::uint32_t>(mSlots.size()) : 0;
+}
+
+namespace {
+struct AttributeSet
+{
+    char attribute[format::MaxAttributeLength + 1];
+    char value[format::MaxAttributeLength + 1];
+    std::uint8_t attributeLength;
+    std::uint8_t valueLength;
+    EntrySet::Encoding encoding;
+    std::uint32_t members;
+    std::uint32_t offset;
+    std::uint32_t length;
+};
+} // anonymous namespace
+
+// walks the attrs.idx directory until f returns false, count is the
+// number of entries the sets are over
+template<typename F>
+static bool each_attribute(const char* dir, File& file, std::uint32_t* count, F&& f)
+{
+    char path[256];
+    std::uint8_t header[format::AttributesHeaderSize];
+    if (!format::joinPath(path, sizeof(path), dir, "attrs.idx") || !file.open(path, File::Mode::Read)
+        || !file.readExact(header, sizeof(header)) || format::get32(header) != format::AttributesMagic
+        || format::get16(header + 4) != format::Version) {
+        return false;
+    }
+    *count = format::get32(header + 8);
+    const auto sets = format::get32(header + 12);
+
+    std::uint8_t buffer[512];
+    FileReader reader(&file, buffer, sizeof(buffer));
+    AttributeSet set;
+    for (std::uint32_t i = 0; i < sets; ++i) {
+        std::uint8_t tail[13];
+        const auto alen = reader.get();
+        if (alen < 0 || !reader.read(set.attribute, alen)) {
+            return false;
+        }
+        const auto vlen = reader.get();
+        if (vlen < 0 || !reader.read(set.value, vlen) || !reader.read(tail, sizeof(tail))) {
+            return false;
+        }
+        set.attribute[alen] = '\0';
+        set.value[vlen] = '\0';
+        set.attributeLength = static_cast<std::uint8_t>(alen);
+        set.valueLength = static_cast<std::uint8_t>(vlen);
+        set.encoding = static_cast<EntrySet::Encoding>(tail[0]);
+        set.members = format::get32(tail + 1);
+        set.offset = format::get32(tail + 5);
+        set.length = format::get32(tail + 9);
+        if (!f(set)) {
+            break;
+        }
+    }
+    return true;
+}
+
+bool DB::select(const char* attribute, const char* value, EntrySet* set)
+{
+    File file;
+    std::uint32_t count = 0;
+    AttributeSet found;
+    bool match = false;
+    const auto alen = strlen(attribute), vlen = strlen(value);
+    const bool ok = each_attribute(mDir.c_str(), file, &count, [&](const AttributeSet& candidate) -> bool {
+        if (same_key(candidate.attribute, candidate.attributeLength, attribute, alen)
+            && same_key(candidate.value, candidate.valueLength, value, vlen)) {
+            found = candidate;
+            match = true;
+        }
+        return !match;
+    });
+    if (!ok) {
+        count = entryCount();
+    }
+    if (!set->allocate(count) || !match) {
+        return false;
+    }
+
+    std::uint8_t buffer[512];
+    if (!file.seek(found.offset)) {
+        return false;
+    }
+    FileReader reader(&file, buffer, sizeof(buffer));
+    if (!set->decode(found.encoding, found.length, reader)) {
+        set->allocate(count);
+        return false;
+    }
+    return true;
+}
+
+void DB::values(const char* attribute, Function<void(const char* value, std::uint32_t members)>&& callback)
+{
+    File file;
+    std::uint32_t count;
+    const auto alen = strlen(attribute);
+    each_attribute(mDir.c_str(), file, &count, [&](const AttributeSet& candidate) -> bool {
+        if (same_key(candidate.attribute, candidate.attributeLength, attribute, alen)) {
+            callback(candidate.value, candidate.members);
+        }
+        return true;
+    });
+}
+
+std::uint32_t DB::entries(const EntrySet& set, std::uint32_t first, Id* ids, std::uint32_t count)
+{
+    if (!openIds()) {
+        return 0;
+    }
+
+    std::uint32_t found = 0;
+    auto id = set.nth(first);
+    while (found < count && id < set.size() && id < mSlots.size()) {
+        ids[found++] = id;
+        id = set.next(id + 1);
+    }
+    return found;
+}
+
+namespace {
+struct OrderInfo
+{
+    char attribute[format::MaxAttributeLength + 1];
+    std::uint8_t attributeLength;
+    std::uint8_t width;
+    bool descending;
+    std::uint32_t offset;
+};
+} // anonymous namespace
+
+// walks the orders.idx directory until f returns false, count is the
+// number of ids in each order
+template<typename F>
+static bool each_order(const char* dir, File& file, std::uint32_t* count, F&& f)
+{
+    char path[256];
+    std::uint8_t header[format::OrdersHeaderSize];
+    if (!format::joinPath(path, sizeof(path), dir, "orders.idx") || !file.open(path, File::Mode::Read)
+        || !file.readExact(header, sizeof(header)) || format::get32(header) != format::OrdersMagic
+        || format::get16(header + 4) != format::Version) {
+        return false;
+    }
+    *count = format::get32(header + 8);
+    const auto orders = format::get32(header + 12);
+
+    std::uint8_t buffer[256];
+    FileReader reader(&file, buffer, sizeof(buffer));
+    OrderInfo info;
+    for (std::uint32_t i = 0; i < orders; ++i) {
+        std::uint8_t tail[6];
+        const auto alen = reader.get();
+        if (alen < 0 || !reader.read(info.attribute, alen) || !reader.read(tail, sizeof(tail))) {
+            return false;
+        }
+        info.attribute[alen] = '\0';
+        info.attributeLength = static_cast<std::uint8_t>(alen);
+        info.width = tail[0];
+        info.descending = tail[1] != 0;
+        info.offset = format::get32(tail + 2);
+        if (!f(info)) {
+            break;
+        }
+    }
+    return true;
+}
+
+bool DB::order(const char* attribute, Order* order)
+{
+    File file;
+    std::uint32_t count = 0;
+    OrderInfo found;
+    bool match = false;
+    const auto alen = strlen(attribute);
+    each_order(mDir.c_str(), file, &count, [&](const OrderInfo& candidate) -> bool {
+        match = same_key(candidate.attribute, candidate.attributeLength, attribute, alen);
+        if (match) {
+            found = candidate;
+        }
+        return !match;
+    });
+    if (!match || found.width != Order::widthFor(count) || !order->allocate(count, count)) {
+        return false;
+    }
+    if (!file.seek(found.offset) || !file.readExact(order->data(), order->bytes())) {
+        order->release();
+        return false;
+    }
+    return true;
+}
+
+void DB::orders(Function<void(const char* attribute, bool descending)>&& callback)
+{
+    File file;
+    std::uint32_t count;
+    each_order(mDir.c_str(), file, &count, [&](const OrderInfo& info) -> bool {
+        callback(info.attribute, info.descending);
+        return true;
+    });
+}
+
+std::uint32_t DB::entries(const Order& order, std::uint32_t first, Id* ids, std::uint32_t count)
+{
+    if (!openIds()) {
+        return 0;
+    }
+
+    std::uint32_t found = 0;
+    for (auto i = first; i < order.size() && found < count; ++i) {
+        const auto id = order.at(i);
+        if (id >= mSlots.size()) {
+            break;
+        }
+        ids[found++] = id;
+    }
+    return found;
+}
+
+History* DB::history()
+{
+    if (!mHistory.isOpen() && openIds()) {
+        mHistory.open(mDir.c_str(), static_cast<std::uint32_t>(mSlots.size()));
+    }
+    return &mHistory;
+}
+
+// records are written in id order so the offsets only go up
+bool DB::idFor(std::uint32_t offset, Id* id)
+{
+    if (!openIds()) {
+        return false;
+    }
+    std::size_t lo = 0, hi = mSlots.size();
+    while (lo < hi) {
+        const auto mid = (lo + hi) / 2;
+        if (mSlots[mid].offset < offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == mSlots.size() || mSlots[lo].offset != offset) {
+        return false;
+    }
+    *id = static_cast<Id>(lo);
+    return true;
+}
+
+bool DB::played(Id id)
+{
+    return history()->add(id, static_cast<std::uint32_t>(time(nullptr)));
+}
+
+std::uint32_t DB::recent(Id* ids, std::uint32_t count)
+{
+    return history()->isOpen() ? mHistory.recent(ids, count) : 0;
+}
+
+std::uint32_t DB::favourites(Id* ids, std::uint32_t count)
+{
+    return history()->isOpen() ? mHistory.favourites(ids, count) : 0;
+}
+
+std::uint16_t DB::palette(std::uint16_t* colors)
+{
+    format::DataHeader header;
+    if (!openData() || !format::readDataHeader(mData, &header)) {
+        return 0;
+    }
+    memcpy(colors, header.palette, sizeof(header.palette));
+    return header.colors;
+}
+
+BloomFilter* DB::filter(char letter)
+{
+    static const char letters[] = "0ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    if (!mFiltersLoaded) {
+        // all of them at once so lookups after this don't touch the disk
+        // for a miss
+        mFiltersLoaded = true;
+        for (int i = 0; i < 27; ++i) {
+            auto& filter = mFilters[i];
+            filter.release();
+
+            const char name[2] = { letters[i], '\0' };
+            char path[256];
+            File file;
+            format::LetterHeader header;
+            if (!format::joinPath(path, sizeof(path), mDir.c_str(), name, ".idx") || !file.open(path, File::Mode::Read)
+                || !format::readLetterHeader(file, &header) || !header.filterBytes) {
+                continue;
+            }
+            if (!filter.allocate(header.filterBytes, header.filterHashes)
+                || !file.seek(format::LetterHeaderSize + header.restarts * 4)
+                || !file.readExact(filter.data(), header.filterBytes)) {
+                filter.release();
+            }
+        }
+    }
+    return &mFilters[letter == '0' ? 0 : letter - 'A' + 1];
+}
+
+DB::Id DB::find(const String& name)
+{
+    char key[collation::MaxKeyLength];
+    return find(key, collation::key(name.c_str(), name.size(), key, sizeof(key)));
+}
+
+DB::Id DB::find(const char* key, std::size_t length)
+{
+    const char letter = format::letterFor(key, length);
+    const auto filter = this->filter(letter);
+    const bool filtered = length > 0 && filter->isValid();
+    if (filtered && !filter->mayContain(key, length)) {
+        ++mFilterStats.rejected;
+        return NoEntry;
+    }
+    const auto id = search(letter, key, length);
+    if (filtered && id == NoEntry) {
+        ++mFilterStats.falsePositives;
+    }
+    return id;
+}
+
+DB::Id DB::search(char first, const char* key, std::size_t length)
+{
+    const char letter[2] = { first, '\0' };
+    char path[256];
+    File file;
+    if (!format::joinPath(path, sizeof(path), mDir.c_str(), letter, ".idx") || !file.open(path, File::Mode::Read)) {
+        return NoEntry;
+    }
+
+    format::LetterHeader header;
+    if (!format::readLetterHeader(file, &header) || !header.count) {
+        return NoEntry;
+    }
+
+    // find the first restart that doesn't sort before the query, the first
+    // match is either that one or somewhere in the block before it
+    std::uint32_t lo = 0, hi = header.restarts;
+    while (lo < hi) {
+        const auto mid = (lo + hi) / 2;
+        std::uint32_t offset;
+        if (!format::readRestart(file, mid, &offset) || !format::readRestartEntry(file, offset, &mNameEntry)) {
+            return NoEntry;
+        }
+        if (collation::compare(mNameEntry.name, mNameEntry.length, key, length) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    const auto block = lo > 0 ? lo - 1 : 0;
+    std::uint32_t offset;
+    if (!format::readRestart(file, block, &offset) || !file.seek(offset)) {
+        return NoEntry;
+    }
+
+    // names are sorted, the first one that doesn't sort before the query
+    // is the only candidate. it's at most one block and an entry away
+    std::uint8_t buffer[512];
+    FileReader reader(&file, buffer, sizeof(buffer));
+    mNameEntry.length = 0;
+    for (auto i = block * header.interval; i < header.count; ++i) {
+        if (!format::readName(reader, &mNameEntry)) {
+            break;
+        }
+        if (collation::compare(mNameEntry.name, mNameEntry.length, key, length) < 0) {
+            continue;
+        }
+        Id id;
+        if (collation::hasPrefix(mNameEntry.name, mNameEntry.length, key, length) && idFor(mNameEntry.offset, &id)) {
+            return id;
+        }
+        break;
+    }
+    return NoEntry;
+}
+
+DB::Id DB::exact(const String& name)
+{
+    if (!openData() || !openIds()) {
+        return NoEntry;
+    }
+
+    char key[collation::MaxKeyLength];
+    const auto length = collation::key(name.c_str(), name.size(), key, sizeof(key));
+
+    // the whole key is one of its own prefixes
+    const auto letter = format::letterFor(key, length);
+    const auto filter = this->filter(letter);
+    const bool filtered = length > 0 && filter->isValid();
+    if (filtered && !filter->mayContain(key, length)) {
+        ++mFilterStats.rejected;
+        return NoEntry;
+    }
+
+    std::uint32_t offset = 0;
+    if (openExact() && mExactCount) {
+        const auto hash = PerfectHash::hash(key, length);
+        const auto seed = mSeeds[hash.bucket % mSeeds.size()];
+        const auto slot = PerfectHash::slotFor(hash, seed, mExactCount);
+        std::uint8_t off[4];
+        if (!mExact.seek(format::ExactHeaderSize + mSeeds.size() * 4 + slot * 4) || !mExact.readExact(off, sizeof(off))) {
+            return NoEntry;
+        }
+        offset = format::get32(off);
+    } else {
+        // no hash, e.g. an index from before there was one
+        const auto id = search(letter, key, length);
+        if (id == NoEntry) {
+            if (filtered) {
+                ++mFilterStats.falsePositives;
+            }
+            return id;
+        }
+        offset = mSlots[id].offset;
+    }
+
+    // anything hashes to some slot, only the record knows if it's the one
+    char recordKey[collation::MaxKeyLength];
+    if (!format::readRecord(mData, offset, &mRecord, mRecordScratch)
+        || collation::compare(recordKey, collation::key(mRecord.name, mRecord.nameLength, recordKey, sizeof(recordKey)),
+                              key, length) != 0) {
+        if (filtered) {
+            ++mFilterStats.falsePositives;
+        }
+        return NoEntry;
+    }
+    Id id;
+    if (!idFor(offset, &id)) {
+        return NoEntry;
+    }
+    ++mSlots[id].holds;
+    fill(acquire(id), mRecord, Image());
+    return id;
+}
+
+void DB::fill(Entry* entry, const format::Record& record, Image&& image)
+{
+    entry->name = record.name;
+    entry->path = record.path;
+    if (image.isValid()) {
+        entry->bitmap = SharedPtr<Image>(new Image(std::move(image)));
+        mCache.put(record.offset, entry->bitmap);
+    } else if (!entry->bitmap) {
+        entry->bitmap = mCache.get(record.offset);
+    }
+
+    // the preview only stands in until the real thing is there
+    if (entry->bitmap) {
+        entry->preview = SharedPtr<Image>();
+    } else if (!entry->preview && record.previewLength) {
+        auto preview = new Image();
+        if (format::decodePreview(record.preview, record.previewLength, preview)) {
+            entry->preview = SharedPtr<Image>(preview);
+        } else {
+            delete preview;
+        }
+    }
+}
+
+bool DB::loadImage(std::uint32_t offset, Image* image)
+{
+    char path[512];
+    File file;
+    return format::bitmapPath(path, sizeof(path), mDir.c_str(), offset) && file.open(path, File::Mode::Read)
+        && image->loadILBM(file, mImageScratch, sizeof(mImageScratch));
+}
+
+bool DB::load(Id id, bool bitmaps)
+{
+    // another holder already has it as far as it's wanted
+    const auto loaded = entry(id);
+    if (loaded && (loaded->bitmap || !bitmaps)) {
+        return true;
+    }
+    if (id >= mSlots.size() || !format::readRecord(mData, mSlots[id].offset, &mRecord, mRecordScratch)) {
+        return false;
+    }
+    auto entry = acquire(id);
+    Image image;
+    if (bitmaps && !entry->bitmap && !mCache.get(entry->offset)) {
+        loadImage(mSlots[id].offset, &image);
+    }
+    fill(entry, mRecord, std::move(image));
+    return true;
+}
+
+void DB::hydrate(Id first, int count, bool bitmaps)
+{
+    if (!openData() || !openIds()) {
+        return;
+    }
+    for (int i = 0; i < count; ++i) {
+        const auto id = first + i;
+        if (id >= mSlots.size()) {
+            break;
+        }
+        ++mSlots[id].holds;
+        load(id, bitmaps);
+    }
+}
+
+void DB::hydrateIds(const Id* ids, int count, bool bitmaps)
+{
+    if (!openData() || !openIds()) {
+        return;
+    }
+    for (int i = 0; i < count; ++i) {
+        if (ids[i] < mSlots.size()) {
+            ++mSlots[ids[i]].holds;
+            load(ids[i], bitmaps);
+        }
+    }
+}
+
+std::uint32_t DB::hydrateAsync(Id first, int count, Function<void()>&& done)
+{
+    Vector<Id> ids;
+    for (int i = 0; i < count; ++i) {
+        ids.push_back(first + i);
+    }
+    return submit(std::move(ids), std::move(done));
+}
+
+std::uint32_t DB::hydrateIdsAsync(const Id* ids, int count, Function<void()>&& done)
+{
+    Vector<Id> copy;
+    for (int i = 0; i < count; ++i) {
+        copy.push_back(ids[i]);
+    }
+    return submit(std::move(copy), std::move(done));
+}
+
+std::uint32_t DB::submit(Vector<Id>&& ids, Function<void()>&& done)
+{
+    // ids past the end are dropped here, the rest are held once done is
+    // called. only the ones no other holder has loaded go to the loader
+    Vector<Id> valid;
+    Vector<Id> needed;
+    if (openIds()) {
+        for (std::size_t i = 0; i < ids.size(); ++i) {
+            if (ids[i] >= mSlots.size()) {
+                continue;
+            }
+            valid.push_back(ids[i]);
+            const auto loaded = entry(ids[i]);
+            if ((!loaded || !loaded->bitmap) && needed.size() < 0xffff) {
+                needed.push_back(ids[i]);
+            }
+        }
+    }
+    const auto count = static_cast<std::uint16_t>(needed.size());
+    if (!count) {
+        hold(valid);
+        done();
+        return 0;
+    }
+    if (!mLoader.isRunning() && !mLoader.start(mDir.c_str())) {
+        printf("Failed to start loader, loading inline\n");
+        if (openData()) {
+            for (std::uint16_t i = 0; i < count; ++i) {
+                load(needed[i], true);
+            }
+        }
+        hold(valid);
+        done();
+        return 0;
+    }
+
+    auto job = new Loader::Job(count, true);
+    for (std::uint16_t i = 0; i < count; ++i) {
+        job->offsets[i] = mSlots[needed[i]].offset;
+    }
+    job->done = [this, valid = std::move(valid), ids = std::move(needed), done = std::move(done)](Loader::Job* finished) -> void {
+        for (std::uint16_t i = 0; i < finished->loaded; ++i) {
+            auto& result = finished->results[i];
+            fill(acquire(ids[i]), result.record, std::move(result.image));
+        }
+        hold(valid);
+        done();
+    };
+    return mLoader.submit(job);
 }
 
-SharedPtr<Entry> DB::all()
+void DB::hold(const Vector<Id>& ids)
 {
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+        ++mSlots[ids[i]].holds;
+    }
 }
 
-SharedPtr<DB::Entry> DB::find(const String& name)
+void DB::cancel(std::uint32_t id)
 {
+    mLoader.cancel(id);
 }
 
-void DB::hydrate(const SharedPtr<Entry>& entry, int count)
+void DB::dispose(Id first, int count)
 {
+    for (int i = 0; i < count; ++i) {
+        release(first + i);
+    }
 }
 
-void DB::dispose(const SharedPtr<Entry>& entry, int count)
+void DB::disposeIds(const Id* ids, int count)
 {
+    for (int i = 0; i < count; ++i) {
+        release(ids[i]);
+    }
 }
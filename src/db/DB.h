@@ -1,9 +1,18 @@
 #pragma once
 
+#include "BloomFilter.h"
+#include "EntrySet.h"
+#include "History.h"
+#include "Image.h"
+#include "ImageCache.h"
+#include "Loader.h"
+#include "Order.h"
+#include "util/Function.h"
 #include "util/String.h"
 #include "util/SharedPtr.h"
-
-struct BitMap;
+#include "util/Vector.h"
+#include <cstddef>
+#include <cstdint>
 
 namespace trost {
 
@@ -11,28 +20,216 @@ class DB
 {
 public:
     DB(const String& dir);
+    ~DB();
+
+    DB(const DB&) = delete;
+    DB& operator=(const DB&) = delete;
+
+    // thumbnails are scaled to fit in thumbnailWidth x thumbnailHeight,
+    // dither trades banding for a bit of noise
+    struct IndexOptions
+    {
+        std::uint16_t thumbnailWidth = 96;
+        std::uint16_t thumbnailHeight = 72;
+        bool dither = true;
+        // false positives per thousand misses the letter filters are
+        // sized for
+        std::uint16_t filterPerMille = 20;
+        // attributes to keep an order by, a leading - for descending.
+        // numeric values sort by value
+        const char* orders = "year;publisher";
+        // bytes the entries are sorted in, anything past that goes to
+        // temp files in the db directory and is merged back
+        std::uint32_t sortBudget = 32 * 1024;
+    };
+
+    // builds data.idx and the letter files from games.txt in the db
+    // directory, one entry per line as name<TAB>path<TAB>image<TAB>attributes.
+    // the image column is optional, when it's there the picture is turned
+    // into the entry's thumbnail using the palette shared by all of them.
+    // attributes are optional too, as "genre=Platform; year=1991; ..."
+    bool createIndex();
+    bool createIndex(const IndexOptions& options);
 
-    void createIndex();
+    // rejected counts lookups the letter filters turned down without
+    // reading anything, falsePositives the ones they let through that
+    // missed anyway
+    struct FilterStats
+    {
+        std::uint32_t rejected;
+        std::uint32_t falsePositives;
+    };
+    const FilterStats& filterStats() const;
+    void resetFilterStats();
+
+    // fills format::PaletteSize 0x0RGB entries with the shared thumbnail
+    // palette and returns how many are used, 0 if there is none. the first
+    // format::ReservedPens belong to the interface and should be left alone
+    std::uint16_t palette(std::uint16_t* colors);
+
+    // entries are known by id, their position in name order from 0 to
+    // entryCount() - 1. until one is hydrated all there is of it is a
+    // 12 byte Slot in an array by id, so walking any distance costs nothing
+    using Id = std::uint32_t;
+    static constexpr Id NoEntry = 0xffffffff;
 
     struct Entry
     {
         String name;
         String path;
-        SharedPtr<BitMap> bitmap;
+        SharedPtr<Image> bitmap;
+        // low resolution stand-in for bitmap, already scaled up to about
+        // the same size. dropped once bitmap is loaded
+        SharedPtr<Image> preview;
 
-        SharedPtr<Entry> next;
-
-        UWORD offset;
+        Id id;
+        std::uint32_t offset;
     };
 
-    SharedPtr<Entry> find(const String& name);
-    SharedPtr<Entry> all();
+    // first entry starting with name, compared by collation key. the ones
+    // after it in name order are the ids that follow. NoEntry if none
+    Id find(const String& name);
+    // same with a key that's already been made, e.g. KeyInput::key
+    Id find(const char* key, std::size_t length);
+    // the entry whose key is name's. one hash and one record read, the
+    // entry comes back hydrated without its bitmap and held the same as
+    // after hydrate(), dispose it when done with it
+    Id exact(const String& name);
+
+    std::uint32_t entryCount();
+    // the entries whose attribute is value, e.g. "year" and "1991", both
+    // compared the way names are. set is sized for every entry and left
+    // empty if there is no such value
+    bool select(const char* attribute, const char* value, EntrySet* set);
+    // every value attribute has with the number of entries having it
+    void values(const char* attribute, Function<void(const char* value, std::uint32_t members)>&& callback);
+    // up to count ids of the members of set starting with its first-th,
+    // returns how many there were
+    std::uint32_t entries(const EntrySet& set, std::uint32_t first, Id* ids, std::uint32_t count);
+
+    // the ids ordered by attribute as listed in IndexOptions::orders,
+    // e.g. "year". a single read, two bytes an entry unless there are
+    // more than 65536 of them
+    bool order(const char* attribute, Order* order);
+    // every order there is and whether it's descending
+    void orders(Function<void(const char* attribute, bool descending)>&& callback);
+    // a page of an order, same as the one for sets. Cursor walks a whole
+    // one a window at a time
+    std::uint32_t entries(const Order& order, std::uint32_t first, Id* ids, std::uint32_t count);
+
+    // count entries from first in name order. without bitmaps only the
+    // records are read, which gives names and previews for a first paint.
+    // every hydrate holds each id once and every dispose lets go of one
+    // hold, an entry is only freed when nobody holds it any more. ids
+    // someone else already loaded aren't read again
+    void hydrate(Id first, int count, bool bitmaps = true);
+    // same for any ids, e.g. a page of an order. ...Ids so 0 is always
+    // the first id and never a null list
+    void hydrateIds(const Id* ids, int count, bool bitmaps = true);
+    // like hydrate but the reads and decoding happen on the loader, done
+    // is called from the main loop once the entries are filled in. the
+    // returned id can be passed to cancel, 0 means it was done inline.
+    // the ids are held from when done is called, a cancelled request
+    // holds nothing and has nothing to dispose
+    std::uint32_t hydrateAsync(Id first, int count, Function<void()>&& done);
+    std::uint32_t hydrateIdsAsync(const Id* ids, int count, Function<void()>&& done);
+    void cancel(std::uint32_t id);
+    void dispose(Id first, int count);
+    void disposeIds(const Id* ids, int count);
+    // null unless id is hydrated. there's one Entry per id however many
+    // times it's hydrated, it stays put until its last hold is disposed
+    // or the index is rebuilt, which drops every hold
+    const Entry* entry(Id id) const;
+
+    // thumbnails outlive dispose in here until the budget runs out
+    ImageCache* cache();
 
-    void hydrate(const SharedPtr<Entry>& entry, int count);
-    void dispose(const SharedPtr<Entry>& entry, int count);
+    // without the App loop, e.g. on the host, finished loads are picked
+    // up through this
+    Loader* loader();
+
+    // logs a play of id now, for recent() and favourites()
+    bool played(Id id);
+    // up to count ids, the most recently played first. returns how many
+    std::uint32_t recent(Id* ids, std::uint32_t count);
+    // same for the most played
+    std::uint32_t favourites(Id* ids, std::uint32_t count);
+    // the play history, opened on first use
+    History* history();
 
 private:
+    // what's kept of every entry, by id. entry is where it is in mEntries
+    // plus one while it's hydrated, 0 otherwise. holds counts hydrates not
+    // yet disposed
+    struct Slot
+    {
+        std::uint32_t offset;
+        std::uint32_t entry;
+        std::uint32_t holds;
+    };
+
+    bool openData();
+    bool openExact();
+    bool openIds();
+    bool idFor(std::uint32_t offset, Id* id);
+    Entry* acquire(Id id);
+    void release(Id id);
+    void clearEntries();
+    BloomFilter* filter(char letter);
+    Id search(char letter, const char* key, std::size_t length);
+    void fill(Entry* entry, const format::Record& record, Image&& image);
+    bool load(Id id, bool bitmaps);
+    bool loadImage(std::uint32_t offset, Image* image);
+    std::uint32_t submit(Vector<Id>&& ids, Function<void()>&& done);
+    void hold(const Vector<Id>& ids);
+
     String mDir;
+    File mData;
+    File mExact;
+    // seeds are read once, the slots are looked up on disk
+    Vector<std::uint32_t> mSeeds;
+    std::uint32_t mExactCount = 0;
+    // read from ids.idx on first use
+    Vector<Slot> mSlots;
+    bool mIdsLoaded = false;
+    // the hydrated entries, null where one was disposed and mFree says so
+    Vector<Entry*> mEntries;
+    Vector<std::uint32_t> mFree;
+    History mHistory;
+    BloomFilter mFilters[27];
+    bool mFiltersLoaded = false;
+    FilterStats mFilterStats = {};
+    format::Record mRecord;
+    format::NameEntry mNameEntry;
+    std::uint8_t mRecordScratch[format::MaxRecordSize];
+    std::uint8_t mImageScratch[2048];
+    Loader mLoader;
+    ImageCache mCache;
 };
 
+inline const DB::FilterStats& DB::filterStats() const
+{
+    return mFilterStats;
+}
+
+inline void DB::resetFilterStats()
+{
+    mFilterStats = {};
+}
+
+inline Loader* DB::loader()
+{
+    return &mLoader;
+}
+
+inline const DB::Entry* DB::entry(Id id) const
+{
+    return id < mSlots.size() && mSlots[id].entry ? mEntries[mSlots[id].entry - 1] : nullptr;
+}
+
+inline ImageCache* DB::cache()
+{
+    return &mCache;
+}
+
 }; // namespace trost
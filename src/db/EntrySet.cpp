@@ -0,0 +1,239 @@
+#include "EntrySet.h"
+#include <cstring>
+#include <utility>
+
+using namespace trost;
+
+static inline std::uint32_t words_for(std::uint32_t size)
+{
+    return (size + 31) >> 5;
+}
+
+EntrySet::~EntrySet()
+{
+    release();
+}
+
+EntrySet::EntrySet(EntrySet&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+EntrySet& EntrySet::operator=(EntrySet&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        mWords = other.mWords;
+        mSize = other.mSize;
+        other.mWords = nullptr;
+        other.mSize = 0;
+    }
+    return *this;
+}
+
+bool EntrySet::allocate(std::uint32_t size, bool full)
+{
+    release();
+    const auto words = words_for(size);
+    mWords = new std::uint32_t[words ? words : 1];
+    if (!mWords) {
+        return false;
+    }
+    mSize = size;
+    memset(mWords, full ? 0xff : 0, words * sizeof(std::uint32_t));
+    // bits past the end stay clear so count and next don't see them
+    if (full && (size & 31)) {
+        mWords[words - 1] = (1UL << (size & 31)) - 1;
+    }
+    return true;
+}
+
+bool EntrySet::copy(const EntrySet& other)
+{
+    if (!allocate(other.mSize)) {
+        return false;
+    }
+    memcpy(mWords, other.mWords, words_for(mSize) * sizeof(std::uint32_t));
+    return true;
+}
+
+void EntrySet::release()
+{
+    delete[] mWords;
+    mWords = nullptr;
+    mSize = 0;
+}
+
+void EntrySet::intersect(const EntrySet& other)
+{
+    const auto words = words_for(mSize);
+    for (std::uint32_t i = 0; i < words; ++i) {
+        mWords[i] &= other.mWords[i];
+    }
+}
+
+void EntrySet::unite(const EntrySet& other)
+{
+    const auto words = words_for(mSize);
+    for (std::uint32_t i = 0; i < words; ++i) {
+        mWords[i] |= other.mWords[i];
+    }
+}
+
+void EntrySet::subtract(const EntrySet& other)
+{
+    const auto words = words_for(mSize);
+    for (std::uint32_t i = 0; i < words; ++i) {
+        mWords[i] &= ~other.mWords[i];
+    }
+}
+
+std::uint32_t EntrySet::count() const
+{
+    std::uint32_t n = 0;
+    const auto words = words_for(mSize);
+    for (std::uint32_t i = 0; i < words; ++i) {
+        n += __builtin_popcountl(mWords[i]);
+    }
+    return n;
+}
+
+std::uint32_t EntrySet::next(std::uint32_t from) const
+{
+    if (from >= mSize) {
+        return mSize;
+    }
+    const auto words = words_for(mSize);
+    auto i = from >> 5;
+    auto word = mWords[i] & (~0UL << (from & 31));
+    while (!word) {
+        if (++i == words) {
+            return mSize;
+        }
+        word = mWords[i];
+    }
+    return (i << 5) + __builtin_ctzl(word);
+}
+
+std::uint32_t EntrySet::nth(std::uint32_t n) const
+{
+    // whole words first, then bit by bit in the one it's in
+    const auto words = words_for(mSize);
+    for (std::uint32_t i = 0; i < words; ++i) {
+        const auto bits = static_cast<std::uint32_t>(__builtin_popcountl(mWords[i]));
+        if (n >= bits) {
+            n -= bits;
+            continue;
+        }
+        auto word = mWords[i];
+        while (n--) {
+            word &= word - 1;
+        }
+        return (i << 5) + __builtin_ctzl(word);
+    }
+    return mSize;
+}
+
+EntrySet::Encoding EntrySet::encoding() const
+{
+    return encodedSize(Encoding::Deltas) < encodedSize(Encoding::Bitmap) ? Encoding::Deltas : Encoding::Bitmap;
+}
+
+std::uint32_t EntrySet::deltaSize(std::uint32_t delta)
+{
+    std::uint32_t n = 1;
+    while (delta >= 0x80) {
+        delta >>= 7;
+        ++n;
+    }
+    return n;
+}
+
+bool EntrySet::encodeDelta(std::uint32_t delta, FileWriter& writer)
+{
+    std::uint8_t buf[5];
+    std::uint32_t n = 0;
+    while (delta >= 0x80) {
+        buf[n++] = static_cast<std::uint8_t>(delta | 0x80);
+        delta >>= 7;
+    }
+    buf[n++] = static_cast<std::uint8_t>(delta);
+    return writer.write(buf, n);
+}
+
+std::uint32_t EntrySet::encodedSize(Encoding encoding) const
+{
+    if (encoding == Encoding::Bitmap) {
+        return (mSize + 7) >> 3;
+    }
+    std::uint32_t n = 0;
+    std::uint32_t previous = 0;
+    for (auto id = next(0); id < mSize; id = next(id + 1)) {
+        n += deltaSize(id - previous);
+        previous = id;
+    }
+    return n;
+}
+
+bool EntrySet::encode(Encoding encoding, FileWriter& writer) const
+{
+    if (encoding == Encoding::Bitmap) {
+        // bytes in id order, lowest id in the lowest bit
+        const auto bytes = (mSize + 7) >> 3;
+        for (std::uint32_t i = 0; i < bytes; ++i) {
+            const auto byte = static_cast<std::uint8_t>(mWords[i >> 2] >> ((i & 3) * 8));
+            if (!writer.write(&byte, 1)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    std::uint32_t previous = 0;
+    for (auto id = next(0); id < mSize; id = next(id + 1)) {
+        if (!encodeDelta(id - previous, writer)) {
+            return false;
+        }
+        previous = id;
+    }
+    return true;
+}
+
+bool EntrySet::decode(Encoding encoding, std::uint32_t length, FileReader& reader)
+{
+    memset(mWords, 0, words_for(mSize) * sizeof(std::uint32_t));
+    if (encoding == Encoding::Bitmap) {
+        if (length != (mSize + 7) >> 3) {
+            return false;
+        }
+        for (std::uint32_t i = 0; i < length; ++i) {
+            const auto byte = reader.get();
+            if (byte < 0) {
+                return false;
+            }
+            mWords[i >> 2] |= static_cast<std::uint32_t>(byte) << ((i & 3) * 8);
+        }
+        return true;
+    }
+    std::uint32_t id = 0;
+    std::uint32_t delta = 0;
+    unsigned int shift = 0;
+    for (std::uint32_t i = 0; i < length; ++i) {
+        const auto byte = reader.get();
+        if (byte < 0 || shift > 28) {
+            return false;
+        }
+        delta |= static_cast<std::uint32_t>(byte & 0x7f) << shift;
+        shift += 7;
+        if (byte & 0x80) {
+            continue;
+        }
+        id += delta;
+        if (id >= mSize) {
+            return false;
+        }
+        add(id);
+        delta = 0;
+        shift = 0;
+    }
+    return shift == 0;
+}
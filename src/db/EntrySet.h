@@ -0,0 +1,79 @@
+#pragma once
+
+#include "File.h"
+#include <cstdint>
+
+namespace trost {
+
+// A set of entry ids, an id being an entry's position in name order.
+// Attribute filters come off disk as these and are combined in memory
+// with intersect and unite. Stored as a plain bitset, a few hundred bytes
+// for a big collection.
+class EntrySet
+{
+public:
+    EntrySet() = default;
+    ~EntrySet();
+
+    EntrySet(EntrySet&& other) noexcept;
+    EntrySet& operator=(EntrySet&& other) noexcept;
+
+    EntrySet(const EntrySet&) = delete;
+    EntrySet& operator=(const EntrySet&) = delete;
+
+    // room for ids below size, either all of them or none
+    bool allocate(std::uint32_t size, bool full = false);
+    bool copy(const EntrySet& other);
+    void release();
+
+    std::uint32_t size() const;
+    void add(std::uint32_t id);
+    bool contains(std::uint32_t id) const;
+
+    // both sets have to be the same size
+    void intersect(const EntrySet& other);
+    void unite(const EntrySet& other);
+    void subtract(const EntrySet& other);
+
+    std::uint32_t count() const;
+    // the first id at or after from, size() if there is none
+    std::uint32_t next(std::uint32_t from) const;
+    // the id of the nth member, size() if there are fewer
+    std::uint32_t nth(std::uint32_t n) const;
+
+    // on disk a set is either the bitset as bytes or its ids as varint
+    // deltas, whichever is smaller
+    enum class Encoding : std::uint8_t {
+        Bitmap,
+        Deltas,
+    };
+    Encoding encoding() const;
+    std::uint32_t encodedSize(Encoding encoding) const;
+    bool encode(Encoding encoding, FileWriter& writer) const;
+    // the deltas one at a time, for writing a set that's never built,
+    // delta being the id less the one before, or the id for the first
+    static std::uint32_t deltaSize(std::uint32_t delta);
+    static bool encodeDelta(std::uint32_t delta, FileWriter& writer);
+    bool decode(Encoding encoding, std::uint32_t length, FileReader& reader);
+
+private:
+    std::uint32_t* mWords = nullptr;
+    std::uint32_t mSize = 0;
+};
+
+inline std::uint32_t EntrySet::size() const
+{
+    return mSize;
+}
+
+inline void EntrySet::add(std::uint32_t id)
+{
+    mWords[id >> 5] |= 1UL << (id & 31);
+}
+
+inline bool EntrySet::contains(std::uint32_t id) const
+{
+    return id < mSize && (mWords[id >> 5] & (1UL << (id & 31)));
+}
+
+} // namespace trost
@@ -0,0 +1,292 @@
+#include "ExternalSort.h"
+#include "Format.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+using namespace trost;
+
+// read buffer for each run being merged, its current record comes on top
+static constexpr std::uint32_t MergeBuffer = 512;
+
+// records are stored as u16 length and the bytes, in memory and in runs
+static constexpr std::uint32_t RecordHeader = 2;
+
+struct ExternalSort::Input
+{
+    Input(std::uint8_t* buffer, std::uint8_t* slot)
+        : reader(&file, buffer, MergeBuffer), record(slot)
+    {
+    }
+
+    // 1 for a record, 0 at the end of the run and -1 if it's broken
+    int advance(std::uint32_t maxRecord)
+    {
+        const auto hi = reader.get();
+        if (hi < 0) {
+            return 0;
+        }
+        const auto lo = reader.get();
+        if (lo < 0) {
+            return -1;
+        }
+        length = static_cast<std::uint32_t>((hi << 8) | lo);
+        return length <= maxRecord && reader.read(record, length) ? 1 : -1;
+    }
+
+    File file;
+    FileReader reader;
+    std::uint8_t* record;
+    std::uint32_t length = 0;
+};
+
+ExternalSort::ExternalSort(const char* dir, const char* name, std::uint32_t budget, std::uint32_t maxRecord,
+                           Compare compare)
+    : mCompare(compare), mMaxRecord(maxRecord)
+{
+    strncpy(mDir, dir, sizeof(mDir) - 1);
+    strncpy(mName, name, sizeof(mName) - 1);
+    const auto least = 2 * (MergeBuffer + RecordHeader + maxRecord);
+    mBudget = ((budget > least ? budget : least) + 3) & ~3U;
+    mArena = new std::uint8_t[mBudget];
+    mFailed = !mArena;
+}
+
+ExternalSort::~ExternalSort()
+{
+    delete mReader;
+    mFile.close();
+    char path[256];
+    for (std::uint32_t run = 0; run < mNextRun; ++run) {
+        if (runPath(path, sizeof(path), run)) {
+            File::remove(path);
+        }
+    }
+    delete[] mArena;
+}
+
+bool ExternalSort::runPath(char* out, std::uint32_t size, std::uint32_t run) const
+{
+    char name[48];
+    snprintf(name, sizeof(name), "%s%lu", mName, static_cast<unsigned long>(run));
+    return format::joinPath(out, size, mDir, name, ".tmp");
+}
+
+std::uint32_t* ExternalSort::index() const
+{
+    return reinterpret_cast<std::uint32_t*>(mArena + mBudget) - mBuffered;
+}
+
+bool ExternalSort::add(const void* record, std::uint32_t length)
+{
+    if (mFinished || mFailed || length > mMaxRecord) {
+        return false;
+    }
+    if (mUsed + RecordHeader + length + (mBuffered + 1) * 4 > mBudget && !spill()) {
+        return false;
+    }
+    auto p = mArena + mUsed;
+    format::put16(p, static_cast<std::uint16_t>(length));
+    memcpy(p + RecordHeader, record, length);
+    ++mBuffered;
+    index()[0] = mUsed;
+    mUsed += RecordHeader + length;
+    ++mCount;
+    return true;
+}
+
+void ExternalSort::sort()
+{
+    auto idx = index();
+    std::sort(idx, idx + mBuffered, [this](std::uint32_t a, std::uint32_t b) -> bool {
+        const auto pa = mArena + a;
+        const auto pb = mArena + b;
+        return mCompare(pa + RecordHeader, format::get16(pa), pb + RecordHeader, format::get16(pb)) < 0;
+    });
+}
+
+bool ExternalSort::spill()
+{
+    sort();
+
+    char path[256];
+    File file;
+    if (!runPath(path, sizeof(path), mNextRun) || !file.open(path, File::Mode::Write)) {
+        printf("Failed to create %s\n", path);
+        mFailed = true;
+        return false;
+    }
+    ++mNextRun;
+    FileWriter out(&file, mBuffer, sizeof(mBuffer));
+    const auto idx = index();
+    for (std::uint32_t i = 0; i < mBuffered; ++i) {
+        const auto p = mArena + idx[i];
+        out.write(p, RecordHeader + format::get16(p));
+    }
+    if (!out.flush()) {
+        printf("Failed to write %s\n", path);
+        mFailed = true;
+        return false;
+    }
+    ++mRuns;
+    mUsed = 0;
+    mBuffered = 0;
+    return true;
+}
+
+bool ExternalSort::finish()
+{
+    if (mFinished || mFailed) {
+        return mFinished && !mFailed;
+    }
+    mFinished = true;
+
+    // it all fit, read it straight from memory
+    if (!mRuns) {
+        sort();
+        mPosition = 0;
+        return true;
+    }
+    if (mBuffered && !spill()) {
+        return false;
+    }
+
+    // as many runs at a time as there's room for, the result goes to the
+    // back of the line until there's one left
+    auto fanIn = mBudget / (MergeBuffer + RecordHeader + mMaxRecord);
+    if (fanIn < 2) {
+        fanIn = 2;
+    }
+    std::uint32_t first = 0;
+    while (mNextRun - first > 1) {
+        const auto count = std::min(fanIn, mNextRun - first);
+        if (!merge(first, count, mNextRun++)) {
+            mFailed = true;
+            return false;
+        }
+        first += count;
+    }
+
+    char path[256];
+    if (!runPath(path, sizeof(path), first) || !mFile.open(path, File::Mode::Read)) {
+        printf("Failed to open %s\n", path);
+        mFailed = true;
+        return false;
+    }
+    // the last mMaxRecord bytes of the arena hold the current record
+    mReader = new FileReader(&mFile, mArena, mBudget - mMaxRecord);
+    return true;
+}
+
+bool ExternalSort::merge(std::uint32_t first, std::uint32_t count, std::uint32_t into)
+{
+    char path[256];
+    auto inputs = new Input*[count];
+    auto heap = new std::uint32_t[count];
+    std::uint32_t live = 0;
+    bool ok = true;
+    for (std::uint32_t i = 0; i < count; ++i) {
+        const auto base = mArena + i * (MergeBuffer + RecordHeader + mMaxRecord);
+        inputs[i] = new Input(base, base + MergeBuffer);
+        if (!runPath(path, sizeof(path), first + i) || !inputs[i]->file.open(path, File::Mode::Read)) {
+            printf("Failed to open %s\n", path);
+            ok = false;
+            continue;
+        }
+        const auto got = inputs[i]->advance(mMaxRecord);
+        if (got > 0) {
+            heap[live++] = i;
+        }
+        ok = ok && got >= 0;
+    }
+
+    File file;
+    if (!runPath(path, sizeof(path), into) || !file.open(path, File::Mode::Write)) {
+        printf("Failed to create %s\n", path);
+        ok = false;
+    }
+    if (ok) {
+        // smallest record on top
+        auto greater = [this, inputs](std::uint32_t a, std::uint32_t b) -> bool {
+            return mCompare(inputs[a]->record, inputs[a]->length, inputs[b]->record, inputs[b]->length) > 0;
+        };
+        FileWriter out(&file, mBuffer, sizeof(mBuffer));
+        std::make_heap(heap, heap + live, greater);
+        while (live > 0 && ok) {
+            std::pop_heap(heap, heap + live, greater);
+            const auto input = inputs[heap[live - 1]];
+            std::uint8_t length[RecordHeader];
+            format::put16(length, static_cast<std::uint16_t>(input->length));
+            out.write(length, sizeof(length));
+            out.write(input->record, input->length);
+            const auto got = input->advance(mMaxRecord);
+            if (got > 0) {
+                std::push_heap(heap, heap + live, greater);
+            } else {
+                --live;
+                ok = got == 0;
+            }
+        }
+        ok = out.flush() && ok;
+        if (!ok) {
+            printf("Failed to merge into %s\n", path);
+        }
+    }
+
+    // the merged runs aren't needed any more either way
+    for (std::uint32_t i = 0; i < count; ++i) {
+        delete inputs[i];
+        if (runPath(path, sizeof(path), first + i)) {
+            File::remove(path);
+        }
+    }
+    delete[] inputs;
+    delete[] heap;
+    return ok;
+}
+
+bool ExternalSort::next(const std::uint8_t** record, std::uint32_t* length)
+{
+    if (!mFinished || mFailed) {
+        return false;
+    }
+    if (!mReader) {
+        if (mPosition >= mCount) {
+            return false;
+        }
+        const auto p = mArena + index()[mPosition++];
+        *record = p + RecordHeader;
+        *length = format::get16(p);
+        return true;
+    }
+    const auto hi = mReader->get();
+    const auto lo = hi >= 0 ? mReader->get() : -1;
+    if (lo < 0) {
+        return false;
+    }
+    const auto slot = mArena + mBudget - mMaxRecord;
+    const auto size = static_cast<std::uint32_t>((hi << 8) | lo);
+    if (size > mMaxRecord || !mReader->read(slot, size)) {
+        return false;
+    }
+    *record = slot;
+    *length = size;
+    return true;
+}
+
+std::uint32_t ExternalSort::position() const
+{
+    return mReader ? mReader->position() : mPosition;
+}
+
+bool ExternalSort::seek(std::uint32_t position)
+{
+    if (!mFinished || mFailed) {
+        return false;
+    }
+    if (!mReader) {
+        mPosition = position;
+        return true;
+    }
+    return mReader->seek(position);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "File.h"
+#include <cstdint>
+
+namespace trost {
+
+// Sorts more records than fit in memory. Records are collected until the
+// budget is used up, sorted and written out as a run, and the runs are
+// merged into one sorted file at the end, several at a time if there are
+// more than the budget has room for. When everything fits nothing is
+// written and the records are read back from memory.
+//
+// The budget is all the sort ever allocates apart from a few bytes per
+// run while merging, so the same collection sorts the same way with the
+// same files on the Amiga as on the host.
+class ExternalSort
+{
+public:
+    // negative, 0 or positive like memcmp. records that compare equal
+    // come out in no particular order, so for output that doesn't depend
+    // on the budget equal should mean the same bytes
+    using Compare = int (*)(const std::uint8_t* a, std::uint32_t alength, const std::uint8_t* b, std::uint32_t blength);
+
+    // runs are written to dir as name0.tmp, name1.tmp and so on. records
+    // can be up to maxRecord bytes, the budget is raised to what merging
+    // two runs of those takes if it's less
+    ExternalSort(const char* dir, const char* name, std::uint32_t budget, std::uint32_t maxRecord, Compare compare);
+    ~ExternalSort();
+
+    ExternalSort(const ExternalSort&) = delete;
+    ExternalSort& operator=(const ExternalSort&) = delete;
+
+    bool add(const void* record, std::uint32_t length);
+    // sorts and merges whatever was added, the records can be read after
+    bool finish();
+
+    std::uint32_t count() const;
+    // how many runs were written before merging, 0 if it all fit
+    std::uint32_t runs() const;
+
+    // the records in order, each one valid until the next call
+    bool next(const std::uint8_t** record, std::uint32_t* length);
+    // where the next record is, to get back to it with seek
+    std::uint32_t position() const;
+    bool seek(std::uint32_t position);
+    bool rewind();
+
+private:
+    struct Input;
+
+    bool runPath(char* out, std::uint32_t size, std::uint32_t run) const;
+    void sort();
+    bool spill();
+    bool merge(std::uint32_t first, std::uint32_t count, std::uint32_t into);
+    std::uint32_t* index() const;
+
+    char mDir[256] = {};
+    char mName[32] = {};
+    Compare mCompare;
+    std::uint32_t mBudget;
+    std::uint32_t mMaxRecord;
+    std::uint8_t* mArena = nullptr;
+
+    // while adding, records from the front of the arena and their offsets
+    // from the back
+    std::uint32_t mUsed = 0;
+    std::uint32_t mBuffered = 0;
+    std::uint32_t mCount = 0;
+    std::uint32_t mRuns = 0;
+    std::uint32_t mNextRun = 0;
+    bool mFinished = false;
+    bool mFailed = false;
+
+    // reading back
+    File mFile;
+    FileReader* mReader = nullptr;
+    std::uint32_t mPosition = 0;
+
+    std::uint8_t mBuffer[512];
+};
+
+inline std::uint32_t ExternalSort::count() const
+{
+    return mCount;
+}
+
+inline std::uint32_t ExternalSort::runs() const
+{
+    return mRuns;
+}
+
+inline bool ExternalSort::rewind()
+{
+    return seek(0);
+}
+
+} // namespace trost
@@ -0,0 +1,240 @@
+#include "File.h"
+#include <cstring>
+#if defined(__amigaos__)
+#include <clib/dos_protos.h>
+#include <dos/dos.h>
+#else
+#include <cerrno>
+#include <cstdio>
+#include <sys/stat.h>
+#endif
+
+using namespace trost;
+
+File::~File()
+{
+    close();
+}
+
+#if defined(__amigaos__)
+
+bool File::open(const char* path, Mode mode)
+{
+    close();
+    if (mode == Mode::Append) {
+        mHandle = Open(path, MODE_READWRITE);
+        if (mHandle && Seek(mHandle, 0, OFFSET_END) == -1) {
+            close();
+        }
+        return mHandle != 0;
+    }
+    mHandle = Open(path, mode == Mode::Read ? MODE_OLDFILE : MODE_NEWFILE);
+    return mHandle != 0;
+}
+
+void File::close()
+{
+    if (mHandle) {
+        Close(mHandle);
+        mHandle = 0;
+    }
+}
+
+bool File::seek(std::uint32_t offset)
+{
+    return Seek(mHandle, offset, OFFSET_BEGINNING) != -1;
+}
+
+long File::size()
+{
+    // Seek returns where it was, so seeking back gives the end
+    const auto position = Seek(mHandle, 0, OFFSET_END);
+    return position == -1 ? -1 : Seek(mHandle, position, OFFSET_BEGINNING);
+}
+
+long File::read(void* data, std::uint32_t size)
+{
+    return Read(mHandle, data, size);
+}
+
+bool File::write(const void* data, std::uint32_t size)
+{
+    return Write(mHandle, data, size) == static_cast<LONG>(size);
+}
+
+bool File::createDirectory(const char* path)
+{
+    auto lock = CreateDir(path);
+    if (!lock) {
+        lock = Lock(path, ACCESS_READ);
+    }
+    if (!lock) {
+        return false;
+    }
+    UnLock(lock);
+    return true;
+}
+
+bool File::remove(const char* path)
+{
+    return DeleteFile(path) != 0;
+}
+
+bool File::rename(const char* from, const char* to)
+{
+    return Rename(from, to) != 0;
+}
+
+#else
+
+bool File::open(const char* path, Mode mode)
+{
+    close();
+    mHandle = fopen(path, mode == Mode::Read ? "rb" : mode == Mode::Write ? "wb" : "ab");
+    return mHandle != nullptr;
+}
+
+void File::close()
+{
+    if (mHandle) {
+        fclose(static_cast<FILE*>(mHandle));
+        mHandle = nullptr;
+    }
+}
+
+bool File::seek(std::uint32_t offset)
+{
+    return fseek(static_cast<FILE*>(mHandle), offset, SEEK_SET) == 0;
+}
+
+long File::size()
+{
+    auto file = static_cast<FILE*>(mHandle);
+    const auto position = ftell(file);
+    if (position < 0 || fseek(file, 0, SEEK_END) != 0) {
+        return -1;
+    }
+    const auto end = ftell(file);
+    return fseek(file, position, SEEK_SET) == 0 ? end : -1;
+}
+
+long File::read(void* data, std::uint32_t size)
+{
+    const auto got = fread(data, 1, size, static_cast<FILE*>(mHandle));
+    if (got < size && ferror(static_cast<FILE*>(mHandle))) {
+        return -1;
+    }
+    return static_cast<long>(got);
+}
+
+bool File::write(const void* data, std::uint32_t size)
+{
+    return fwrite(data, 1, size, static_cast<FILE*>(mHandle)) == size;
+}
+
+bool File::createDirectory(const char* path)
+{
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+bool File::remove(const char* path)
+{
+    return ::remove(path) == 0;
+}
+
+bool File::rename(const char* from, const char* to)
+{
+    return ::rename(from, to) == 0;
+}
+
+#endif
+
+FileReader::FileReader(File* file, std::uint8_t* buffer, std::uint32_t size)
+    : mFile(file), mBuffer(buffer), mSize(size)
+{
+}
+
+bool FileReader::fill()
+{
+    mConsumed += mLength;
+    mPos = 0;
+    const auto got = mFile->read(mBuffer, mSize);
+    mLength = got > 0 ? static_cast<std::uint32_t>(got) : 0;
+    return mLength > 0;
+}
+
+bool FileReader::read(void* data, std::uint32_t size)
+{
+    auto out = static_cast<std::uint8_t*>(data);
+    while (size > 0) {
+        if (mPos == mLength && !fill()) {
+            return false;
+        }
+        auto chunk = mLength - mPos;
+        if (chunk > size) {
+            chunk = size;
+        }
+        memcpy(out, mBuffer + mPos, chunk);
+        out += chunk;
+        mPos += chunk;
+        size -= chunk;
+    }
+    return true;
+}
+
+bool FileReader::skip(std::uint32_t size)
+{
+    while (size > 0) {
+        if (mPos == mLength && !fill()) {
+            return false;
+        }
+        auto chunk = mLength - mPos;
+        if (chunk > size) {
+            chunk = size;
+        }
+        mPos += chunk;
+        size -= chunk;
+    }
+    return true;
+}
+
+bool FileReader::seek(std::uint32_t offset)
+{
+    mPos = mLength = 0;
+    mConsumed = offset;
+    return mFile->seek(offset);
+}
+
+FileWriter::FileWriter(File* file, std::uint8_t* buffer, std::uint32_t size)
+    : mFile(file), mBuffer(buffer), mSize(size)
+{
+}
+
+bool FileWriter::write(const void* data, std::uint32_t size)
+{
+    auto in = static_cast<const std::uint8_t*>(data);
+    while (size > 0 && !mFailed) {
+        if (mPos == mSize && !flush()) {
+            break;
+        }
+        auto chunk = mSize - mPos;
+        if (chunk > size) {
+            chunk = size;
+        }
+        memcpy(mBuffer + mPos, in, chunk);
+        in += chunk;
+        mPos += chunk;
+        size -= chunk;
+    }
+    return !mFailed;
+}
+
+bool FileWriter::flush()
+{
+    if (mPos > 0 && !mFailed) {
+        mFailed = !mFile->write(mBuffer, mPos);
+        mFlushed += mPos;
+        mPos = 0;
+    }
+    return !mFailed;
+}
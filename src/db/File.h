@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+
+namespace trost {
+
+// Unbuffered file access. On AmigaOS this goes straight to dos.library so
+// it can be used from any process, including the background loader,
+// elsewhere it's stdio.
+class File
+{
+public:
+    enum class Mode {
+        Read,
+        Write,
+        // writes go to the end, the file is created if it isn't there
+        Append,
+    };
+
+    File() = default;
+    ~File();
+
+    File(const File&) = delete;
+    File& operator=(const File&) = delete;
+
+    bool open(const char* path, Mode mode);
+    void close();
+    bool isOpen() const;
+
+    bool seek(std::uint32_t offset);
+    // -1 if it can't be told, the position is left where it was
+    long size();
+    // returns the number of bytes read, short at end of file, -1 on error
+    long read(void* data, std::uint32_t size);
+    bool readExact(void* data, std::uint32_t size);
+    bool write(const void* data, std::uint32_t size);
+
+    // succeeds if the directory exists afterwards, parents aren't created
+    static bool createDirectory(const char* path);
+    static bool remove(const char* path);
+    // to mustn't exist
+    static bool rename(const char* from, const char* to);
+
+private:
+#if defined(__amigaos__)
+    long mHandle = 0;
+#else
+    void* mHandle = nullptr;
+#endif
+};
+
+// Buffered sequential reads on top of a File. The buffer belongs to the
+// caller so the reader can be used where allocating isn't an option.
+class FileReader
+{
+public:
+    FileReader(File* file, std::uint8_t* buffer, std::uint32_t size);
+
+    // next byte or -1 at end of file
+    int get();
+    bool read(void* data, std::uint32_t size);
+    bool skip(std::uint32_t size);
+    // seeks the file and drops whatever was buffered, position() goes on
+    // from offset
+    bool seek(std::uint32_t offset);
+    // -1 if it can't be told, the position is left where it was
+    long size();
+
+    // offset from where the reader started
+    std::uint32_t position() const;
+
+private:
+    bool fill();
+
+    File* mFile;
+    std::uint8_t* mBuffer;
+    std::uint32_t mSize;
+    std::uint32_t mPos = 0;
+    std::uint32_t mLength = 0;
+    std::uint32_t mConsumed = 0;
+};
+
+// Buffered sequential writes, flushed when full and on flush()
+class FileWriter
+{
+public:
+    FileWriter(File* file, std::uint8_t* buffer, std::uint32_t size);
+
+    bool write(const void* data, std::uint32_t size);
+    bool flush();
+
+    // offset from where the writer started
+    std::uint32_t position() const;
+
+private:
+    File* mFile;
+    std::uint8_t* mBuffer;
+    std::uint32_t mSize;
+    std::uint32_t mPos = 0;
+    std::uint32_t mFlushed = 0;
+    bool mFailed = false;
+};
+
+inline bool File::isOpen() const
+{
+    return mHandle != 0;
+}
+
+inline bool File::readExact(void* data, std::uint32_t size)
+{
+    return read(data, size) == static_cast<long>(size);
+}
+
+inline int FileReader::get()
+{
+    if (mPos == mLength && !fill()) {
+        return -1;
+    }
+    return mBuffer[mPos++];
+}
+
+inline std::uint32_t FileReader::position() const
+{
+    return mConsumed + mPos;
+}
+
+inline std::uint32_t FileWriter::position() const
+{
+    return mFlushed + mPos;
+}
+
+} // namespace trost
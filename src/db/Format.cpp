@@ -0,0 +1,225 @@
+#include "Format.h"
+#include <cstdio>
+#include <cstring>
+
+namespace trost {
+namespace format {
+
+bool readDataHeader(File& file, DataHeader* header)
+{
+    std::uint8_t buf[DataHeaderSize];
+    if (!file.seek(0) || !file.readExact(buf, sizeof(buf))) {
+        return false;
+    }
+    if (get32(buf) != DataMagic || get16(buf + 4) != Version) {
+        return false;
+    }
+    header->colors = get16(buf + 6);
+    header->count = get32(buf + 8);
+    if (header->colors > PaletteSize) {
+        return false;
+    }
+    for (std::uint32_t i = 0; i < PaletteSize; ++i) {
+        header->palette[i] = get16(buf + 12 + i * 2);
+    }
+    return true;
+}
+
+bool readLetterHeader(File& file, LetterHeader* header)
+{
+    std::uint8_t buf[LetterHeaderSize];
+    if (!file.seek(0) || !file.readExact(buf, sizeof(buf))) {
+        return false;
+    }
+    if (get32(buf) != LetterMagic || get16(buf + 4) != Version) {
+        return false;
+    }
+    header->interval = get16(buf + 6);
+    header->count = get32(buf + 8);
+    header->restarts = get32(buf + 12);
+    header->filterBytes = get32(buf + 16);
+    header->filterHashes = buf[20];
+    return header->interval > 0;
+}
+
+bool readExactHeader(File& file, ExactHeader* header)
+{
+    std::uint8_t buf[ExactHeaderSize];
+    if (!file.seek(0) || !file.readExact(buf, sizeof(buf))) {
+        return false;
+    }
+    if (get32(buf) != ExactMagic || get16(buf + 4) != Version) {
+        return false;
+    }
+    header->count = get32(buf + 8);
+    header->buckets = get32(buf + 12);
+    return true;
+}
+
+bool readRestart(File& file, std::uint32_t index, std::uint32_t* offset)
+{
+    std::uint8_t buf[4];
+    if (!file.seek(LetterHeaderSize + index * 4) || !file.readExact(buf, sizeof(buf))) {
+        return false;
+    }
+    *offset = get32(buf);
+    return true;
+}
+
+bool readRestartEntry(File& file, std::uint32_t offset, NameEntry* entry)
+{
+    // the entry is at most MaxNameEntrySize, a short read is fine as long
+    // as it covers the entry
+    std::uint8_t buf[MaxNameEntrySize];
+    if (!file.seek(offset)) {
+        return false;
+    }
+    const auto got = file.read(buf, sizeof(buf));
+    if (got < 2 || buf[0] != 0 || got < 2 + buf[1] + 4) {
+        return false;
+    }
+    entry->length = buf[1];
+    memcpy(entry->name, buf + 2, entry->length);
+    entry->name[entry->length] = '\0';
+    entry->offset = get32(buf + 2 + entry->length);
+    return true;
+}
+
+bool readName(FileReader& reader, NameEntry* entry)
+{
+    const auto shared = reader.get();
+    const auto suffix = reader.get();
+    if (shared < 0 || suffix < 0 || shared > entry->length || shared + suffix > static_cast<int>(MaxNameLength)) {
+        return false;
+    }
+    std::uint8_t off[4];
+    if (!reader.read(entry->name + shared, suffix) || !reader.read(off, sizeof(off))) {
+        return false;
+    }
+    entry->length = static_cast<std::uint8_t>(shared + suffix);
+    entry->name[entry->length] = '\0';
+    entry->offset = get32(off);
+    return true;
+}
+
+std::uint32_t encodeName(const char* previous, std::uint8_t previousLength, const char* name, std::uint8_t length,
+                         std::uint32_t offset, std::uint8_t* out)
+{
+    std::uint8_t shared = 0;
+    if (previous) {
+        while (shared < previousLength && shared < length && previous[shared] == name[shared]) {
+            ++shared;
+        }
+    }
+    const std::uint8_t suffix = length - shared;
+    out[0] = shared;
+    out[1] = suffix;
+    memcpy(out + 2, name + shared, suffix);
+    put32(out + 2 + suffix, offset);
+    return 2 + suffix + 4;
+}
+
+bool readRecord(File& file, std::uint32_t offset, Record* record, std::uint8_t* scratch)
+{
+    if (!file.seek(offset)) {
+        return false;
+    }
+    // the record is at most MaxRecordSize bytes, a short read is fine as
+    // long as it covers the whole record
+    const auto got = file.read(scratch, MaxRecordSize);
+    if (got < static_cast<long>(RecordHeaderSize)) {
+        return false;
+    }
+    record->offset = offset;
+    record->nameLength = scratch[0];
+    record->pathLength = scratch[1];
+    record->previewLength = get16(scratch + 2);
+    if (record->previewLength > MaxPreviewSize
+        || got < static_cast<long>(RecordHeaderSize + record->nameLength + record->pathLength + record->previewLength)) {
+        return false;
+    }
+    memcpy(record->name, scratch + RecordHeaderSize, record->nameLength);
+    record->name[record->nameLength] = '\0';
+    memcpy(record->path, scratch + RecordHeaderSize + record->nameLength, record->pathLength);
+    record->path[record->pathLength] = '\0';
+    memcpy(record->preview, scratch + RecordHeaderSize + record->nameLength + record->pathLength, record->previewLength);
+    return true;
+}
+
+std::uint16_t encodePreview(const Image& thumbnail, std::uint8_t* out)
+{
+    for (std::uint16_t scale = 4; scale <= 16; scale <<= 1) {
+        Image preview;
+        if (!preview.shrink(thumbnail, scale)) {
+            return 0;
+        }
+        if (preview.width() > 255 || preview.height() > 255 || PreviewHeaderSize + preview.size() > MaxPreviewSize) {
+            continue;
+        }
+        out[0] = static_cast<std::uint8_t>(preview.width());
+        out[1] = static_cast<std::uint8_t>(preview.height());
+        out[2] = static_cast<std::uint8_t>(preview.depth());
+        out[3] = static_cast<std::uint8_t>(scale);
+        memcpy(out + PreviewHeaderSize, preview.plane(0), preview.size());
+        return static_cast<std::uint16_t>(PreviewHeaderSize + preview.size());
+    }
+    return 0;
+}
+
+bool decodePreview(const std::uint8_t* data, std::uint16_t length, Image* image)
+{
+    if (length < PreviewHeaderSize) {
+        return false;
+    }
+    Image preview;
+    if (!preview.allocate(data[0], data[1], data[2]) || PreviewHeaderSize + preview.size() > length) {
+        return false;
+    }
+    memcpy(preview.plane(0), data + PreviewHeaderSize, preview.size());
+    return image->expand(preview, data[3]);
+}
+
+bool joinPath(char* out, std::size_t size, const char* dir, const char* name, const char* suffix)
+{
+    const auto dirLength = strlen(dir);
+    const auto nameLength = strlen(name);
+    const auto suffixLength = suffix ? strlen(suffix) : 0;
+    const bool separator = dirLength > 0 && dir[dirLength - 1] != ':' && dir[dirLength - 1] != '/';
+    if (dirLength + (separator ? 1 : 0) + nameLength + suffixLength + 1 > size) {
+        return false;
+    }
+    auto p = out;
+    memcpy(p, dir, dirLength);
+    p += dirLength;
+    if (separator) {
+        *p++ = '/';
+    }
+    memcpy(p, name, nameLength);
+    p += nameLength;
+    if (suffixLength) {
+        memcpy(p, suffix, suffixLength);
+        p += suffixLength;
+    }
+    *p = '\0';
+    return true;
+}
+
+bool bitmapPath(char* out, std::size_t size, const char* dir, std::uint32_t offset)
+{
+    char bitmaps[256];
+    char name[9];
+    snprintf(name, sizeof(name), "%08lx", static_cast<unsigned long>(offset));
+    return joinPath(bitmaps, sizeof(bitmaps), dir, "bitmaps")
+        && joinPath(out, size, bitmaps, name, ".iff");
+}
+
+char letterFor(const char* key, std::size_t length)
+{
+    if (!length) {
+        return '0';
+    }
+    return (key[0] >= 'A' && key[0] <= 'Z') ? key[0] : '0';
+}
+
+} // namespace format
+} // namespace trost
@@ -0,0 +1,216 @@
+#pragma once
+
+#include "File.h"
+#include "Image.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace trost {
+namespace format {
+
+// Everything on disk is big endian.
+//
+// data.idx starts with a header followed by one record per entry in name
+// order. Records don't point anywhere, they're reached through the offsets
+// in the other files.
+//
+//   header  "TRDB" u16 version, u16 colors, u32 count, u16 palette[32]
+//   record  u8 nameLength, u8 pathLength, u16 previewLength, name, path,
+//           preview
+//
+// Every thumbnail is quantized to the palette in the header so they can
+// share a screen. It's 0x0RGB, the first ReservedPens entries belong to the
+// interface and are never used by a thumbnail.
+//
+// The preview is a tiny copy of the thumbnail so something can be shown
+// before the real one is decoded, it's drawn scaled up by its factor.
+//
+//   preview u8 width, u8 height, u8 depth, u8 scale, planes
+//
+// A.idx ... Z.idx and 0.idx hold the collation keys of the names (see
+// util/Collation.h) starting with that letter, or with anything else for
+// 0.idx, in the same order as data.idx. Neighbouring
+// names tend to share a long prefix so each entry only stores what follows
+// the part it has in common with the one before it. Every interval-th entry
+// is a restart point stored whole, lookups binary search those and then
+// decode forward from one. A Bloom filter over every prefix of every name
+// turns most misses down before any of that, see BloomFilter.h.
+//
+//   header  "TRIX" u16 version, u16 interval, u32 count, u32 restarts,
+//           u32 filterBytes, u8 filterHashes, u8[3] reserved
+//   restart u32 file offset of each restart entry
+//   filter  filterBytes bytes
+//   entry   u8 shared, u8 suffixLength, suffix, u32 record offset
+//
+// exact.idx maps whole names straight to records through a minimal perfect
+// hash, see PerfectHash.h. Names that aren't in the index still land on
+// some slot so the record's name has to be checked.
+//
+//   header  "TRPH" u16 version, u16 reserved, u32 count, u32 buckets
+//   seeds   u32 per bucket
+//   slots   u32 record offset per name
+//
+// An entry's id is its position in name order. ids.idx maps ids to
+// records for everything that refers to entries by id.
+//
+//   header  "TRID" u16 version, u16 reserved, u32 count
+//   offsets u32 record offset per id
+//
+// attrs.idx holds the entries for every attribute value from games.txt,
+// e.g. genre=Platform, as an EntrySet. The directory is sorted by
+// attribute and then value.
+//
+//   header  "TRAT" u16 version, u16 reserved, u32 count, u32 sets
+//   set     u8 attributeLength, attribute, u8 valueLength, value,
+//           u8 encoding, u32 members, u32 data offset, u32 data length
+//
+// orders.idx holds other orders than by name, e.g. by year, as the entry
+// ids in that order. Ids are u16 when every one fits, width says which.
+// Entries without the attribute an order is by come last, in name order.
+//
+//   header  "TROR" u16 version, u16 reserved, u32 count, u32 orders
+//   order   u8 nameLength, name, u8 width, u8 descending, u32 data offset
+//   ids     width bytes per id
+//
+// history.log is the play history, a record appended per play. It isn't
+// part of the index, createIndex carries it over to the new ids. Records
+// with more than one play come from compacting it.
+//
+//   header  "TRPL" u16 version, u16 reserved
+//   record  u32 entry id, u32 time, u16 plays, u16 reserved
+
+constexpr std::uint32_t DataMagic = 0x54524442; // TRDB
+constexpr std::uint32_t LetterMagic = 0x54524958; // TRIX
+constexpr std::uint32_t ExactMagic = 0x54525048; // TRPH
+constexpr std::uint32_t IdsMagic = 0x54524944; // TRID
+constexpr std::uint32_t AttributesMagic = 0x54524154; // TRAT
+constexpr std::uint32_t OrdersMagic = 0x54524f52; // TROR
+constexpr std::uint32_t HistoryMagic = 0x5452504c; // TRPL
+constexpr std::uint16_t Version = 8;
+// the history outlives any one index, so it has its own
+constexpr std::uint16_t HistoryVersion = 1;
+
+constexpr std::uint32_t PaletteSize = 32;
+constexpr std::uint16_t ReservedPens = 2;
+constexpr std::uint16_t ThumbnailDepth = 5;
+constexpr std::uint32_t DataHeaderSize = 12 + PaletteSize * 2;
+constexpr std::uint32_t LetterHeaderSize = 24;
+constexpr std::uint16_t LetterInterval = 16;
+constexpr std::uint32_t ExactHeaderSize = 16;
+constexpr std::uint32_t IdsHeaderSize = 12;
+constexpr std::uint32_t AttributesHeaderSize = 16;
+constexpr std::uint32_t MaxAttributeLength = 255;
+constexpr std::uint32_t OrdersHeaderSize = 16;
+constexpr std::uint32_t HistoryHeaderSize = 8;
+constexpr std::uint32_t HistoryRecordSize = 12;
+constexpr std::uint32_t RecordHeaderSize = 4;
+constexpr std::uint32_t MaxNameLength = 255;
+constexpr std::uint32_t MaxPathLength = 255;
+constexpr std::uint32_t PreviewHeaderSize = 4;
+constexpr std::uint32_t MaxPreviewSize = 512;
+constexpr std::uint32_t MaxRecordSize = RecordHeaderSize + MaxNameLength + MaxPathLength + MaxPreviewSize;
+constexpr std::uint32_t MaxNameEntrySize = 2 + MaxNameLength + 4;
+
+inline std::uint16_t get16(const std::uint8_t* p)
+{
+    return static_cast<std::uint16_t>((p[0] << 8) | p[1]);
+}
+
+inline std::uint32_t get32(const std::uint8_t* p)
+{
+    return (static_cast<std::uint32_t>(p[0]) << 24) | (static_cast<std::uint32_t>(p[1]) << 16)
+        | (static_cast<std::uint32_t>(p[2]) << 8) | p[3];
+}
+
+inline void put16(std::uint8_t* p, std::uint16_t v)
+{
+    p[0] = static_cast<std::uint8_t>(v >> 8);
+    p[1] = static_cast<std::uint8_t>(v);
+}
+
+inline void put32(std::uint8_t* p, std::uint32_t v)
+{
+    p[0] = static_cast<std::uint8_t>(v >> 24);
+    p[1] = static_cast<std::uint8_t>(v >> 16);
+    p[2] = static_cast<std::uint8_t>(v >> 8);
+    p[3] = static_cast<std::uint8_t>(v);
+}
+
+struct DataHeader
+{
+    std::uint32_t count;
+    std::uint16_t colors;
+    std::uint16_t palette[PaletteSize];
+};
+
+// a decoded data.idx record, fixed size so it can be filled in without
+// allocating
+struct Record
+{
+    std::uint32_t offset;
+    std::uint8_t nameLength;
+    std::uint8_t pathLength;
+    std::uint16_t previewLength;
+    char name[MaxNameLength + 1];
+    char path[MaxPathLength + 1];
+    std::uint8_t preview[MaxPreviewSize];
+};
+
+struct LetterHeader
+{
+    std::uint32_t count;
+    std::uint32_t restarts;
+    std::uint32_t filterBytes;
+    std::uint16_t interval;
+    std::uint8_t filterHashes;
+};
+
+struct ExactHeader
+{
+    std::uint32_t count;
+    std::uint32_t buckets;
+};
+
+// a decoded letter file entry. name holds on to the previous entry's since
+// only the part that differs is stored
+struct NameEntry
+{
+    char name[MaxNameLength + 1];
+    std::uint8_t length;
+    std::uint32_t offset;
+};
+
+bool readDataHeader(File& file, DataHeader* header);
+bool readLetterHeader(File& file, LetterHeader* header);
+bool readExactHeader(File& file, ExactHeader* header);
+// where restart entry index starts
+bool readRestart(File& file, std::uint32_t index, std::uint32_t* offset);
+// decodes the restart entry at offset with a single read
+bool readRestartEntry(File& file, std::uint32_t offset, NameEntry* entry);
+// decodes the entry following the one already in entry
+bool readName(FileReader& reader, NameEntry* entry);
+// encodes name following previous, or whole if previous is null. out needs
+// MaxNameEntrySize bytes, returns the encoded size
+std::uint32_t encodeName(const char* previous, std::uint8_t previousLength, const char* name, std::uint8_t length,
+                         std::uint32_t offset, std::uint8_t* out);
+// one read per record, scratch needs MaxRecordSize bytes
+bool readRecord(File& file, std::uint32_t offset, Record* record, std::uint8_t* scratch);
+
+// shrinks thumbnail by the smallest power of two that fits MaxPreviewSize,
+// returns the encoded size or 0 if it doesn't fit at all
+std::uint16_t encodePreview(const Image& thumbnail, std::uint8_t* out);
+// decodes and scales back up to roughly the thumbnail size
+bool decodePreview(const std::uint8_t* data, std::uint16_t length, Image* image);
+
+// dir and name joined the way dos.library expects, no separator after a
+// volume or a trailing slash. returns false if it doesn't fit
+bool joinPath(char* out, std::size_t size, const char* dir, const char* name, const char* suffix = nullptr);
+// where the thumbnail for the entry whose record is at offset lives
+bool bitmapPath(char* out, std::size_t size, const char* dir, std::uint32_t offset);
+
+// the letter file for a collation key, 'A' to 'Z' or '0' for anything
+// that doesn't start with a letter
+char letterFor(const char* key, std::size_t length);
+
+} // namespace format
+} // namespace trost
@@ -0,0 +1,268 @@
+#include "History.h"
+#include "File.h"
+#include "Format.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+using namespace trost;
+
+static bool history_path(char* out, std::size_t size, const char* dir, const char* suffix)
+{
+    return format::joinPath(out, size, dir, "history", suffix);
+}
+
+bool History::open(const char* dir, std::uint32_t entries)
+{
+    close();
+    strncpy(mDir, dir, sizeof(mDir) - 1);
+    mEntries = entries;
+
+    char log[256], fresh[256];
+    if (!history_path(log, sizeof(log), dir, ".log") || !history_path(fresh, sizeof(fresh), dir, ".new")) {
+        return false;
+    }
+
+    // a log that's there is complete. without one, a compaction may have
+    // gotten as far as removing it but not as far as the rename
+    File file;
+    if (file.open(log, File::Mode::Read)) {
+        File::remove(fresh);
+    } else if (!File::rename(fresh, log) || !file.open(log, File::Mode::Read)) {
+        mOpen = write(dir, nullptr, 0);
+        return mOpen;
+    }
+
+    const auto size = file.size();
+    if (size < static_cast<long>(format::HistoryHeaderSize)) {
+        file.close();
+        mOpen = write(dir, nullptr, 0);
+        return mOpen;
+    }
+    auto data = new std::uint8_t[size];
+    const bool valid = file.readExact(data, size) && format::get32(data) == format::HistoryMagic
+        && format::get16(data + 4) == format::HistoryVersion;
+    file.close();
+    if (valid) {
+        const auto records = (size - format::HistoryHeaderSize) / format::HistoryRecordSize;
+        for (long i = 0; i < records; ++i) {
+            const auto p = data + format::HistoryHeaderSize + i * format::HistoryRecordSize;
+            record(format::get32(p), format::get32(p + 4), format::get16(p + 8));
+        }
+        mRecords = static_cast<std::uint32_t>(records);
+    }
+    delete[] data;
+    mOpen = true;
+
+    // a record cut short by a crash would throw every one appended after
+    // it out of step, and anything unreadable is as good as gone
+    if (!valid || (size - format::HistoryHeaderSize) % format::HistoryRecordSize) {
+        return compact();
+    }
+    return true;
+}
+
+void History::close()
+{
+    mStats = Vector<Stat>();
+    mRecords = 0;
+    mSequence = 0;
+    mOpen = false;
+}
+
+void History::record(std::uint32_t id, std::uint32_t time, std::uint32_t plays)
+{
+    const auto sequence = mSequence++;
+    if (id >= mEntries || !plays) {
+        return;
+    }
+
+    // kept sorted by id, played entries are few and mostly the same ones
+    std::size_t lo = 0, hi = mStats.size();
+    while (lo < hi) {
+        const auto mid = (lo + hi) / 2;
+        if (mStats[mid].id < id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < mStats.size() && mStats[lo].id == id) {
+        auto& stat = mStats[lo];
+        stat.plays += plays;
+        if (time >= stat.last) {
+            stat.last = time;
+            stat.sequence = sequence;
+        }
+        return;
+    }
+    mStats.push_back({ id, time, plays, sequence });
+    for (auto i = mStats.size() - 1; i > lo; --i) {
+        std::swap(mStats[i], mStats[i - 1]);
+    }
+}
+
+bool History::add(std::uint32_t id, std::uint32_t time)
+{
+    if (!mOpen || id >= mEntries) {
+        return false;
+    }
+    record(id, time, 1);
+
+    char path[256];
+    File file;
+    std::uint8_t rec[format::HistoryRecordSize] = {};
+    format::put32(rec, id);
+    format::put32(rec + 4, time);
+    format::put16(rec + 8, 1);
+    if (!history_path(path, sizeof(path), mDir, ".log") || !file.open(path, File::Mode::Append)
+        || !file.write(rec, sizeof(rec))) {
+        printf("Failed to write %s\n", path);
+        return false;
+    }
+    file.close();
+    ++mRecords;
+
+    if (mRecords >= mStats.size() + mThreshold) {
+        return compact();
+    }
+    return true;
+}
+
+bool History::compact()
+{
+    if (!mOpen) {
+        return false;
+    }
+    const auto count = static_cast<std::uint32_t>(mStats.size());
+    std::uint32_t records;
+    if (!write(mDir, count ? &mStats[0] : nullptr, count, &records)) {
+        return false;
+    }
+    mRecords = records;
+    return true;
+}
+
+bool History::write(const char* dir, const Stat* stats, std::uint32_t count, std::uint32_t* records)
+{
+    char log[256], fresh[256];
+    if (!history_path(log, sizeof(log), dir, ".log") || !history_path(fresh, sizeof(fresh), dir, ".new")) {
+        return false;
+    }
+
+    File file;
+    if (!file.open(fresh, File::Mode::Write)) {
+        printf("Failed to create %s\n", fresh);
+        return false;
+    }
+    auto order = new std::uint32_t[count ? count : 1];
+    for (std::uint32_t i = 0; i < count; ++i) {
+        order[i] = i;
+    }
+    std::sort(order, order + count, [stats](std::uint32_t a, std::uint32_t b) -> bool {
+        return stats[a].last != stats[b].last ? stats[a].last < stats[b].last : stats[a].sequence < stats[b].sequence;
+    });
+
+    std::uint8_t buffer[256];
+    FileWriter out(&file, buffer, sizeof(buffer));
+    std::uint8_t header[format::HistoryHeaderSize] = {};
+    format::put32(header, format::HistoryMagic);
+    format::put16(header + 4, format::HistoryVersion);
+    out.write(header, sizeof(header));
+    std::uint32_t written = 0;
+    for (std::uint32_t i = 0; i < count; ++i) {
+        // plays past what a record holds are split over several
+        const auto& stat = stats[order[i]];
+        auto plays = stat.plays;
+        while (plays > 0) {
+            const auto chunk = plays > 0xffff ? 0xffff : plays;
+            std::uint8_t rec[format::HistoryRecordSize] = {};
+            format::put32(rec, stat.id);
+            format::put32(rec + 4, stat.last);
+            format::put16(rec + 8, static_cast<std::uint16_t>(chunk));
+            out.write(rec, sizeof(rec));
+            plays -= chunk;
+            ++written;
+        }
+    }
+    delete[] order;
+    const bool flushed = out.flush();
+    file.close();
+    if (!flushed) {
+        printf("Failed to write %s\n", fresh);
+        File::remove(fresh);
+        return false;
+    }
+
+    // dos.library won't rename over an existing file
+    File::remove(log);
+    if (!File::rename(fresh, log)) {
+        printf("Failed to rename %s\n", fresh);
+        return false;
+    }
+    if (records) {
+        *records = written;
+    }
+    return true;
+}
+
+const History::Stat* History::stat(std::uint32_t id) const
+{
+    std::size_t lo = 0, hi = mStats.size();
+    while (lo < hi) {
+        const auto mid = (lo + hi) / 2;
+        if (mStats[mid].id < id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < mStats.size() && mStats[lo].id == id ? &mStats[lo] : nullptr;
+}
+
+// the first count of the played entries by better, by id when it can't tell
+template<typename Better>
+static std::uint32_t best(const Vector<History::Stat>& stats, std::uint32_t* ids, std::uint32_t count, Better&& better)
+{
+    const auto size = static_cast<std::uint32_t>(stats.size());
+    if (!size || !count) {
+        return 0;
+    }
+    auto order = new std::uint32_t[size];
+    for (std::uint32_t i = 0; i < size; ++i) {
+        order[i] = i;
+    }
+    if (count > size) {
+        count = size;
+    }
+    std::partial_sort(order, order + count, order + size, [&](std::uint32_t a, std::uint32_t b) -> bool {
+        const auto& sa = stats[a];
+        const auto& sb = stats[b];
+        if (better(sa, sb)) {
+            return true;
+        }
+        return !better(sb, sa) && sa.id < sb.id;
+    });
+    for (std::uint32_t i = 0; i < count; ++i) {
+        ids[i] = stats[order[i]].id;
+    }
+    delete[] order;
+    return count;
+}
+
+std::uint32_t History::recent(std::uint32_t* ids, std::uint32_t count) const
+{
+    return best(mStats, ids, count, [](const Stat& a, const Stat& b) -> bool {
+        return a.last != b.last ? a.last > b.last : a.sequence > b.sequence;
+    });
+}
+
+std::uint32_t History::favourites(std::uint32_t* ids, std::uint32_t count) const
+{
+    return best(mStats, ids, count, [](const Stat& a, const Stat& b) -> bool {
+        if (a.plays != b.plays) {
+            return a.plays > b.plays;
+        }
+        return a.last != b.last ? a.last > b.last : a.sequence > b.sequence;
+    });
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "util/Vector.h"
+#include <cstdint>
+
+namespace trost {
+
+// What was played and when, for the recently and most played lists. Every
+// play is one record appended to history.log, a single small write that
+// never touches what's already on disk. The log is read in one go when
+// it's opened and folded into one Stat per entry played.
+//
+// Once the log has threshold records more than it would have with one per
+// entry it's compacted into exactly that. The new log is written next to
+// the old one and renamed over it, a crash in between leaves one or the
+// other and open() picks whichever is complete.
+class History
+{
+public:
+    struct Stat
+    {
+        std::uint32_t id;
+        // seconds, from whatever clock add() was given
+        std::uint32_t last;
+        std::uint32_t plays;
+        // where in the log the last play is, for plays in the same second
+        std::uint32_t sequence;
+    };
+
+    History() = default;
+
+    History(const History&) = delete;
+    History& operator=(const History&) = delete;
+
+    // entries is how many the index has, plays of ids past that are
+    // dropped. the log is created if there is none
+    bool open(const char* dir, std::uint32_t entries);
+    void close();
+    bool isOpen() const;
+
+    bool add(std::uint32_t id, std::uint32_t time);
+    bool compact();
+    void setThreshold(std::uint32_t records);
+
+    // null if id was never played
+    const Stat* stat(std::uint32_t id) const;
+    // up to count ids, the most recently played first
+    std::uint32_t recent(std::uint32_t* ids, std::uint32_t count) const;
+    // up to count ids, the most played first and the more recent one of
+    // those played as often
+    std::uint32_t favourites(std::uint32_t* ids, std::uint32_t count) const;
+
+    // every entry played, by id
+    const Vector<Stat>& stats() const;
+
+    // replaces the log in dir with one record per stat, the least
+    // recently played first so the order survives. a stat with more plays
+    // than a record holds takes several, records is set to how many there
+    // are in all
+    static bool write(const char* dir, const Stat* stats, std::uint32_t count, std::uint32_t* records = nullptr);
+
+private:
+    void record(std::uint32_t id, std::uint32_t time, std::uint32_t plays);
+
+    char mDir[256] = {};
+    Vector<Stat> mStats;
+    // records in the log as it is on disk
+    std::uint32_t mRecords = 0;
+    std::uint32_t mSequence = 0;
+    std::uint32_t mThreshold = 512;
+    std::uint32_t mEntries = 0;
+    bool mOpen = false;
+};
+
+inline bool History::isOpen() const
+{
+    return mOpen;
+}
+
+inline void History::setThreshold(std::uint32_t records)
+{
+    mThreshold = records;
+}
+
+inline const Vector<History::Stat>& History::stats() const
+{
+    return mStats;
+}
+
+} // namespace trost
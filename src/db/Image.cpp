@@ -0,0 +1,406 @@
+#include "Image.h"
+#include "Format.h"
+#include <cstring>
+#include <utility>
+#if defined(__amigaos__)
+#include <clib/exec_protos.h>
+#include <clib/graphics_protos.h>
+#include <exec/memory.h>
+#endif
+
+using namespace trost;
+
+static constexpr std::uint32_t id(char a, char b, char c, char d)
+{
+    return (static_cast<std::uint32_t>(a) << 24) | (static_cast<std::uint32_t>(b) << 16)
+        | (static_cast<std::uint32_t>(c) << 8) | static_cast<std::uint32_t>(d);
+}
+
+Image::~Image()
+{
+    release();
+}
+
+Image::Image(Image&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+Image& Image::operator=(Image&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        mData = other.mData;
+        mSize = other.mSize;
+        mWidth = other.mWidth;
+        mHeight = other.mHeight;
+        mDepth = other.mDepth;
+        mBytesPerRow = other.mBytesPerRow;
+        other.mData = nullptr;
+        other.mSize = 0;
+    }
+    return *this;
+}
+
+bool Image::allocate(std::uint16_t width, std::uint16_t height, std::uint16_t depth)
+{
+    release();
+    if (!width || !height || !depth || depth > MaxDepth) {
+        return false;
+    }
+    const auto bytesPerRow = static_cast<std::uint16_t>(((width + 15) >> 4) << 1);
+    const auto size = static_cast<std::uint32_t>(bytesPerRow) * height * depth;
+#if defined(__amigaos__)
+    mData = static_cast<std::uint8_t*>(AllocMem(size, MEMF_CHIP | MEMF_CLEAR));
+#else
+    mData = new std::uint8_t[size]();
+#endif
+    if (!mData) {
+        return false;
+    }
+    mSize = size;
+    mWidth = width;
+    mHeight = height;
+    mDepth = depth;
+    mBytesPerRow = bytesPerRow;
+    return true;
+}
+
+void Image::release()
+{
+    if (!mData) {
+        return;
+    }
+#if defined(__amigaos__)
+    FreeMem(mData, mSize);
+#else
+    delete[] mData;
+#endif
+    mData = nullptr;
+    mSize = 0;
+}
+
+#if defined(__amigaos__)
+void Image::initBitMap(BitMap* bitmap) const
+{
+    InitBitMap(bitmap, mDepth, mWidth, mHeight);
+    for (UWORD i = 0; i < mDepth; ++i) {
+        bitmap->Planes[i] = const_cast<PLANEPTR>(plane(i));
+    }
+}
+#endif
+
+bool Image::shrink(const Image& source, std::uint16_t factor)
+{
+    if (!factor || !source.isValid()
+        || !allocate((source.mWidth + factor - 1) / factor, (source.mHeight + factor - 1) / factor, source.mDepth)) {
+        return false;
+    }
+
+    for (std::uint16_t p = 0; p < mDepth; ++p) {
+        for (std::uint16_t y = 0; y < mHeight; ++y) {
+            const auto in = source.plane(p) + static_cast<std::uint32_t>(y) * factor * source.mBytesPerRow;
+            auto out = plane(p) + static_cast<std::uint32_t>(y) * mBytesPerRow;
+            for (std::uint16_t x = 0; x < mWidth; ++x) {
+                const std::uint32_t sx = static_cast<std::uint32_t>(x) * factor;
+                if (in[sx >> 3] & (0x80 >> (sx & 7))) {
+                    out[x >> 3] |= 0x80 >> (x & 7);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// every source byte turns into factor bytes, 2 and 4 go through a table
+// and 8 and up are whole bytes per pixel anyway
+static std::uint8_t expand2[256][2];
+static std::uint8_t expand4[256][4];
+
+static void init_expand_tables()
+{
+    static bool initialized = false;
+    if (initialized) {
+        return;
+    }
+    for (int v = 0; v < 256; ++v) {
+        std::uint16_t two = 0;
+        std::uint32_t four = 0;
+        for (int bit = 0; bit < 8; ++bit) {
+            if (v & (0x80 >> bit)) {
+                two |= 0xc000 >> (bit * 2);
+                four |= 0xf0000000UL >> (bit * 4);
+            }
+        }
+        expand2[v][0] = static_cast<std::uint8_t>(two >> 8);
+        expand2[v][1] = static_cast<std::uint8_t>(two);
+        format::put32(expand4[v], four);
+    }
+    initialized = true;
+}
+
+bool Image::expand(const Image& source, std::uint16_t factor)
+{
+    if (!source.isValid() || !factor || (factor & (factor - 1)) || factor > 16) {
+        return false;
+    }
+    if (factor == 1) {
+        if (!allocate(source.mWidth, source.mHeight, source.mDepth)) {
+            return false;
+        }
+        memcpy(mData, source.mData, mSize);
+    } else {
+        std::uint8_t row[512];
+        if (static_cast<std::uint32_t>(source.mBytesPerRow) * factor > sizeof(row)
+            || !allocate(source.mWidth * factor, source.mHeight * factor, source.mDepth)) {
+            return false;
+        }
+        init_expand_tables();
+
+        for (std::uint16_t p = 0; p < mDepth; ++p) {
+            auto out = plane(p);
+            for (std::uint16_t y = 0; y < source.mHeight; ++y) {
+                const auto in = source.plane(p) + static_cast<std::uint32_t>(y) * source.mBytesPerRow;
+                auto r = row;
+                for (std::uint16_t x = 0; x < source.mBytesPerRow; ++x) {
+                    const auto v = in[x];
+                    if (factor == 2) {
+                        *r++ = expand2[v][0];
+                        *r++ = expand2[v][1];
+                    } else if (factor == 4) {
+                        memcpy(r, expand4[v], 4);
+                        r += 4;
+                    } else {
+                        for (int bit = 0; bit < 8; ++bit) {
+                            memset(r, (v & (0x80 >> bit)) ? 0xff : 0x00, factor >> 3);
+                            r += factor >> 3;
+                        }
+                    }
+                }
+                // the source row padding can make the expanded row longer
+                // than ours, the extra is off the right edge
+                for (std::uint16_t n = 0; n < factor; ++n) {
+                    memcpy(out, row, mBytesPerRow);
+                    out += mBytesPerRow;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// ByteRun1 for one plane row, n >= 0 copies n + 1 literal bytes, n < 0
+// repeats the next byte 1 - n times and -128 is a no-op
+static bool unpack_row(FileReader& reader, std::uint8_t* out, std::uint16_t length)
+{
+    std::uint16_t pos = 0;
+    while (pos < length) {
+        const auto c = reader.get();
+        if (c < 0) {
+            return false;
+        }
+        const auto n = static_cast<std::int8_t>(c);
+        if (n >= 0) {
+            const std::uint16_t count = n + 1;
+            if (pos + count > length || !reader.read(out + pos, count)) {
+                return false;
+            }
+            pos += count;
+        } else if (n != -128) {
+            const std::uint16_t count = 1 - n;
+            const auto v = reader.get();
+            if (v < 0 || pos + count > length) {
+                return false;
+            }
+            memset(out + pos, v, count);
+            pos += count;
+        }
+    }
+    return true;
+}
+
+bool Image::loadILBM(File& file, std::uint8_t* scratch, std::uint32_t scratchSize, ILBMInfo* info)
+{
+    release();
+    if (info) {
+        info->colors = 0;
+        info->viewModes = 0;
+    }
+
+    FileReader reader(&file, scratch, scratchSize);
+    std::uint8_t head[12];
+    if (!reader.read(head, sizeof(head)) || format::get32(head) != id('F', 'O', 'R', 'M')
+        || format::get32(head + 8) != id('I', 'L', 'B', 'M')) {
+        return false;
+    }
+
+    std::uint16_t width = 0, height = 0;
+    std::uint8_t planes = 0, masking = 0, compression = 0;
+    bool haveHeader = false;
+
+    for (;;) {
+        std::uint8_t chunk[8];
+        if (!reader.read(chunk, sizeof(chunk))) {
+            return false;
+        }
+        const auto type = format::get32(chunk);
+        const auto size = format::get32(chunk + 4);
+        // chunks are padded to an even length
+        const auto padded = size + (size & 1);
+
+        if (type == id('B', 'M', 'H', 'D')) {
+            std::uint8_t bmhd[20];
+            if (size < sizeof(bmhd) || !reader.read(bmhd, sizeof(bmhd)) || !reader.skip(padded - sizeof(bmhd))) {
+                return false;
+            }
+            width = format::get16(bmhd);
+            height = format::get16(bmhd + 2);
+            planes = bmhd[8];
+            masking = bmhd[9];
+            compression = bmhd[10];
+            haveHeader = true;
+        } else if (type == id('C', 'M', 'A', 'P') && info) {
+            auto used = size < sizeof(info->cmap) ? size - size % 3 : static_cast<std::uint32_t>(sizeof(info->cmap));
+            if (!reader.read(info->cmap, used) || !reader.skip(padded - used)) {
+                return false;
+            }
+            info->colors = static_cast<std::uint16_t>(used / 3);
+        } else if (type == id('C', 'A', 'M', 'G') && info && size >= 4) {
+            std::uint8_t camg[4];
+            if (!reader.read(camg, sizeof(camg)) || !reader.skip(padded - sizeof(camg))) {
+                return false;
+            }
+            info->viewModes = format::get32(camg);
+        } else if (type == id('B', 'O', 'D', 'Y')) {
+            break;
+        } else if (!reader.skip(padded)) {
+            return false;
+        }
+    }
+
+    if (!haveHeader || compression > 1 || !allocate(width, height, planes)) {
+        return false;
+    }
+
+    // rows are interleaved, every plane of a row and then the mask if
+    // there is one. the mask row is read and dropped, 512 bytes covers
+    // 4096 pixels which is plenty for anything we display
+    std::uint8_t mask[512];
+    const bool hasMask = masking == 1;
+    if (hasMask && mBytesPerRow > sizeof(mask)) {
+        release();
+        return false;
+    }
+    for (std::uint16_t y = 0; y < mHeight; ++y) {
+        for (std::uint16_t p = 0; p < mDepth + (hasMask ? 1 : 0); ++p) {
+            auto out = p < mDepth ? plane(p) + static_cast<std::uint32_t>(y) * mBytesPerRow : mask;
+            const bool ok = compression ? unpack_row(reader, out, mBytesPerRow) : reader.read(out, mBytesPerRow);
+            if (!ok) {
+                release();
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// ByteRun1, runs of 3 or more become repeats, everything else literals
+static std::uint16_t pack_row(const std::uint8_t* in, std::uint16_t length, std::uint8_t* out)
+{
+    std::uint16_t i = 0, o = 0;
+    while (i < length) {
+        std::uint16_t run = 1;
+        while (i + run < length && run < 128 && in[i + run] == in[i]) {
+            ++run;
+        }
+        if (run >= 3) {
+            out[o++] = static_cast<std::uint8_t>(257 - run);
+            out[o++] = in[i];
+            i += run;
+            continue;
+        }
+        const auto start = i;
+        std::uint16_t count = 0;
+        while (i < length && count < 128) {
+            if (i + 2 < length && in[i] == in[i + 1] && in[i] == in[i + 2]) {
+                break;
+            }
+            ++i;
+            ++count;
+        }
+        out[o++] = static_cast<std::uint8_t>(count - 1);
+        memcpy(out + o, in + start, count);
+        o += count;
+    }
+    return o;
+}
+
+bool Image::saveILBM(File& file, const std::uint16_t* palette, std::uint16_t colors) const
+{
+    if (!mData || mBytesPerRow > 512) {
+        return false;
+    }
+
+    // pack once to learn the size, then again to write it out
+    std::uint8_t packed[512 + 512 / 128 + 2];
+    std::uint32_t body = 0;
+    for (std::uint16_t y = 0; y < mHeight; ++y) {
+        for (std::uint16_t p = 0; p < mDepth; ++p) {
+            body += pack_row(plane(p) + static_cast<std::uint32_t>(y) * mBytesPerRow, mBytesPerRow, packed);
+        }
+    }
+    const std::uint32_t cmap = colors * 3u;
+    const std::uint32_t form = 4 + (8 + 20) + (8 + cmap + (cmap & 1)) + (8 + body + (body & 1));
+
+    std::uint8_t buffer[1024];
+    FileWriter writer(&file, buffer, sizeof(buffer));
+    std::uint8_t head[12 + 8 + 20];
+    memset(head, 0, sizeof(head));
+    format::put32(head, id('F', 'O', 'R', 'M'));
+    format::put32(head + 4, form);
+    format::put32(head + 8, id('I', 'L', 'B', 'M'));
+    format::put32(head + 12, id('B', 'M', 'H', 'D'));
+    format::put32(head + 16, 20);
+    auto bmhd = head + 20;
+    format::put16(bmhd, mWidth);
+    format::put16(bmhd + 2, mHeight);
+    bmhd[8] = static_cast<std::uint8_t>(mDepth);
+    bmhd[10] = 1; // ByteRun1
+    bmhd[14] = 10; // 320x256 aspect
+    bmhd[15] = 11;
+    format::put16(bmhd + 16, 320);
+    format::put16(bmhd + 18, 256);
+    writer.write(head, sizeof(head));
+
+    std::uint8_t chunk[8];
+    format::put32(chunk, id('C', 'M', 'A', 'P'));
+    format::put32(chunk + 4, cmap);
+    writer.write(chunk, sizeof(chunk));
+    for (std::uint16_t i = 0; i < colors; ++i) {
+        // scale the 4 bit guns back up so 0xf ends up as 0xff
+        const std::uint8_t rgb[3] = {
+            static_cast<std::uint8_t>(((palette[i] >> 8) & 0xf) * 0x11),
+            static_cast<std::uint8_t>(((palette[i] >> 4) & 0xf) * 0x11),
+            static_cast<std::uint8_t>((palette[i] & 0xf) * 0x11),
+        };
+        writer.write(rgb, sizeof(rgb));
+    }
+    const std::uint8_t pad = 0;
+    if (cmap & 1) {
+        writer.write(&pad, 1);
+    }
+
+    format::put32(chunk, id('B', 'O', 'D', 'Y'));
+    format::put32(chunk + 4, body);
+    writer.write(chunk, sizeof(chunk));
+    for (std::uint16_t y = 0; y < mHeight; ++y) {
+        for (std::uint16_t p = 0; p < mDepth; ++p) {
+            const auto length = pack_row(plane(p) + static_cast<std::uint32_t>(y) * mBytesPerRow, mBytesPerRow, packed);
+            writer.write(packed, length);
+        }
+    }
+    if (body & 1) {
+        writer.write(&pad, 1);
+    }
+    return writer.flush();
+}
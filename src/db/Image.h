@@ -0,0 +1,119 @@
+#pragma once
+
+#include "File.h"
+#include <cstdint>
+
+#if defined(__amigaos__)
+struct BitMap;
+#endif
+
+namespace trost {
+
+// Planar image laid out the way the blitter wants it, one plane after the
+// other with rows padded to 16 bits. On AmigaOS the planes are in chip
+// memory and come straight from exec, so an Image can be filled in from
+// any task.
+class Image
+{
+public:
+    static constexpr std::uint16_t MaxDepth = 8;
+
+    // what loadILBM found besides the planes, only the index builder
+    // cares since thumbnails share the palette in the DB header
+    struct ILBMInfo
+    {
+        std::uint8_t cmap[256 * 3];
+        std::uint16_t colors;
+        std::uint32_t viewModes;
+    };
+
+    Image() = default;
+    ~Image();
+
+    Image(Image&& other) noexcept;
+    Image& operator=(Image&& other) noexcept;
+
+    Image(const Image&) = delete;
+    Image& operator=(const Image&) = delete;
+
+    bool allocate(std::uint16_t width, std::uint16_t height, std::uint16_t depth);
+    void release();
+
+    bool isValid() const;
+
+    std::uint16_t width() const;
+    std::uint16_t height() const;
+    std::uint16_t depth() const;
+    std::uint16_t bytesPerRow() const;
+
+    std::uint8_t* plane(std::uint16_t index);
+    const std::uint8_t* plane(std::uint16_t index) const;
+    std::uint32_t size() const;
+
+#if defined(__amigaos__)
+    // points bitmap at our planes, nothing is copied
+    void initBitMap(BitMap* bitmap) const;
+#endif
+
+    // nearest neighbour scaling by a power of two, shrink samples every
+    // factor'th pixel and expand repeats each one factor times. expanding
+    // is table driven and cheap enough to do while drawing a page
+    bool shrink(const Image& source, std::uint16_t factor);
+    bool expand(const Image& source, std::uint16_t factor);
+
+    // IFF ILBM, uncompressed or ByteRun1. scratch is used to buffer file
+    // reads so nothing but the planes is allocated
+    bool loadILBM(File& file, std::uint8_t* scratch, std::uint32_t scratchSize, ILBMInfo* info = nullptr);
+    // ByteRun1 compressed, palette is 0x0RGB entries
+    bool saveILBM(File& file, const std::uint16_t* palette, std::uint16_t colors) const;
+
+private:
+    std::uint8_t* mData = nullptr;
+    std::uint32_t mSize = 0;
+    std::uint16_t mWidth = 0;
+    std::uint16_t mHeight = 0;
+    std::uint16_t mDepth = 0;
+    std::uint16_t mBytesPerRow = 0;
+};
+
+inline bool Image::isValid() const
+{
+    return mData != nullptr;
+}
+
+inline std::uint16_t Image::width() const
+{
+    return mWidth;
+}
+
+inline std::uint16_t Image::height() const
+{
+    return mHeight;
+}
+
+inline std::uint16_t Image::depth() const
+{
+    return mDepth;
+}
+
+inline std::uint16_t Image::bytesPerRow() const
+{
+    return mBytesPerRow;
+}
+
+inline std::uint8_t* Image::plane(std::uint16_t index)
+{
+    return mData + static_cast<std::uint32_t>(index) * mBytesPerRow * mHeight;
+}
+
+inline const std::uint8_t* Image::plane(std::uint16_t index) const
+{
+    return mData + static_cast<std::uint32_t>(index) * mBytesPerRow * mHeight;
+}
+
+inline std::uint32_t Image::size() const
+{
+    return mSize;
+}
+
+} // namespace trost
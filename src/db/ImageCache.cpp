@@ -0,0 +1,72 @@
+#include "ImageCache.h"
+
+using namespace trost;
+
+ImageCache::ImageCache(std::uint32_t budget)
+    : mBudget(budget)
+{
+}
+
+void ImageCache::setBudget(std::uint32_t budget)
+{
+    mBudget = budget;
+    evict();
+}
+
+SharedPtr<Image> ImageCache::get(std::uint32_t offset)
+{
+    const auto sz = mSlots.size();
+    for (std::size_t i = 0; i < sz; ++i) {
+        if (mSlots[i].offset == offset) {
+            mSlots[i].used = ++mClock;
+            return mSlots[i].image;
+        }
+    }
+    return SharedPtr<Image>();
+}
+
+void ImageCache::put(std::uint32_t offset, const SharedPtr<Image>& image)
+{
+    const auto sz = mSlots.size();
+    for (std::size_t i = 0; i < sz; ++i) {
+        if (mSlots[i].offset == offset) {
+            mBytes -= mSlots[i].image->size();
+            mSlots[i].image = image;
+            mSlots[i].used = ++mClock;
+            mBytes += image->size();
+            evict();
+            return;
+        }
+    }
+    mSlots.push_back({ offset, ++mClock, image });
+    mBytes += image->size();
+    evict();
+}
+
+void ImageCache::clear()
+{
+    while (mSlots.size() > 0) {
+        mSlots.pop_back();
+    }
+    mBytes = 0;
+}
+
+void ImageCache::evict()
+{
+    while (mBytes > mBudget) {
+        // oldest image nobody else holds on to
+        std::size_t victim = mSlots.size();
+        const auto sz = mSlots.size();
+        for (std::size_t i = 0; i < sz; ++i) {
+            if (mSlots[i].image.useCount() == 1 && (victim == sz || mSlots[i].used < mSlots[victim].used)) {
+                victim = i;
+            }
+        }
+        if (victim == sz) {
+            return;
+        }
+        mBytes -= mSlots[victim].image->size();
+        mSlots[victim] = std::move(mSlots.back());
+        mSlots.pop_back();
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Image.h"
+#include "util/SharedPtr.h"
+#include "util/Vector.h"
+#include <cstdint>
+
+namespace trost {
+
+// Decoded thumbnails keyed by record offset, least recently used ones are
+// dropped once the total size goes over budget. Images that are still
+// held by an entry stay put, so the cache can be over budget for as long
+// as everything in it is on screen.
+class ImageCache
+{
+public:
+    ImageCache(std::uint32_t budget = 128 * 1024);
+
+    void setBudget(std::uint32_t budget);
+    std::uint32_t budget() const;
+    std::uint32_t bytes() const;
+    std::uint32_t count() const;
+    // bytes that can be added without evicting anything
+    std::uint32_t headroom() const;
+
+    SharedPtr<Image> get(std::uint32_t offset);
+    void put(std::uint32_t offset, const SharedPtr<Image>& image);
+    void clear();
+
+private:
+    void evict();
+
+    struct Slot
+    {
+        std::uint32_t offset;
+        std::uint32_t used;
+        SharedPtr<Image> image;
+    };
+
+    Vector<Slot> mSlots;
+    std::uint32_t mBudget;
+    std::uint32_t mBytes = 0;
+    std::uint32_t mClock = 0;
+};
+
+inline std::uint32_t ImageCache::budget() const
+{
+    return mBudget;
+}
+
+inline std::uint32_t ImageCache::bytes() const
+{
+    return mBytes;
+}
+
+inline std::uint32_t ImageCache::count() const
+{
+    return static_cast<std::uint32_t>(mSlots.size());
+}
+
+inline std::uint32_t ImageCache::headroom() const
+{
+    return mBytes < mBudget ? mBudget - mBytes : 0;
+}
+
+} // namespace trost
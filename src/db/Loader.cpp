@@ -0,0 +1,359 @@
+#include "Loader.h"
+#if defined(__amigaos__)
+#include "App.h"
+#include <clib/dos_protos.h>
+#include <clib/exec_protos.h>
+#include <dos/dosextens.h>
+#include <dos/dostags.h>
+#endif
+#include <cstdio>
+#include <cstring>
+
+using namespace trost;
+
+Loader::Job::Job(std::uint16_t c, bool b)
+    : count(c), bitmaps(b), offsets(new std::uint32_t[c]), results(new Result[c])
+{
+#if defined(__amigaos__)
+    envelope.message = {};
+    envelope.message.mn_Length = sizeof(Envelope);
+    envelope.job = this;
+#endif
+}
+
+Loader::Job::~Job()
+{
+    delete[] results;
+    delete[] offsets;
+}
+
+Loader::~Loader()
+{
+    stop();
+}
+
+bool Loader::cancel(std::uint32_t id)
+{
+    const auto sz = mInFlight.size();
+    for (std::size_t i = 0; i < sz; ++i) {
+        if (mInFlight[i]->id == id) {
+            mInFlight[i]->cancelled = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Loader::finish(Job* job)
+{
+    const auto sz = mInFlight.size();
+    for (std::size_t i = 0; i < sz; ++i) {
+        if (mInFlight[i] == job) {
+            mInFlight.remove_at(i);
+            break;
+        }
+    }
+    if (job->done && !job->cancelled) {
+        job->done(job);
+    }
+    delete job;
+}
+
+void Loader::work(Job* job)
+{
+    while (job->loaded < job->count && !job->cancelled) {
+        auto& result = job->results[job->loaded];
+        if (!format::readRecord(mData, job->offsets[job->loaded], &result.record, mRecordScratch)) {
+            break;
+        }
+        if (job->bitmaps) {
+            char path[512];
+            File file;
+            if (format::bitmapPath(path, sizeof(path), mDir, result.record.offset) && file.open(path, File::Mode::Read)) {
+                result.image.loadILBM(file, mImageScratch, sizeof(mImageScratch));
+            }
+        }
+        ++job->loaded;
+    }
+}
+
+#if defined(__amigaos__)
+
+namespace {
+struct Startup
+{
+    Message message;
+    Loader* loader;
+};
+} // anonymous namespace
+
+static void loader_entry()
+{
+    auto self = reinterpret_cast<Process*>(FindTask(nullptr));
+    WaitPort(&self->pr_MsgPort);
+    auto startup = reinterpret_cast<Startup*>(GetMsg(&self->pr_MsgPort));
+    startup->loader->serve(&startup->message);
+}
+
+bool Loader::start(const char* dir)
+{
+    if (mRunning) {
+        return true;
+    }
+    if (strlen(dir) >= sizeof(mDir) || !format::joinPath(mDataPath, sizeof(mDataPath), dir, "data.idx")) {
+        return false;
+    }
+    strcpy(mDir, dir);
+
+    mReplyPort = CreateMsgPort();
+    if (!mReplyPort) {
+        return false;
+    }
+    mProcess = CreateNewProcTags(NP_Entry, reinterpret_cast<ULONG>(loader_entry),
+                                 NP_Name, reinterpret_cast<ULONG>("trost loader"),
+                                 NP_StackSize, 8192,
+                                 NP_Priority, -1,
+                                 TAG_DONE);
+    if (!mProcess) {
+        DeleteMsgPort(mReplyPort);
+        mReplyPort = nullptr;
+        return false;
+    }
+
+    // the process can't know who we are until it gets this, it replies
+    // once its port is up
+    Startup startup = {};
+    startup.message.mn_ReplyPort = mReplyPort;
+    startup.message.mn_Length = sizeof(startup);
+    startup.loader = this;
+    PutMsg(&mProcess->pr_MsgPort, &startup.message);
+    WaitPort(mReplyPort);
+    GetMsg(mReplyPort);
+
+    if (!mWorkerPort) {
+        // the process is gone already
+        printf("Failed to start loader\n");
+        mProcess = nullptr;
+        DeleteMsgPort(mReplyPort);
+        mReplyPort = nullptr;
+        return false;
+    }
+
+    mRunning = true;
+    App::instance()->addSignal(mReplyPort->mp_SigBit, [this]() -> void {
+        process();
+    });
+    return true;
+}
+
+void Loader::serve(Message* startup)
+{
+    // ports have to be created by the task that waits on them
+    mWorkerPort = CreateMsgPort();
+    if (mWorkerPort && !mData.open(mDataPath, File::Mode::Read)) {
+        DeleteMsgPort(mWorkerPort);
+        mWorkerPort = nullptr;
+    }
+    if (!mWorkerPort) {
+        // make sure we're gone before the main task runs again
+        Forbid();
+        ReplyMsg(startup);
+        return;
+    }
+    ReplyMsg(startup);
+
+    for (;;) {
+        WaitPort(mWorkerPort);
+        Message* msg;
+        while ((msg = GetMsg(mWorkerPort))) {
+            auto envelope = reinterpret_cast<Envelope*>(msg);
+            if (!envelope->job) {
+                mData.close();
+                DeleteMsgPort(mWorkerPort);
+                Forbid();
+                ReplyMsg(msg);
+                return;
+            }
+            work(envelope->job);
+            ReplyMsg(msg);
+        }
+    }
+}
+
+void Loader::stop()
+{
+    if (!mRunning) {
+        return;
+    }
+    App::instance()->removeSignal(mReplyPort->mp_SigBit);
+
+    // jobs are handled in order, once the quit comes back everything
+    // before it has been replied to as well
+    mQuit.message.mn_ReplyPort = mReplyPort;
+    mQuit.message.mn_Length = sizeof(mQuit);
+    mQuit.job = nullptr;
+    PutMsg(mWorkerPort, &mQuit.message);
+    for (;;) {
+        WaitPort(mReplyPort);
+        auto envelope = reinterpret_cast<Envelope*>(GetMsg(mReplyPort));
+        if (!envelope) {
+            continue;
+        }
+        if (!envelope->job) {
+            break;
+        }
+        delete envelope->job;
+    }
+    Message* msg;
+    while ((msg = GetMsg(mReplyPort))) {
+        delete reinterpret_cast<Envelope*>(msg)->job;
+    }
+
+    while (mInFlight.size() > 0) {
+        mInFlight.pop_back();
+    }
+
+    DeleteMsgPort(mReplyPort);
+    mReplyPort = nullptr;
+    mWorkerPort = nullptr;
+    mProcess = nullptr;
+    mRunning = false;
+}
+
+std::uint32_t Loader::submit(Job* job)
+{
+    job->id = ++mNextId;
+    mInFlight.push_back(job);
+    job->envelope.message.mn_ReplyPort = mReplyPort;
+    PutMsg(mWorkerPort, &job->envelope.message);
+    return job->id;
+}
+
+void Loader::process()
+{
+    Message* msg;
+    while ((msg = GetMsg(mReplyPort))) {
+        finish(reinterpret_cast<Envelope*>(msg)->job);
+    }
+}
+
+#else
+
+bool Loader::start(const char* dir)
+{
+    if (mRunning) {
+        return true;
+    }
+    if (strlen(dir) >= sizeof(mDir) || !format::joinPath(mDataPath, sizeof(mDataPath), dir, "data.idx")) {
+        return false;
+    }
+    strcpy(mDir, dir);
+    if (!mData.open(mDataPath, File::Mode::Read)) {
+        return false;
+    }
+
+    mQuit = false;
+    mThread = std::thread([this]() -> void {
+        serve();
+    });
+    mRunning = true;
+    return true;
+}
+
+void Loader::serve()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    for (;;) {
+        mWake.wait(lock, [this]() -> bool {
+            return mPending || mQuit;
+        });
+        if (!mPending) {
+            break;
+        }
+        auto job = mPending;
+        mPending = job->next;
+        if (!mPending) {
+            mPendingTail = nullptr;
+        }
+        job->next = nullptr;
+
+        lock.unlock();
+        work(job);
+        lock.lock();
+
+        if (mFinishedTail) {
+            mFinishedTail->next = job;
+        } else {
+            mFinished = job;
+        }
+        mFinishedTail = job;
+        mFinishedCond.notify_all();
+    }
+    mData.close();
+}
+
+void Loader::stop()
+{
+    if (!mRunning) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQuit = true;
+    }
+    mWake.notify_all();
+    mThread.join();
+
+    while (mFinished) {
+        auto job = mFinished;
+        mFinished = job->next;
+        delete job;
+    }
+    mFinishedTail = nullptr;
+    while (mInFlight.size() > 0) {
+        mInFlight.pop_back();
+    }
+    mRunning = false;
+}
+
+std::uint32_t Loader::submit(Job* job)
+{
+    job->id = ++mNextId;
+    mInFlight.push_back(job);
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mPendingTail) {
+            mPendingTail->next = job;
+        } else {
+            mPending = job;
+        }
+        mPendingTail = job;
+    }
+    mWake.notify_one();
+    return job->id;
+}
+
+void Loader::process()
+{
+    Job* finished;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        finished = mFinished;
+        mFinished = mFinishedTail = nullptr;
+    }
+    while (finished) {
+        auto job = finished;
+        finished = job->next;
+        finish(job);
+    }
+}
+
+void Loader::wait()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mFinishedCond.wait(lock, [this]() -> bool {
+        return mFinished != nullptr;
+    });
+}
+
+#endif
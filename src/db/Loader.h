@@ -0,0 +1,167 @@
+#pragma once
+
+#include "File.h"
+#include "Format.h"
+#include "Image.h"
+#include "util/Function.h"
+#include "util/Vector.h"
+#include <cstdint>
+#if defined(__amigaos__)
+#include <exec/types.h>
+#else
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+#if defined(__amigaos__)
+struct Process;
+#endif
+
+namespace trost {
+
+// Reads data.idx records and decodes thumbnails off the main task. On
+// AmigaOS the worker is a DOS process that gets jobs as exec messages and
+// replies to a port whose signal is hooked into the App loop. Elsewhere a
+// std::thread stands in and process() or wait() are called by hand.
+//
+// The worker only ever touches a job's offsets, count and results, which
+// are plain data allocated up front, so it never allocates from the
+// shared heap or touches a refcount.
+class Loader
+{
+public:
+    struct Result
+    {
+        format::Record record;
+        Image image;
+    };
+
+    struct Job;
+
+#if defined(__amigaos__)
+    // what actually travels between the tasks, job is null for the quit
+    // message
+    struct Envelope
+    {
+        Message message;
+        Job* job;
+    };
+#endif
+
+    struct Job
+    {
+        Job(std::uint16_t count, bool bitmaps);
+        ~Job();
+
+        Job(const Job&) = delete;
+        Job& operator=(const Job&) = delete;
+
+        // in
+        std::uint32_t id = 0;
+        std::uint16_t count;
+        bool bitmaps;
+        // the record offset of each of the count records to read, filled in
+        // by whoever submits the job
+        std::uint32_t* offsets;
+
+        // out, one per offset in the same order
+        Result* results;
+        std::uint16_t loaded = 0;
+
+        // runs on the main task when the job comes back, unless the job
+        // was cancelled
+        Function<void(Job*)> done;
+
+        // set by the main task, the worker stops at the next record
+#if defined(__amigaos__)
+        volatile bool cancelled = false;
+#else
+        std::atomic<bool> cancelled { false };
+#endif
+
+#if defined(__amigaos__)
+        Envelope envelope;
+#else
+        Job* next = nullptr;
+#endif
+    };
+
+    Loader() = default;
+    ~Loader();
+
+    Loader(const Loader&) = delete;
+    Loader& operator=(const Loader&) = delete;
+
+    bool start(const char* dir);
+    // jobs still in flight are finished but their done isn't called
+    void stop();
+    bool isRunning() const;
+
+    // takes ownership of job, returns an id for cancel
+    std::uint32_t submit(Job* job);
+    // the job still comes back but its done isn't called
+    bool cancel(std::uint32_t id);
+    std::uint32_t pending() const;
+    // calls done for every finished job and deletes it
+    void process();
+
+#if !defined(__amigaos__)
+    // blocks until a job has finished
+    void wait();
+#endif
+
+    // the worker's side
+#if defined(__amigaos__)
+    void serve(Message* startup);
+#else
+    void serve();
+#endif
+
+private:
+    void work(Job* job);
+    void finish(Job* job);
+
+    char mDir[256] = {};
+    char mDataPath[256] = {};
+
+    // only used by the worker
+    File mData;
+    std::uint8_t mRecordScratch[format::MaxRecordSize];
+    std::uint8_t mImageScratch[2048];
+
+#if defined(__amigaos__)
+    Process* mProcess = nullptr;
+    MsgPort* mReplyPort = nullptr;
+    MsgPort* mWorkerPort = nullptr;
+    Envelope mQuit = {};
+#else
+    std::thread mThread;
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    std::condition_variable mFinishedCond;
+    Job* mPending = nullptr;
+    Job* mPendingTail = nullptr;
+    Job* mFinished = nullptr;
+    Job* mFinishedTail = nullptr;
+    bool mQuit = false;
+#endif
+    bool mRunning = false;
+
+    // submitted jobs that haven't come back yet, main task only
+    Vector<Job*> mInFlight;
+    std::uint32_t mNextId = 0;
+};
+
+inline bool Loader::isRunning() const
+{
+    return mRunning;
+}
+
+inline std::uint32_t Loader::pending() const
+{
+    return static_cast<std::uint32_t>(mInFlight.size());
+}
+
+} // namespace trost
@@ -0,0 +1,66 @@
+#include "Order.h"
+#include "Format.h"
+#include <utility>
+
+using namespace trost;
+
+Order::~Order()
+{
+    release();
+}
+
+Order::Order(Order&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+Order& Order::operator=(Order&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        mData = other.mData;
+        mSize = other.mSize;
+        mWidth = other.mWidth;
+        other.mData = nullptr;
+        other.mSize = 0;
+        other.mWidth = 0;
+    }
+    return *this;
+}
+
+bool Order::allocate(std::uint32_t count, std::uint32_t entries)
+{
+    release();
+    const auto width = widthFor(entries);
+    mData = new std::uint8_t[count ? count * width : 1];
+    if (!mData) {
+        return false;
+    }
+    mSize = count;
+    mWidth = width;
+    return true;
+}
+
+void Order::release()
+{
+    delete[] mData;
+    mData = nullptr;
+    mSize = 0;
+    mWidth = 0;
+}
+
+std::uint32_t Order::at(std::uint32_t index) const
+{
+    const auto p = mData + index * mWidth;
+    return mWidth == 2 ? format::get16(p) : format::get32(p);
+}
+
+void Order::set(std::uint32_t index, std::uint32_t id)
+{
+    const auto p = mData + index * mWidth;
+    if (mWidth == 2) {
+        format::put16(p, static_cast<std::uint16_t>(id));
+    } else {
+        format::put32(p, id);
+    }
+}
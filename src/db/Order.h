@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+
+namespace trost {
+
+// Entry ids in some order other than by name, e.g. by year. Kept the way
+// orders.idx has them, two bytes an id when they all fit, so switching to
+// an order is one read into here.
+class Order
+{
+public:
+    Order() = default;
+    ~Order();
+
+    Order(Order&& other) noexcept;
+    Order& operator=(Order&& other) noexcept;
+
+    Order(const Order&) = delete;
+    Order& operator=(const Order&) = delete;
+
+    // room for count ids, all of them below entries
+    bool allocate(std::uint32_t count, std::uint32_t entries);
+    void release();
+
+    std::uint32_t size() const;
+    std::uint32_t at(std::uint32_t index) const;
+    void set(std::uint32_t index, std::uint32_t id);
+
+    // bytes per id, 2 or 4
+    static std::uint8_t widthFor(std::uint32_t entries);
+    std::uint8_t width() const;
+
+    // the ids as stored on disk
+    std::uint8_t* data();
+    const std::uint8_t* data() const;
+    std::uint32_t bytes() const;
+
+private:
+    std::uint8_t* mData = nullptr;
+    std::uint32_t mSize = 0;
+    std::uint8_t mWidth = 0;
+};
+
+inline std::uint32_t Order::size() const
+{
+    return mSize;
+}
+
+inline std::uint8_t Order::widthFor(std::uint32_t entries)
+{
+    return entries <= 0x10000 ? 2 : 4;
+}
+
+inline std::uint8_t Order::width() const
+{
+    return mWidth;
+}
+
+inline std::uint8_t* Order::data()
+{
+    return mData;
+}
+
+inline const std::uint8_t* Order::data() const
+{
+    return mData;
+}
+
+inline std::uint32_t Order::bytes() const
+{
+    return mSize * mWidth;
+}
+
+} // namespace trost
@@ -0,0 +1,116 @@
+#include "PerfectHash.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace trost;
+
+PerfectHash::Key PerfectHash::hash(const char* name, std::size_t length)
+{
+    // FNV-1a for the bucket and a murmur style mix for the slot
+    std::uint32_t a = 0x811c9dc5;
+    std::uint32_t b = 0x9747b28c;
+    for (std::size_t i = 0; i < length; ++i) {
+        const auto c = static_cast<unsigned char>(name[i]);
+        a = (a ^ c) * 0x01000193;
+        b = (b ^ c) * 0x5bd1e995;
+        b ^= b >> 15;
+    }
+    return { a, b };
+}
+
+std::uint32_t PerfectHash::slotFor(const Key& key, std::uint32_t seed, std::uint32_t count)
+{
+    if (seed & DirectSeed) {
+        return (seed & ~DirectSeed) % count;
+    }
+    auto x = key.slot ^ (seed * 0x9e3779b9);
+    x ^= x >> 16;
+    x *= 0x85ebca6b;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35;
+    x ^= x >> 16;
+    return x % count;
+}
+
+bool PerfectHash::build(const Key* keys, std::uint32_t count, std::uint32_t* seeds, std::uint32_t* slots)
+{
+    const auto buckets = bucketsFor(count);
+    if (!buckets) {
+        return true;
+    }
+
+    // keys grouped by bucket, members[start[b]] to members[start[b + 1]]
+    auto start = new std::uint32_t[buckets + 1];
+    auto members = new std::uint32_t[count];
+    auto order = new std::uint32_t[buckets];
+    auto taken = new std::uint8_t[count];
+    memset(start, 0, (buckets + 1) * sizeof(std::uint32_t));
+    memset(taken, 0, count);
+    for (std::uint32_t i = 0; i < count; ++i) {
+        ++start[keys[i].bucket % buckets + 1];
+    }
+    for (std::uint32_t b = 0; b < buckets; ++b) {
+        start[b + 1] += start[b];
+        order[b] = b;
+    }
+    {
+        auto fill = new std::uint32_t[buckets];
+        memcpy(fill, start, buckets * sizeof(std::uint32_t));
+        for (std::uint32_t i = 0; i < count; ++i) {
+            members[fill[keys[i].bucket % buckets]++] = i;
+        }
+        delete[] fill;
+    }
+    // ties in bucket order so the same names always give the same table
+    std::sort(order, order + buckets, [start](std::uint32_t x, std::uint32_t y) -> bool {
+        const auto sx = start[x + 1] - start[x], sy = start[y + 1] - start[y];
+        return sx != sy ? sx > sy : x < y;
+    });
+
+    bool ok = true;
+    std::uint32_t free = 0;
+    for (std::uint32_t o = 0; o < buckets && ok; ++o) {
+        const auto b = order[o];
+        const auto first = members + start[b];
+        const auto size = start[b + 1] - start[b];
+        seeds[b] = 0;
+        if (!size) {
+            continue;
+        }
+        // everything left is a single name, any free slot will do
+        if (size == 1) {
+            while (taken[free]) {
+                ++free;
+            }
+            taken[free] = 1;
+            slots[first[0]] = free;
+            seeds[b] = DirectSeed | free;
+            continue;
+        }
+
+        ok = false;
+        for (std::uint32_t seed = 0; seed <= 0xffff && !ok; ++seed) {
+            ok = true;
+            for (std::uint32_t i = 0; i < size && ok; ++i) {
+                const auto slot = slotFor(keys[first[i]], seed, count);
+                ok = !taken[slot];
+                for (std::uint32_t j = 0; j < i && ok; ++j) {
+                    ok = slots[first[j]] != slot;
+                }
+                slots[first[i]] = slot;
+            }
+            if (ok) {
+                seeds[b] = static_cast<std::uint16_t>(seed);
+                for (std::uint32_t i = 0; i < size; ++i) {
+                    taken[slots[first[i]]] = 1;
+                }
+            }
+        }
+    }
+
+    delete[] start;
+    delete[] members;
+    delete[] order;
+    delete[] taken;
+    return ok;
+}
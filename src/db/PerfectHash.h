@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace trost {
+
+// CHD style minimal perfect hash over entry names. Names are hashed into
+// buckets of about four, then the buckets are placed biggest first by
+// trying seeds until every name in the bucket lands on a slot of its own.
+// A lookup hashes the name once and needs only its bucket's seed to know
+// the slot. Buckets of one name are placed last, when a seed that hits one
+// of the few free slots is hard to come by, so their seed is the slot
+// itself with DirectSeed set.
+class PerfectHash
+{
+public:
+    // over collation keys, which are already folded. both halves come
+    // from the same pass over the key
+    struct Key
+    {
+        std::uint32_t bucket;
+        std::uint32_t slot;
+    };
+    static Key hash(const char* name, std::size_t length);
+
+    static constexpr std::uint32_t DirectSeed = 0x80000000;
+
+    static std::uint32_t bucketsFor(std::uint32_t count);
+    static std::uint32_t slotFor(const Key& key, std::uint32_t seed, std::uint32_t count);
+
+    // fills bucketsFor(count) seeds and the slot each key ended up in.
+    // fails if a bucket can't be placed with any seed, which in practice
+    // means two names hash the same
+    static bool build(const Key* keys, std::uint32_t count, std::uint32_t* seeds, std::uint32_t* slots);
+};
+
+inline std::uint32_t PerfectHash::bucketsFor(std::uint32_t count)
+{
+    return (count + 3) / 4;
+}
+
+} // namespace trost
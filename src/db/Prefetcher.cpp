@@ -0,0 +1,226 @@
+#include "Prefetcher.h"
+#if defined(__amigaos__)
+#include "App.h"
+#endif
+
+using namespace trost;
+
+Prefetcher::Prefetcher(DB* db)
+    : mDB(db)
+{
+    clear();
+}
+
+void Prefetcher::configure(const Config& config)
+{
+    cancel();
+    clear();
+    mConfig = config;
+    mShown = false;
+}
+
+Prefetcher::~Prefetcher()
+{
+#if defined(__amigaos__)
+    detach();
+#endif
+    cancel();
+    clear();
+}
+
+void Prefetcher::clear()
+{
+    for (auto& page : mPages) {
+        drop(&page);
+    }
+    mHead = DB::NoEntry;
+}
+
+void Prefetcher::drop(Page* page)
+{
+    // let the cache have the thumbnails back
+    if (page->held) {
+        mDB->dispose(page->head, mConfig.pageSize);
+    }
+    *page = Page();
+}
+
+void Prefetcher::cancel()
+{
+    if (!mJob) {
+        return;
+    }
+    mDB->cancel(mJob);
+    mJob = 0;
+    mJobSlot = -1;
+    ++mStats.cancelled;
+}
+
+void Prefetcher::wake()
+{
+#if defined(__amigaos__)
+    if (mTask) {
+        App::instance()->wakeTask(mTask);
+    }
+#endif
+}
+
+bool Prefetcher::isLoaded(DB::Id head) const
+{
+    // a page is only ready once its thumbnails are there, the records
+    // alone aren't what a prefetch is for
+    const auto count = mDB->entryCount();
+    for (int i = 0; i < mConfig.pageSize && head + i < count; ++i) {
+        const auto entry = mDB->entry(head + i);
+        if (!entry || !entry->bitmap) {
+            return false;
+        }
+    }
+    return true;
+}
+
+DB::Id Prefetcher::headOf(int slot)
+{
+    if (mHead == DB::NoEntry) {
+        return DB::NoEntry;
+    }
+    const long head = static_cast<long>(mHead) + static_cast<long>(slot - Center) * mConfig.pageSize;
+    if (head < 0 || head >= static_cast<long>(mDB->entryCount())) {
+        return DB::NoEntry;
+    }
+    return static_cast<DB::Id>(head);
+}
+
+void Prefetcher::show(long page, DB::Id head, unsigned long now)
+{
+    const long delta = page - mPage;
+    if (mShown && (delta == 1 || delta == -1)) {
+        // slide the window, the fetch in flight goes with its page and
+        // the page falling off the end is disposed
+        if (mJob && (mJobSlot - delta < 0 || mJobSlot - delta >= Window)) {
+            cancel();
+        } else if (mJob) {
+            mJobSlot -= static_cast<int>(delta);
+        }
+        if (delta > 0) {
+            drop(&mPages[0]);
+            for (int i = 0; i < Window - 1; ++i) {
+                mPages[i] = mPages[i + 1];
+            }
+            mPages[Window - 1] = Page();
+        } else {
+            drop(&mPages[Window - 1]);
+            for (int i = Window - 1; i > 0; --i) {
+                mPages[i] = mPages[i - 1];
+            }
+            mPages[0] = Page();
+        }
+
+        const auto elapsed = now - mLastShow;
+        const unsigned long rate = elapsed ? 16000 / elapsed : 16000;
+        mVelocity = elapsed > 2000 || static_cast<int>(delta) != mDirection ? rate : (mVelocity * 3 + rate) / 4;
+        mDirection = static_cast<int>(delta);
+    } else if (!mShown || delta != 0) {
+        // jumped, nothing we know about is near anymore
+        cancel();
+        clear();
+        mVelocity = 0;
+    }
+
+    auto& current = mPages[Center];
+    if (delta != 0 || !mShown) {
+        if (current.prefetched) {
+            if (current.loading) {
+                ++mStats.late;
+            } else {
+                ++mStats.hits;
+            }
+        } else if (!isLoaded(head)) {
+            ++mStats.misses;
+        }
+    }
+    mHead = head;
+
+    mPage = page;
+    mShown = true;
+    mLastShow = now;
+    wake();
+}
+
+bool Prefetcher::fetch(int slot)
+{
+    auto& page = mPages[slot];
+    const auto head = headOf(slot);
+    if (head == DB::NoEntry || page.loading || page.held || isLoaded(head)) {
+        return false;
+    }
+
+    page.prefetched = true;
+    page.loading = true;
+    page.head = head;
+    mJobSlot = slot;
+    ++mStats.issued;
+    // the page is held from when it's done until it leaves the window
+    mJob = mDB->hydrateAsync(head, mConfig.pageSize, [this]() -> void {
+        if (mJobSlot >= 0) {
+            mPages[mJobSlot].loading = false;
+            mPages[mJobSlot].held = true;
+        }
+        mJob = 0;
+        mJobSlot = -1;
+        wake();
+    });
+    return true;
+}
+
+bool Prefetcher::idle()
+{
+    if (!mShown) {
+        return false;
+    }
+    if (mJob) {
+        return true;
+    }
+
+    // don't push out thumbnails that might be looked at again for pages
+    // that might not be
+    const auto cache = mDB->cache();
+    const auto perImage = cache->count() ? cache->bytes() / cache->count() : mConfig.imageEstimate;
+    if (cache->headroom() < perImage * mConfig.pageSize) {
+        return false;
+    }
+
+    const int ahead = Center + mDirection;
+    const int behind = Center - mDirection;
+    if (fetch(ahead)) {
+        return true;
+    }
+    if (mVelocity >= mConfig.fastPages * 16 && fetch(ahead + mDirection)) {
+        return true;
+    }
+    return fetch(behind);
+}
+
+#if defined(__amigaos__)
+
+void Prefetcher::attach()
+{
+    if (mTask) {
+        return;
+    }
+    mTask = App::instance()->addTask([this]() -> App::Yield {
+        idle();
+        return App::Yield::wait();
+    });
+}
+
+void Prefetcher::detach()
+{
+    if (!mTask) {
+        return;
+    }
+    App::instance()->removeTask(mTask);
+    mTask = 0;
+}
+
+#endif
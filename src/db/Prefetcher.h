@@ -0,0 +1,121 @@
+#pragma once
+
+#include "DB.h"
+#include <cstdint>
+
+namespace trost {
+
+// Watches how a list view pages through the DB and hydrates the pages
+// around the visible one before they're needed. Pages are runs of ids in
+// name order, page n + 1 starts pageSize ids after page n. The pages two
+// either side of the
+// current one are tracked, jumping further than one page drops them and
+// cancels whatever was being fetched. A prefetched page stays hydrated
+// until it leaves the window, then it's disposed and its thumbnails are
+// the cache's to evict.
+class Prefetcher
+{
+public:
+    struct Config
+    {
+        int pageSize = 8;
+        // paging faster than this, in pages per second, fetches two
+        // pages ahead instead of one
+        unsigned int fastPages = 3;
+        // assumed thumbnail size until the cache has seen some
+        std::uint32_t imageEstimate = 4096;
+    };
+
+    // hits are shown pages that a prefetch had ready, late ones were
+    // still loading and misses nobody had asked for
+    struct Stats
+    {
+        std::uint32_t issued;
+        std::uint32_t hits;
+        std::uint32_t late;
+        std::uint32_t misses;
+        std::uint32_t cancelled;
+    };
+
+    Prefetcher(DB* db);
+    ~Prefetcher();
+
+    // forgets the pages seen so far
+    void configure(const Config& config);
+    const Config& config() const { return mConfig; }
+
+    Prefetcher(const Prefetcher&) = delete;
+    Prefetcher& operator=(const Prefetcher&) = delete;
+
+    // the view is about to show page, head is its first id and now is in
+    // milliseconds. call before hydrating the page so hits are counted
+    void show(long page, DB::Id head, unsigned long now);
+
+    // sends at most one prefetch to the loader. returns false when there
+    // is nothing worth fetching or the cache budget is used up
+    bool idle();
+
+    const Stats& stats() const;
+    void resetStats();
+
+#if defined(__amigaos__)
+    // runs idle() from an App task that sleeps until a page is shown or
+    // a prefetch completes
+    void attach();
+    void detach();
+#endif
+
+private:
+    static constexpr int Window = 5;
+    static constexpr int Center = Window / 2;
+
+    // held once the fetch for head is done, until the page is dropped
+    struct Page
+    {
+        bool prefetched = false;
+        bool loading = false;
+        bool held = false;
+        DB::Id head = DB::NoEntry;
+    };
+
+    bool isLoaded(DB::Id head) const;
+    DB::Id headOf(int slot);
+    bool fetch(int slot);
+    void clear();
+    void drop(Page* page);
+    void cancel();
+    void wake();
+
+    DB* mDB;
+    Config mConfig;
+    Stats mStats = {};
+
+    Page mPages[Window];
+    // first id of the current page
+    DB::Id mHead = DB::NoEntry;
+    long mPage = 0;
+    bool mShown = false;
+    int mDirection = 1;
+    unsigned long mLastShow = 0;
+    // pages per second, 4 bits of fraction
+    unsigned long mVelocity = 0;
+
+    std::uint32_t mJob = 0;
+    int mJobSlot = -1;
+
+#if defined(__amigaos__)
+    unsigned long mTask = 0;
+#endif
+};
+
+inline const Prefetcher::Stats& Prefetcher::stats() const
+{
+    return mStats;
+}
+
+inline void Prefetcher::resetStats()
+{
+    mStats = {};
+}
+
+} // namespace trost
@@ -0,0 +1,357 @@
+#include "Thumbnail.h"
+#include "util/C2P.h"
+#include <cstring>
+#include <utility>
+
+using namespace trost;
+
+// CAMG view mode bits
+static constexpr std::uint32_t ModeHAM = 0x800;
+static constexpr std::uint32_t ModeEHB = 0x80;
+
+Picture::~Picture()
+{
+    release();
+}
+
+Picture::Picture(Picture&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+Picture& Picture::operator=(Picture&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        mData = other.mData;
+        mWidth = other.mWidth;
+        mHeight = other.mHeight;
+        other.mData = nullptr;
+        other.mWidth = other.mHeight = 0;
+    }
+    return *this;
+}
+
+bool Picture::allocate(std::uint16_t width, std::uint16_t height)
+{
+    release();
+    if (!width || !height) {
+        return false;
+    }
+    mData = new std::uint8_t[static_cast<std::uint32_t>(width) * height * 3];
+    if (!mData) {
+        return false;
+    }
+    mWidth = width;
+    mHeight = height;
+    return true;
+}
+
+void Picture::release()
+{
+    delete[] mData;
+    mData = nullptr;
+    mWidth = mHeight = 0;
+}
+
+bool Picture::load(File& file, std::uint8_t* scratch, std::uint32_t scratchSize)
+{
+    Image planar;
+    Image::ILBMInfo info;
+    if (!planar.loadILBM(file, scratch, scratchSize, &info) || (info.viewModes & ModeHAM)) {
+        return false;
+    }
+
+    // extra halfbrite is 6 planes over 32 colours where the top plane
+    // halves the colour, some files forget to say so in CAMG
+    const bool halfbrite = (info.viewModes & ModeEHB) || (planar.depth() == 6 && info.colors == 32);
+    std::uint8_t cmap[256 * 3];
+    memset(cmap, 0, sizeof(cmap));
+    memcpy(cmap, info.cmap, info.colors * 3);
+    if (halfbrite) {
+        for (int i = 0; i < 32 * 3; ++i) {
+            cmap[32 * 3 + i] = cmap[i] >> 1;
+        }
+    }
+
+    if (!allocate(planar.width(), planar.height())) {
+        return false;
+    }
+    for (std::uint16_t y = 0; y < mHeight; ++y) {
+        auto out = row(y);
+        const std::uint32_t line = static_cast<std::uint32_t>(y) * planar.bytesPerRow();
+        for (std::uint16_t x = 0; x < mWidth; ++x) {
+            const std::uint8_t bit = 0x80 >> (x & 7);
+            unsigned int index = 0;
+            for (std::uint16_t p = 0; p < planar.depth(); ++p) {
+                if (planar.plane(p)[line + (x >> 3)] & bit) {
+                    index |= 1u << p;
+                }
+            }
+            memcpy(out + x * 3, cmap + index * 3, 3);
+        }
+    }
+    return true;
+}
+
+bool Picture::fit(const Picture& source, std::uint16_t maxWidth, std::uint16_t maxHeight)
+{
+    if (!source.mData || !maxWidth || !maxHeight) {
+        return false;
+    }
+
+    std::uint32_t width = source.mWidth;
+    std::uint32_t height = source.mHeight;
+    if (width > maxWidth) {
+        height = height * maxWidth / width;
+        width = maxWidth;
+    }
+    if (height > maxHeight) {
+        width = width * maxHeight / height;
+        height = maxHeight;
+    }
+    if (!allocate(width ? width : 1, height ? height : 1)) {
+        return false;
+    }
+
+    // every destination pixel averages the source pixels it covers
+    for (std::uint16_t y = 0; y < mHeight; ++y) {
+        const std::uint32_t y0 = static_cast<std::uint32_t>(y) * source.mHeight / mHeight;
+        std::uint32_t y1 = static_cast<std::uint32_t>(y + 1) * source.mHeight / mHeight;
+        if (y1 <= y0) {
+            y1 = y0 + 1;
+        }
+        auto out = row(y);
+        for (std::uint16_t x = 0; x < mWidth; ++x) {
+            const std::uint32_t x0 = static_cast<std::uint32_t>(x) * source.mWidth / mWidth;
+            std::uint32_t x1 = static_cast<std::uint32_t>(x + 1) * source.mWidth / mWidth;
+            if (x1 <= x0) {
+                x1 = x0 + 1;
+            }
+            std::uint32_t sum[3] = {};
+            for (auto sy = y0; sy < y1; ++sy) {
+                const auto in = source.row(static_cast<std::uint16_t>(sy));
+                for (auto sx = x0; sx < x1; ++sx) {
+                    sum[0] += in[sx * 3];
+                    sum[1] += in[sx * 3 + 1];
+                    sum[2] += in[sx * 3 + 2];
+                }
+            }
+            const auto area = (y1 - y0) * (x1 - x0);
+            for (int c = 0; c < 3; ++c) {
+                out[x * 3 + c] = static_cast<std::uint8_t>((sum[c] + area / 2) / area);
+            }
+        }
+    }
+    return true;
+}
+
+static inline unsigned int to4(unsigned int v)
+{
+    return (v * 15 + 127) / 255;
+}
+
+PaletteBuilder::PaletteBuilder()
+{
+    memset(mHistogram, 0, sizeof(mHistogram));
+}
+
+void PaletteBuilder::add(const Picture& picture)
+{
+    for (std::uint16_t y = 0; y < picture.height(); ++y) {
+        const auto in = picture.row(y);
+        for (std::uint16_t x = 0; x < picture.width(); ++x) {
+            const auto p = in + x * 3;
+            ++mHistogram[(to4(p[0]) << 8) | (to4(p[1]) << 4) | to4(p[2])];
+        }
+    }
+}
+
+namespace {
+struct Box
+{
+    std::uint8_t min[3];
+    std::uint8_t max[3];
+    std::uint32_t count;
+};
+} // anonymous namespace
+
+template<typename F>
+static void for_each_bin(const Box& box, F&& f)
+{
+    for (unsigned int r = box.min[0]; r <= box.max[0]; ++r) {
+        for (unsigned int g = box.min[1]; g <= box.max[1]; ++g) {
+            for (unsigned int b = box.min[2]; b <= box.max[2]; ++b) {
+                f(r, g, b, (r << 8) | (g << 4) | b);
+            }
+        }
+    }
+}
+
+// tighten a box around the colours actually in it and count them
+static void shrink_box(Box& box, const std::uint32_t* histogram)
+{
+    std::uint8_t min[3] = { 15, 15, 15 };
+    std::uint8_t max[3] = { 0, 0, 0 };
+    std::uint32_t count = 0;
+    for_each_bin(box, [&](unsigned int r, unsigned int g, unsigned int b, unsigned int bin) {
+        if (!histogram[bin]) {
+            return;
+        }
+        const unsigned int c[3] = { r, g, b };
+        for (int i = 0; i < 3; ++i) {
+            if (c[i] < min[i]) {
+                min[i] = static_cast<std::uint8_t>(c[i]);
+            }
+            if (c[i] > max[i]) {
+                max[i] = static_cast<std::uint8_t>(c[i]);
+            }
+        }
+        count += histogram[bin];
+    });
+    if (count) {
+        memcpy(box.min, min, 3);
+        memcpy(box.max, max, 3);
+    }
+    box.count = count;
+}
+
+std::uint16_t PaletteBuilder::build(std::uint16_t* palette, std::uint16_t count) const
+{
+    if (!count) {
+        return 0;
+    }
+
+    Box boxes[256];
+    if (count > 256) {
+        count = 256;
+    }
+    boxes[0] = { { 0, 0, 0 }, { 15, 15, 15 }, 0 };
+    shrink_box(boxes[0], mHistogram);
+    if (!boxes[0].count) {
+        return 0;
+    }
+    std::uint16_t used = 1;
+
+    while (used < count) {
+        // split the box with the most pixels times its longest side, a
+        // big box of few pixels matters as little as a busy single colour
+        int pick = -1;
+        int axis = 0;
+        std::uint32_t best = 0;
+        for (std::uint16_t i = 0; i < used; ++i) {
+            const auto& box = boxes[i];
+            for (int a = 0; a < 3; ++a) {
+                const std::uint32_t side = box.max[a] - box.min[a];
+                if (side && box.count * side > best) {
+                    best = box.count * side;
+                    pick = i;
+                    axis = a;
+                }
+            }
+        }
+        if (pick < 0) {
+            break;
+        }
+
+        // find the median along the axis
+        auto& box = boxes[pick];
+        std::uint32_t slice[16] = {};
+        for_each_bin(box, [&](unsigned int r, unsigned int g, unsigned int b, unsigned int bin) {
+            const unsigned int c[3] = { r, g, b };
+            slice[c[axis]] += mHistogram[bin];
+        });
+        std::uint32_t seen = 0;
+        unsigned int cut = box.min[axis];
+        for (unsigned int v = box.min[axis]; v < box.max[axis]; ++v) {
+            seen += slice[v];
+            cut = v;
+            if (seen * 2 >= box.count) {
+                break;
+            }
+        }
+
+        Box upper = box;
+        box.max[axis] = static_cast<std::uint8_t>(cut);
+        upper.min[axis] = static_cast<std::uint8_t>(cut + 1);
+        shrink_box(box, mHistogram);
+        shrink_box(upper, mHistogram);
+        boxes[used++] = upper;
+    }
+
+    for (std::uint16_t i = 0; i < used; ++i) {
+        std::uint32_t sum[3] = {};
+        for_each_bin(boxes[i], [&](unsigned int r, unsigned int g, unsigned int b, unsigned int bin) {
+            sum[0] += r * mHistogram[bin];
+            sum[1] += g * mHistogram[bin];
+            sum[2] += b * mHistogram[bin];
+        });
+        const auto n = boxes[i].count;
+        palette[i] = static_cast<std::uint16_t>((((sum[0] + n / 2) / n) << 8) | (((sum[1] + n / 2) / n) << 4) | ((sum[2] + n / 2) / n));
+    }
+    return used;
+}
+
+Quantizer::Quantizer(const std::uint16_t* palette, std::uint16_t first, std::uint16_t count)
+{
+    for (unsigned int c = 0; c < 4096; ++c) {
+        const int r = c >> 8, g = (c >> 4) & 0xf, b = c & 0xf;
+        std::uint32_t best = ~0u;
+        std::uint8_t pick = static_cast<std::uint8_t>(first);
+        for (std::uint16_t i = first; i < first + count; ++i) {
+            const int dr = r - ((palette[i] >> 8) & 0xf);
+            const int dg = g - ((palette[i] >> 4) & 0xf);
+            const int db = b - (palette[i] & 0xf);
+            // weighted roughly like the eye does
+            const std::uint32_t d = 3 * dr * dr + 4 * dg * dg + 2 * db * db;
+            if (d < best) {
+                best = d;
+                pick = static_cast<std::uint8_t>(i);
+            }
+        }
+        mNearest[c] = pick;
+    }
+}
+
+bool Quantizer::convert(const Picture& picture, std::uint16_t depth, bool dither, Image* image) const
+{
+    // 4x4 Bayer, centred on zero and scaled to about the distance between
+    // neighbouring palette entries
+    static const int bayer[4][4] = {
+        { 0, 8, 2, 10 },
+        { 12, 4, 14, 6 },
+        { 3, 11, 1, 9 },
+        { 15, 7, 13, 5 },
+    };
+    constexpr int Spread = 48;
+
+    if (!image->allocate(picture.width(), picture.height(), depth)) {
+        return false;
+    }
+    auto chunky = new std::uint8_t[picture.width()];
+    if (!chunky) {
+        return false;
+    }
+    std::uint8_t* planes[8];
+    for (std::uint16_t y = 0; y < picture.height(); ++y) {
+        const auto in = picture.row(y);
+        for (std::uint16_t x = 0; x < picture.width(); ++x) {
+            int rgb[3] = { in[x * 3], in[x * 3 + 1], in[x * 3 + 2] };
+            if (dither) {
+                const int offset = (bayer[y & 3][x & 3] * 2 - 15) * Spread / 32;
+                for (auto& v : rgb) {
+                    v += offset;
+                    v = v < 0 ? 0 : (v > 255 ? 255 : v);
+                }
+            }
+            chunky[x] = mNearest[(to4(rgb[0]) << 8) | (to4(rgb[1]) << 4) | to4(rgb[2])];
+        }
+        // one row at a time, the planes are pointed at it
+        for (std::uint16_t p = 0; p < depth && p < 8; ++p) {
+            planes[p] = image->plane(p) + static_cast<std::uint32_t>(y) * image->bytesPerRow();
+        }
+        c2p::convert(chunky, picture.width(), picture.width(), 1, planes, image->bytesPerRow(), depth);
+    }
+    delete[] chunky;
+    return true;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "File.h"
+#include "Image.h"
+#include <cstdint>
+
+namespace trost {
+
+// Chunky 8 bit RGB, only used by the index builder to turn arbitrary
+// ILBMs into thumbnails that all share one palette.
+class Picture
+{
+public:
+    Picture() = default;
+    ~Picture();
+
+    Picture(Picture&& other) noexcept;
+    Picture& operator=(Picture&& other) noexcept;
+
+    Picture(const Picture&) = delete;
+    Picture& operator=(const Picture&) = delete;
+
+    bool allocate(std::uint16_t width, std::uint16_t height);
+    void release();
+
+    std::uint16_t width() const;
+    std::uint16_t height() const;
+    std::uint8_t* row(std::uint16_t y);
+    const std::uint8_t* row(std::uint16_t y) const;
+
+    // anything up to 8 planes, extra halfbrite included. HAM isn't
+    // supported
+    bool load(File& file, std::uint8_t* scratch, std::uint32_t scratchSize);
+
+    // box filtered down to fit in maxWidth x maxHeight keeping the aspect
+    // ratio, smaller pictures are copied as they are
+    bool fit(const Picture& source, std::uint16_t maxWidth, std::uint16_t maxHeight);
+
+private:
+    std::uint8_t* mData = nullptr;
+    std::uint16_t mWidth = 0;
+    std::uint16_t mHeight = 0;
+};
+
+// Median cut over a 12 bit colour histogram, 12 bits being what the
+// palette can show anyway. Pictures are added one at a time so they never
+// have to be in memory together.
+class PaletteBuilder
+{
+public:
+    PaletteBuilder();
+
+    void add(const Picture& picture);
+    // fills up to count 0x0RGB entries, returns how many were needed
+    std::uint16_t build(std::uint16_t* palette, std::uint16_t count) const;
+
+private:
+    std::uint32_t mHistogram[4096];
+};
+
+// Maps pictures onto palette entries first to first + count - 1 through a
+// table of the nearest entry for every 12 bit colour, optionally with a
+// 4x4 ordered dither so gradients don't band as badly.
+class Quantizer
+{
+public:
+    Quantizer(const std::uint16_t* palette, std::uint16_t first, std::uint16_t count);
+
+    bool convert(const Picture& picture, std::uint16_t depth, bool dither, Image* image) const;
+
+private:
+    std::uint8_t mNearest[4096];
+};
+
+inline std::uint16_t Picture::width() const
+{
+    return mWidth;
+}
+
+inline std::uint16_t Picture::height() const
+{
+    return mHeight;
+}
+
+inline std::uint8_t* Picture::row(std::uint16_t y)
+{
+    return mData + static_cast<std::uint32_t>(y) * mWidth * 3;
+}
+
+inline const std::uint8_t* Picture::row(std::uint16_t y) const
+{
+    return mData + static_cast<std::uint32_t>(y) * mWidth * 3;
+}
+
+} // namespace trost
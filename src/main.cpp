@@ -30,9 +30,15 @@ int main(int /*argc*/, char** /*argv*/)
 
     renderer->removeRenderer(helloId);
 
-    trost::KeyInput input;
-    if (trost::acquireKeyInput({ renderer->graphics(), { 10, 50, 0, 0 }, "Type something" }, &input)) {
-        printf("Input received: %s\n", input.buffer);
+    bool done = false;
+    trost::acquireKeyInput({ renderer->graphics(), { 10, 50, 0, 0 }, "Type something" }, [&done](const trost::KeyInput* input) -> void {
+        if (input) {
+            printf("Input received: %s\n", input->buffer);
+        }
+        done = true;
+    });
+    while (!done) {
+        app->iterateLoop();
     }
 
     trost::App::cleanup();
@@ -0,0 +1,156 @@
+#include "C2P.h"
+#include <cstring>
+#if defined(__amigaos__)
+#include <exec/execbase.h>
+
+extern "C" ExecBase *SysBase;
+#endif
+
+using namespace trost;
+
+namespace {
+
+// lo[v] has bit p of v at bit 8 * p for the low four planes, hi[v] the
+// same for the high four. shifting the sum left once per pixel leaves
+// plane p in byte p with the first pixel on top
+struct Spread
+{
+    std::uint32_t lo[256];
+    std::uint32_t hi[256];
+
+    constexpr Spread()
+        : lo(), hi()
+    {
+        for (unsigned int v = 0; v < 256; ++v) {
+            for (unsigned int p = 0; p < 4; ++p) {
+                if (v & (1u << p)) {
+                    lo[v] |= 1u << (8 * p);
+                }
+                if (v & (0x10u << p)) {
+                    hi[v] |= 1u << (8 * p);
+                }
+            }
+        }
+    }
+};
+
+constexpr Spread spread;
+
+typedef void (*Group)(const std::uint8_t* in, std::uint8_t* out);
+
+// each group turns 8 pixels into one byte per plane, out has room for 8
+
+void group_reference(const std::uint8_t* in, std::uint8_t* out)
+{
+    for (unsigned int p = 0; p < 8; ++p) {
+        std::uint8_t byte = 0;
+        for (unsigned int i = 0; i < 8; ++i) {
+            byte |= ((in[i] >> p) & 1) << (7 - i);
+        }
+        out[p] = byte;
+    }
+}
+
+void group_lookup(const std::uint8_t* in, std::uint8_t* out)
+{
+    std::uint32_t lo = 0, hi = 0;
+    for (unsigned int i = 0; i < 8; ++i) {
+        lo = (lo << 1) | spread.lo[in[i]];
+        hi = (hi << 1) | spread.hi[in[i]];
+    }
+    out[0] = static_cast<std::uint8_t>(lo);
+    out[1] = static_cast<std::uint8_t>(lo >> 8);
+    out[2] = static_cast<std::uint8_t>(lo >> 16);
+    out[3] = static_cast<std::uint8_t>(lo >> 24);
+    out[4] = static_cast<std::uint8_t>(hi);
+    out[5] = static_cast<std::uint8_t>(hi >> 8);
+    out[6] = static_cast<std::uint8_t>(hi >> 16);
+    out[7] = static_cast<std::uint8_t>(hi >> 24);
+}
+
+void group_merge(const std::uint8_t* in, std::uint8_t* out)
+{
+    // rows are pixels, columns are bits with bit 7 on the left
+    auto x = (static_cast<std::uint32_t>(in[0]) << 24) | (static_cast<std::uint32_t>(in[1]) << 16)
+        | (static_cast<std::uint32_t>(in[2]) << 8) | in[3];
+    auto y = (static_cast<std::uint32_t>(in[4]) << 24) | (static_cast<std::uint32_t>(in[5]) << 16)
+        | (static_cast<std::uint32_t>(in[6]) << 8) | in[7];
+
+    // swap 1x1 blocks of bits across the diagonal of each 2x2, then 2x2
+    // blocks within each 4x4, then the 4x4 blocks between the two words
+    std::uint32_t t;
+    t = (x ^ (x >> 7)) & 0x00aa00aa;
+    x ^= t ^ (t << 7);
+    t = (y ^ (y >> 7)) & 0x00aa00aa;
+    y ^= t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000cccc;
+    x ^= t ^ (t << 14);
+    t = (y ^ (y >> 14)) & 0x0000cccc;
+    y ^= t ^ (t << 14);
+    t = (x & 0xf0f0f0f0) | ((y >> 4) & 0x0f0f0f0f);
+    y = ((x << 4) & 0xf0f0f0f0) | (y & 0x0f0f0f0f);
+    x = t;
+
+    // row r of the transpose is bit 7 - r of every pixel
+    out[7] = static_cast<std::uint8_t>(x >> 24);
+    out[6] = static_cast<std::uint8_t>(x >> 16);
+    out[5] = static_cast<std::uint8_t>(x >> 8);
+    out[4] = static_cast<std::uint8_t>(x);
+    out[3] = static_cast<std::uint8_t>(y >> 24);
+    out[2] = static_cast<std::uint8_t>(y >> 16);
+    out[1] = static_cast<std::uint8_t>(y >> 8);
+    out[0] = static_cast<std::uint8_t>(y);
+}
+
+} // anonymous namespace
+
+c2p::Kernel c2p::best()
+{
+#if defined(__amigaos__)
+    static const Kernel kernel = (SysBase->AttnFlags & AFF_68020) ? Kernel::Merge : Kernel::Lookup;
+    return kernel;
+#else
+    return Kernel::Merge;
+#endif
+}
+
+void c2p::convert(Kernel kernel, const std::uint8_t* chunky, std::uint32_t chunkyStride, std::uint16_t width,
+                  std::uint16_t height, std::uint8_t* const* planes, std::uint16_t bytesPerRow, std::uint16_t depth)
+{
+    Group group = group_merge;
+    switch (kernel) {
+    case Kernel::Reference:
+        group = group_reference;
+        break;
+    case Kernel::Lookup:
+        group = group_lookup;
+        break;
+    case Kernel::Merge:
+        break;
+    }
+    if (depth > 8) {
+        depth = 8;
+    }
+
+    const std::uint16_t whole = width >> 3;
+    const std::uint16_t rest = width & 7;
+    std::uint8_t out[8];
+    for (std::uint16_t y = 0; y < height; ++y) {
+        const auto in = chunky + y * chunkyStride;
+        const std::uint32_t line = static_cast<std::uint32_t>(y) * bytesPerRow;
+        for (std::uint16_t b = 0; b < whole; ++b) {
+            group(in + b * 8, out);
+            for (std::uint16_t p = 0; p < depth; ++p) {
+                planes[p][line + b] = out[p];
+            }
+        }
+        if (rest) {
+            std::uint8_t tail[8] = {};
+            memcpy(tail, in + whole * 8, rest);
+            group(tail, out);
+            for (std::uint16_t p = 0; p < depth; ++p) {
+                planes[p][line + whole] = out[p];
+            }
+        }
+    }
+}
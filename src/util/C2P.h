@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+namespace trost {
+namespace c2p {
+
+// Chunky to planar, one byte per pixel in and depth bitplanes out. Rows are
+// converted 8 pixels at a time so every plane byte is written whole, a
+// width that isn't a multiple of 8 gets its last byte padded with zeros.
+//
+// Reference shuffles one bit at a time and is only there to check the
+// others against. Lookup spreads each pixel through a table and builds the
+// planes with single bit shifts, which is what a plain 68000 does well
+// since every extra bit of shift costs it two cycles. Merge transposes 8
+// pixels as an 8x8 bit matrix in two 32 bit words with three SWAR merge
+// steps, which wants a barrel shifter.
+enum class Kernel {
+    Reference,
+    Lookup,
+    Merge,
+};
+
+// Merge on a 68020 or better, checked through SysBase->AttnFlags once,
+// Lookup on anything older. Merge everywhere else
+Kernel best();
+
+void convert(Kernel kernel, const std::uint8_t* chunky, std::uint32_t chunkyStride, std::uint16_t width,
+             std::uint16_t height, std::uint8_t* const* planes, std::uint16_t bytesPerRow, std::uint16_t depth);
+
+inline void convert(const std::uint8_t* chunky, std::uint32_t chunkyStride, std::uint16_t width,
+                    std::uint16_t height, std::uint8_t* const* planes, std::uint16_t bytesPerRow, std::uint16_t depth)
+{
+    convert(best(), chunky, chunkyStride, width, height, planes, bytesPerRow, depth);
+}
+
+} // namespace c2p
+} // namespace trost
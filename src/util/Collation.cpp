@@ -0,0 +1,63 @@
+#include "Collation.h"
+#include <cstring>
+
+using namespace trost;
+
+// what 0xc0 to 0xff turn into, both cases fold to the same thing
+static const char* const latin1[64] = {
+    "A", "A", "A", "A", "A", "A", "AE", "C", "E", "E", "E", "E", "I", "I", "I", "I",
+    "D", "N", "O", "O", "O", "O", "O", "\xd7", "O", "U", "U", "U", "U", "Y", "TH", "SS",
+    "A", "A", "A", "A", "A", "A", "AE", "C", "E", "E", "E", "E", "I", "I", "I", "I",
+    "D", "N", "O", "O", "O", "O", "O", "\xf7", "O", "U", "U", "U", "U", "Y", "TH", "Y",
+};
+
+static inline unsigned char upper(unsigned char c)
+{
+    return (c >= 'a' && c <= 'z') ? c - ('a' - 'A') : c;
+}
+
+std::size_t collation::key(const char* text, std::size_t length, char* out, std::size_t size)
+{
+    std::size_t i = 0;
+    while (i < length && text[i] == ' ') {
+        ++i;
+    }
+    // "The X" sorts as X, the article alone stays a name of its own
+    if (length - i > 4 && upper(text[i]) == 'T' && upper(text[i + 1]) == 'H' && upper(text[i + 2]) == 'E'
+        && text[i + 3] == ' ') {
+        i += 4;
+        while (i < length && text[i] == ' ') {
+            ++i;
+        }
+    }
+
+    std::size_t n = 0;
+    for (; i < length && n < size; ++i) {
+        const auto c = static_cast<unsigned char>(text[i]);
+        if (c < 0xc0) {
+            out[n++] = static_cast<char>(upper(c));
+            continue;
+        }
+        for (auto s = latin1[c - 0xc0]; *s && n < size; ++s) {
+            out[n++] = *s;
+        }
+    }
+    return n;
+}
+
+int collation::compare(const char* a, std::size_t alen, const char* b, std::size_t blen)
+{
+    const auto r = memcmp(a, b, alen < blen ? alen : blen);
+    if (r) {
+        return r < 0 ? -1 : 1;
+    }
+    if (alen == blen) {
+        return 0;
+    }
+    return alen < blen ? -1 : 1;
+}
+
+bool collation::hasPrefix(const char* key, std::size_t keyLength, const char* prefix, std::size_t prefixLength)
+{
+    return prefixLength <= keyLength && !memcmp(key, prefix, prefixLength);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+
+namespace trost {
+namespace collation {
+
+// Sort keys for names. A key is the name upper cased with ISO-8859-1
+// accents dropped (letters like ß and Æ become two), leading spaces
+// skipped and a leading "The " moved out of the way so "The Secret of
+// Monkey Island" sorts under S. Keys compare as plain bytes, which is all
+// the index and lookups ever do at run time.
+//
+// The index builder keys every name with this and queries go through it
+// too, so the two always agree.
+
+constexpr std::size_t MaxKeyLength = 255;
+
+// writes the key for text to out, at most size bytes, and returns its
+// length. keys longer than that are cut short
+std::size_t key(const char* text, std::size_t length, char* out, std::size_t size);
+
+// byte order, a key sorts before the ones it's a prefix of
+int compare(const char* a, std::size_t alen, const char* b, std::size_t blen);
+bool hasPrefix(const char* key, std::size_t keyLength, const char* prefix, std::size_t prefixLength);
+
+} // namespace collation
+} // namespace trost
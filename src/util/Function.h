@@ -90,6 +90,11 @@ public:
         destroy();
     }
 
+    explicit operator bool() const
+    {
+        return mInvoker != nullptr;
+    }
+
     // Call the stored callable
     R operator()(Args... args) const
     {
@@ -0,0 +1,65 @@
+#include "Repeater.h"
+
+using namespace trost;
+
+static bool is_due(unsigned long deadline, unsigned long now)
+{
+    return static_cast<long>(now - deadline) >= 0;
+}
+
+void Repeater::configure(const Config& config)
+{
+    mConfig = config;
+    if (mConfig.minInterval == 0) {
+        mConfig.minInterval = 1;
+    }
+    if (mConfig.interval < mConfig.minInterval) {
+        mConfig.interval = mConfig.minInterval;
+    }
+    if (mConfig.acceleration > 100) {
+        mConfig.acceleration = 100;
+    }
+}
+
+void Repeater::press(unsigned long token, unsigned long now)
+{
+    mToken = token;
+    mDeadline = now + mConfig.delay;
+    mInterval = mConfig.interval;
+    mRepeats = 0;
+    mActive = true;
+}
+
+void Repeater::release(unsigned long token)
+{
+    if (mActive && mToken == token) {
+        mActive = false;
+    }
+}
+
+void Repeater::releaseAll()
+{
+    mActive = false;
+}
+
+unsigned long Repeater::remaining(unsigned long now) const
+{
+    return is_due(mDeadline, now) ? 0 : mDeadline - now;
+}
+
+bool Repeater::fire(unsigned long now)
+{
+    if (!mActive || !is_due(mDeadline, now)) {
+        return false;
+    }
+
+    ++mRepeats;
+    mDeadline += mInterval;
+    if (is_due(mDeadline, now)) {
+        mDeadline = now + mInterval;
+    }
+
+    const auto next = mInterval - mInterval * mConfig.acceleration / 100;
+    mInterval = next < mConfig.minInterval ? mConfig.minInterval : next;
+    return true;
+}
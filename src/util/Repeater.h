@@ -0,0 +1,52 @@
+#pragma once
+
+namespace trost {
+
+// Auto-repeat state for one held input. The clock is passed in by the
+// caller in milliseconds, wrapping is fine as long as deadlines are less
+// than ~24 days out. The first repeat comes after delay, after that the
+// interval shrinks by acceleration percent per repeat down to minInterval.
+class Repeater
+{
+public:
+    struct Config
+    {
+        unsigned long delay = 400;
+        unsigned long interval = 150;
+        unsigned long minInterval = 30;
+        unsigned int acceleration = 10;
+    };
+
+    Repeater() = default;
+
+    void configure(const Config& config);
+    const Config& config() const { return mConfig; }
+
+    // starts repeating token, replacing whatever was held before
+    void press(unsigned long token, unsigned long now);
+    // stops repeating if token is the one being held
+    void release(unsigned long token);
+    void releaseAll();
+
+    bool active() const { return mActive; }
+    unsigned long token() const { return mToken; }
+    unsigned long deadline() const { return mDeadline; }
+    unsigned long repeats() const { return mRepeats; }
+
+    // milliseconds until the next repeat is due, 0 if overdue
+    unsigned long remaining(unsigned long now) const;
+
+    // returns true and moves on to the next deadline if a repeat is due.
+    // repeats missed by a late caller are dropped rather than bunched up
+    bool fire(unsigned long now);
+
+private:
+    Config mConfig;
+    unsigned long mToken = 0;
+    unsigned long mDeadline = 0;
+    unsigned long mInterval = 0;
+    unsigned long mRepeats = 0;
+    bool mActive = false;
+};
+
+} // namespace trost
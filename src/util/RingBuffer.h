@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#if !defined(__amigaos__)
+#include <atomic>
+#endif
+
+namespace trost {
+
+// Single producer, single consumer queue with a fixed power of two size.
+// The producer may run at interrupt level or on another thread, push and
+// pop never block and never allocate. When full, push drops the value and
+// counts it in dropped().
+template<typename T, std::size_t Size>
+class RingBuffer {
+public:
+    static_assert(Size > 0 && (Size & (Size - 1)) == 0, "Size must be a power of two");
+
+    RingBuffer() = default;
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    // producer side
+    bool push(const T& value)
+    {
+        const std::size_t head = mHead;
+        if (head - mTail == Size) {
+            ++mDropped;
+            return false;
+        }
+        mData[head & (Size - 1)] = value;
+        barrier();
+        mHead = head + 1;
+        return true;
+    }
+
+    // consumer side
+    bool pop(T* value)
+    {
+        const std::size_t tail = mTail;
+        if (tail == mHead) {
+            return false;
+        }
+        barrier();
+        *value = mData[tail & (Size - 1)];
+        barrier();
+        mTail = tail + 1;
+        return true;
+    }
+
+    bool empty() const { return mTail == mHead; }
+    std::size_t size() const { return mHead - mTail; }
+    std::size_t dropped() const { return mDropped; }
+
+private:
+    // on the Amiga there's a single CPU and the producer is an interrupt,
+    // so volatile counters plus a compiler barrier are enough. elsewhere
+    // the producer is a thread and the counters have to be atomics
+#if defined(__amigaos__)
+    using Counter = volatile std::size_t;
+
+    static void barrier()
+    {
+        __asm__ __volatile__("" ::: "memory");
+    }
+#else
+    using Counter = std::atomic<std::size_t>;
+
+    static void barrier()
+    {
+    }
+#endif
+
+    T mData[Size];
+    // free running, only the producer writes head and only the consumer
+    // writes tail
+    Counter mHead { 0 };
+    Counter mTail { 0 };
+    Counter mDropped { 0 };
+};
+
+} // namespace trost
@@ -46,13 +46,18 @@ public:
     SharedPtr& operator=(const SharedPtr& other)
     {
         if (this != &other) {
-            release();
-            mPtr = other.mPtr;
-            mRefCount = other.mRefCount;
-            mDeleter = other.mDeleter;
-            if (mRefCount) {
-                ++(*mRefCount);
+            // other may live inside what we're releasing, as in
+            // p = p->next, so take everything from it first
+            auto ptr = other.mPtr;
+            auto refCount = other.mRefCount;
+            auto deleter = other.mDeleter;
+            if (refCount) {
+                ++(*refCount);
             }
+            release();
+            mPtr = ptr;
+            mRefCount = refCount;
+            mDeleter = deleter;
         }
         return *this;
     }
@@ -60,13 +65,16 @@ public:
     SharedPtr& operator=(SharedPtr&& other) noexcept
     {
         if (this != &other) {
-            release();
-            mPtr = other.mPtr;
-            mRefCount = other.mRefCount;
-            mDeleter = other.mDeleter;
+            auto ptr = other.mPtr;
+            auto refCount = other.mRefCount;
+            auto deleter = other.mDeleter;
             other.mPtr = nullptr;
             other.mRefCount = nullptr;
             other.mDeleter = nullptr;
+            release();
+            mPtr = ptr;
+            mRefCount = refCount;
+            mDeleter = deleter;
         }
         return *this;
     }
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "Vector.h"
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace trost {
+
+// Values are stored densely for iteration and addressed through handles
+// that pack a 16 bit slot index with a 16 bit generation. Insert, erase
+// and lookup are O(1) and a handle to an erased value never resolves
+// again, even after its slot has been reused. Handles are never 0, which
+// insert() returns once all 0xffff slots are live.
+template<typename T>
+class SlotMap {
+public:
+    using Handle = std::uint32_t;
+
+    SlotMap() = default;
+
+    Handle insert(T&& value)
+    {
+        std::uint16_t slot;
+        if (mFreeHead != NoSlot) {
+            slot = mFreeHead;
+            mFreeHead = mSlots[slot].index;
+        } else if (mSlots.size() < NoSlot) {
+            slot = static_cast<std::uint16_t>(mSlots.size());
+            mSlots.push_back({ 0, 0 });
+        } else {
+            // NoSlot itself can't be a slot, it ends the free list
+            return 0;
+        }
+
+        // odd generations are live, even ones are free, so a live
+        // handle is never 0
+        auto& s = mSlots[slot];
+        ++s.generation;
+        s.index = static_cast<std::uint16_t>(mValues.size());
+
+        mValues.push_back(std::move(value));
+        mDenseToSlot.push_back(slot);
+        return makeHandle(slot, s.generation);
+    }
+
+    // moves the last value into the hole, changes iteration order
+    bool erase(Handle handle)
+    {
+        const auto slot = findSlot(handle);
+        if (slot == NoSlot) {
+            return false;
+        }
+
+        const auto index = mSlots[slot].index;
+        const auto last = mValues.size() - 1;
+        if (index != last) {
+            mValues[index] = std::move(mValues[last]);
+            mDenseToSlot[index] = mDenseToSlot[last];
+            mSlots[mDenseToSlot[index]].index = index;
+        }
+        mValues.pop_back();
+        mDenseToSlot.pop_back();
+
+        release(slot);
+        return true;
+    }
+
+    // keeps iteration order, O(n) in the number of values after the
+    // erased one
+    bool eraseOrdered(Handle handle)
+    {
+        const auto slot = findSlot(handle);
+        if (slot == NoSlot) {
+            return false;
+        }
+
+        const std::size_t index = mSlots[slot].index;
+        mValues.remove_at(index);
+        mDenseToSlot.remove_at(index);
+        const auto sz = mDenseToSlot.size();
+        for (std::size_t i = index; i < sz; ++i) {
+            mSlots[mDenseToSlot[i]].index = static_cast<std::uint16_t>(i);
+        }
+
+        release(slot);
+        return true;
+    }
+
+    T* get(Handle handle)
+    {
+        const auto slot = findSlot(handle);
+        return slot == NoSlot ? nullptr : &mValues[mSlots[slot].index];
+    }
+
+    const T* get(Handle handle) const
+    {
+        const auto slot = findSlot(handle);
+        return slot == NoSlot ? nullptr : &mValues[mSlots[slot].index];
+    }
+
+    bool contains(Handle handle) const
+    {
+        return findSlot(handle) != NoSlot;
+    }
+
+    // dense access, index is in [0, size())
+    T& operator[](std::size_t index)
+    {
+        return mValues[index];
+    }
+
+    const T& operator[](std::size_t index) const
+    {
+        return mValues[index];
+    }
+
+    Handle handleAt(std::size_t index) const
+    {
+        const auto slot = mDenseToSlot[index];
+        return makeHandle(slot, mSlots[slot].generation);
+    }
+
+    std::size_t size() const { return mValues.size(); }
+
+private:
+    struct Slot
+    {
+        std::uint16_t generation;
+        // dense index when live, next free slot when free
+        std::uint16_t index;
+    };
+
+    static constexpr std::uint16_t NoSlot = 0xffff;
+
+    Vector<T> mValues;
+    Vector<std::uint16_t> mDenseToSlot;
+    Vector<Slot> mSlots;
+    std::uint16_t mFreeHead = NoSlot;
+
+    static Handle makeHandle(std::uint16_t slot, std::uint16_t generation)
+    {
+        return (static_cast<Handle>(generation) << 16) | slot;
+    }
+
+    std::uint16_t findSlot(Handle handle) const
+    {
+        const auto slot = static_cast<std::uint16_t>(handle & 0xffff);
+        const auto generation = static_cast<std::uint16_t>(handle >> 16);
+        if (slot >= mSlots.size() || (generation & 1) == 0 || mSlots[slot].generation != generation) {
+            return NoSlot;
+        }
+        return slot;
+    }
+
+    void release(std::uint16_t slot)
+    {
+        auto& s = mSlots[slot];
+        ++s.generation;
+        s.index = mFreeHead;
+        mFreeHead = slot;
+    }
+};
+
+} // namespace trost
@@ -0,0 +1,155 @@
+#include "TimerQueue.h"
+
+using namespace trost;
+
+// deadlines wrap, compare by distance
+static bool is_before(unsigned long a, unsigned long b)
+{
+    return static_cast<long>(a - b) < 0;
+}
+
+TimerQueue::Handle TimerQueue::add(unsigned long now, unsigned long delay, unsigned long interval, Function<void()>&& callback)
+{
+    const auto deadline = now + delay;
+    const auto handle = mTimers.insert({ std::move(callback), deadline, interval, false });
+    if (handle) {
+        push({ deadline, handle });
+    }
+    return handle;
+}
+
+bool TimerQueue::remove(Handle handle)
+{
+    if (handle == mFiring) {
+        // still running, fire() erases it once the callback returns
+        auto timer = mTimers.get(handle);
+        if (!timer || timer->removed) {
+            return false;
+        }
+        timer->removed = true;
+        return true;
+    }
+    return mTimers.erase(handle);
+}
+
+bool TimerQueue::empty()
+{
+    prune();
+    return mHeap.size() == 0;
+}
+
+unsigned long TimerQueue::nextDeadline()
+{
+    prune();
+    return mHeap.front().deadline;
+}
+
+unsigned int TimerQueue::fire(unsigned long now)
+{
+    // collect first so timers added by callbacks, even with a zero
+    // delay, wait for the next round
+    Vector<Handle> due;
+    for (;;) {
+        prune();
+        if (mHeap.size() == 0 || is_before(now, mHeap.front().deadline)) {
+            break;
+        }
+        due.push_back(mHeap.front().handle);
+        pop();
+    }
+
+    unsigned int fired = 0;
+    const auto sz = due.size();
+    for (std::size_t i = 0; i < sz; ++i) {
+        const auto handle = due[i];
+        // an earlier callback may have removed this one
+        auto timer = mTimers.get(handle);
+        if (!timer || timer->removed) {
+            continue;
+        }
+
+        if (timer->interval == 0) {
+            // one-shot, take the callback out so it can add timers freely
+            auto callback = std::move(timer->callback);
+            mTimers.erase(handle);
+            callback();
+        } else {
+            // periodic, missed periods are dropped
+            timer->deadline += timer->interval;
+            if (!is_before(now, timer->deadline)) {
+                timer->deadline = now + timer->interval;
+            }
+            push({ timer->deadline, handle });
+
+            mFiring = handle;
+            timer->callback();
+            mFiring = 0;
+
+            // the callback may have added timers and moved things around
+            timer = mTimers.get(handle);
+            if (timer && timer->removed) {
+                mTimers.erase(handle);
+            }
+        }
+        ++fired;
+    }
+
+    return fired;
+}
+
+void TimerQueue::prune()
+{
+    // drop entries for timers that are gone or have moved on
+    while (mHeap.size() > 0) {
+        const auto& top = mHeap.front();
+        auto timer = mTimers.get(top.handle);
+        if (timer && !timer->removed && timer->deadline == top.deadline) {
+            return;
+        }
+        pop();
+    }
+}
+
+void TimerQueue::push(const HeapEntry& entry)
+{
+    mHeap.push_back(entry);
+    auto index = mHeap.size() - 1;
+    while (index > 0) {
+        const auto parent = (index - 1) / 2;
+        if (!is_before(mHeap[index].deadline, mHeap[parent].deadline)) {
+            break;
+        }
+        const auto tmp = mHeap[index];
+        mHeap[index] = mHeap[parent];
+        mHeap[parent] = tmp;
+        index = parent;
+    }
+}
+
+void TimerQueue::pop()
+{
+    const auto last = mHeap.size() - 1;
+    mHeap[0] = mHeap[last];
+    mHeap.pop_back();
+
+    const auto sz = mHeap.size();
+    std::size_t index = 0;
+    for (;;) {
+        const auto left = index * 2 + 1;
+        const auto right = left + 1;
+        auto smallest = index;
+        if (left < sz && is_before(mHeap[left].deadline, mHeap[smallest].deadline)) {
+            smallest = left;
+        }
+        if (right < sz && is_before(mHeap[right].deadline, mHeap[smallest].deadline)) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            break;
+        }
+        const auto tmp = mHeap[index];
+        mHeap[index] = mHeap[smallest];
+        mHeap[smallest] = tmp;
+        index = smallest;
+    }
+}
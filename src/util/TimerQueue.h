@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Function.h"
+#include "SlotMap.h"
+#include "Vector.h"
+
+namespace trost {
+
+// One-shot and periodic callbacks ordered by deadline in a binary min-heap.
+// The queue has no clock of its own, the caller passes the current time in
+// milliseconds so the same code runs against timer.device or a simulated
+// clock. Cancelled and rescheduled timers leave stale heap entries behind
+// that are skipped when they reach the top.
+class TimerQueue
+{
+public:
+    using Handle = SlotMap<int>::Handle;
+
+    TimerQueue() = default;
+
+    // interval 0 makes a one-shot timer, 0 if there's no room for another
+    Handle add(unsigned long now, unsigned long delay, unsigned long interval, Function<void()>&& callback);
+    // safe to call from inside a callback, including for the timer that
+    // is currently firing
+    bool remove(Handle handle);
+
+    bool empty();
+    // only meaningful if the queue isn't empty
+    unsigned long nextDeadline();
+
+    // runs every callback that is due at now, timers added by callbacks
+    // wait for the next call. returns the number of callbacks run
+    unsigned int fire(unsigned long now);
+
+private:
+    struct Timer
+    {
+        Function<void()> callback;
+        unsigned long deadline;
+        unsigned long interval;
+        bool removed;
+    };
+
+    struct HeapEntry
+    {
+        unsigned long deadline;
+        Handle handle;
+    };
+
+    void push(const HeapEntry& entry);
+    void pop();
+    void prune();
+
+    SlotMap<Timer> mTimers;
+    Vector<HeapEntry> mHeap;
+    Handle mFiring = 0;
+};
+
+} // namespace trost
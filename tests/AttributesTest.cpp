@@ -0,0 +1,94 @@
+#include "TestDB.h"
+
+using namespace trost;
+
+static const char* Dir = "attributes.db";
+static constexpr int Count = 3000;
+
+// what entry i has, worked out again to check the sets against
+static int year(int i)
+{
+    return 1980 + i % 17;
+}
+
+static int publisher(int i)
+{
+    // one in 500 is by a rare one, so some sets come out as deltas
+    return i % 500 ? i % 3 : 3 + i / 500;
+}
+
+static void write_attributed_games()
+{
+    mkdir(Dir, 0755);
+    char path[256];
+    snprintf(path, sizeof(path), "%s/games.txt", Dir);
+    auto games = fopen(path, "w");
+    CHECK(games);
+    for (int i = 0; i < Count; ++i) {
+        // the same value spelled differently is one set, named after the
+        // first entry that has it, and listing a pair twice counts once
+        fprintf(games, "Game %04d\tdh0:games/%04d\t\tyear=%d; publisher=%s%d; serial=%d; year=%d\n", i, i, year(i),
+                i % 2 ? "Studio " : "studio ", publisher(i), i, year(i));
+    }
+    fclose(games);
+}
+
+int main()
+{
+    write_attributed_games();
+    DB db { String(Dir) };
+    DB::IndexOptions options;
+    // small enough that the pairs go through several runs
+    options.sortBudget = 4096;
+    options.orders = "";
+    CHECK(db.createIndex(options));
+    CHECK(db.entryCount() == Count);
+
+    int years = 0;
+    db.values("year", [&years](const char*, std::uint32_t members) -> void {
+        CHECK(members == Count / 17 || members == Count / 17 + 1);
+        ++years;
+    });
+    CHECK(years == 17);
+
+    int publishers = 0;
+    db.values("publisher", [&publishers](const char* value, std::uint32_t) -> void {
+        const int p = atoi(value + 7);
+        int first = 0;
+        while (publisher(first) != p) {
+            ++first;
+        }
+        CHECK(!strncmp(value, first % 2 ? "Studio " : "studio ", 7));
+        ++publishers;
+    });
+    CHECK(publishers == 3 + Count / 500);
+
+    int serials = 0;
+    db.values("serial", [&serials](const char*, std::uint32_t members) -> void {
+        CHECK(members == 1);
+        ++serials;
+    });
+    CHECK(serials == Count);
+
+    EntrySet set;
+    char value[32];
+    for (int y = 1980; y < 1997; ++y) {
+        snprintf(value, sizeof(value), "%d", y);
+        CHECK(db.select("year", value, &set));
+        for (int i = 0; i < Count; ++i) {
+            CHECK(set.contains(static_cast<std::uint32_t>(i)) == (year(i) == y));
+        }
+    }
+    for (int p = 0; p < 3 + Count / 500; ++p) {
+        snprintf(value, sizeof(value), "STUDIO %d", p);
+        CHECK(db.select("publisher", value, &set));
+        for (int i = 0; i < Count; ++i) {
+            CHECK(set.contains(static_cast<std::uint32_t>(i)) == (publisher(i) == p));
+        }
+    }
+    CHECK(db.select("serial", "1234", &set));
+    CHECK(set.count() == 1 && set.contains(1234));
+    CHECK(!db.select("year", "2050", &set));
+    CHECK(set.size() == Count && set.count() == 0);
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include "Test.h"
+#include "util/C2P.h"
+#include <cstdint>
+#include <cstring>
+
+using namespace trost;
+
+static const std::uint8_t Untouched = 0xa5;
+
+static std::uint32_t state = 1;
+
+static std::uint8_t random_byte()
+{
+    state = state * 1103515245 + 12345;
+    return static_cast<std::uint8_t>(state >> 16);
+}
+
+// converts with kernel and checks every bit against the pixels, and that
+// nothing past the row's bytes or the depth's planes is written
+static void check(c2p::Kernel kernel, std::uint16_t width, std::uint16_t height, std::uint16_t depth)
+{
+    const std::uint32_t stride = width + 3;
+    const std::uint16_t bytesPerRow = ((width + 15) >> 4) * 2 + 2;
+    std::uint8_t chunky[80 * 6];
+    std::uint8_t storage[8][16 * 6];
+    std::uint8_t* planes[8];
+    for (std::uint32_t i = 0; i < stride * height; ++i) {
+        chunky[i] = random_byte();
+    }
+    for (int p = 0; p < 8; ++p) {
+        memset(storage[p], Untouched, sizeof(storage[p]));
+        planes[p] = storage[p];
+    }
+
+    c2p::convert(kernel, chunky, stride, width, height, planes, bytesPerRow, depth);
+
+    const std::uint16_t used = (width + 7) >> 3;
+    for (std::uint16_t p = 0; p < 8; ++p) {
+        for (std::uint16_t y = 0; y < height; ++y) {
+            const auto row = planes[p] + y * bytesPerRow;
+            for (std::uint16_t b = 0; b < bytesPerRow; ++b) {
+                if (p >= depth || b >= used) {
+                    CHECK(row[b] == Untouched);
+                    continue;
+                }
+                for (std::uint16_t bit = 0; bit < 8; ++bit) {
+                    const std::uint16_t x = b * 8 + bit;
+                    // padding pixels come out as zero
+                    const int want = x < width ? (chunky[y * stride + x] >> p) & 1 : 0;
+                    CHECK(((row[b] >> (7 - bit)) & 1) == want);
+                }
+            }
+        }
+    }
+}
+
+int main()
+{
+    static const c2p::Kernel kernels[] = { c2p::Kernel::Reference, c2p::Kernel::Lookup, c2p::Kernel::Merge };
+    static const std::uint16_t widths[] = { 1, 7, 8, 9, 16, 23, 64, 77 };
+    for (auto kernel : kernels) {
+        for (auto width : widths) {
+            for (std::uint16_t depth = 1; depth <= 8; ++depth) {
+                check(kernel, width, 5, depth);
+            }
+        }
+        // every value in every position of a group
+        std::uint8_t chunky[256 * 8];
+        std::uint8_t storage[8][256];
+        std::uint8_t* planes[8];
+        for (int i = 0; i < 256 * 8; ++i) {
+            chunky[i] = static_cast<std::uint8_t>((i / 8 + i * 37) & 0xff);
+        }
+        for (int p = 0; p < 8; ++p) {
+            planes[p] = storage[p];
+        }
+        c2p::convert(kernel, chunky, 256 * 8, 256 * 8, 1, planes, 256, 8);
+        for (int x = 0; x < 256 * 8; ++x) {
+            for (int p = 0; p < 8; ++p) {
+                CHECK(((storage[p][x >> 3] >> (7 - (x & 7))) & 1) == ((chunky[x] >> p) & 1));
+            }
+        }
+    }
+    // and whatever convert() picks without being told
+    check(c2p::best(), 13, 2, 5);
+    return 0;
+}
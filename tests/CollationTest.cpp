@@ -0,0 +1,104 @@
+#include "Test.h"
+#include "util/Collation.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace trost;
+
+static bool key_is(const char* text, const char* want)
+{
+    char key[collation::MaxKeyLength];
+    const auto length = collation::key(text, strlen(text), key, sizeof(key));
+    return length == strlen(want) && !memcmp(key, want, length);
+}
+
+static int compare_names(const char* a, const char* b)
+{
+    char ka[collation::MaxKeyLength], kb[collation::MaxKeyLength];
+    const auto la = collation::key(a, strlen(a), ka, sizeof(ka));
+    const auto lb = collation::key(b, strlen(b), kb, sizeof(kb));
+    return collation::compare(ka, la, kb, lb);
+}
+
+int main()
+{
+    // case, leading spaces and the article
+    CHECK(key_is("Lemmings", "LEMMINGS"));
+    CHECK(key_is("   Lemmings", "LEMMINGS"));
+    CHECK(key_is("The Secret of Monkey Island", "SECRET OF MONKEY ISLAND"));
+    CHECK(key_is("  the   Addams Family", "ADDAMS FAMILY"));
+    CHECK(key_is("THE CHAOS ENGINE", "CHAOS ENGINE"));
+    CHECK(key_is("The", "THE"));
+    CHECK(key_is("The ", "THE "));
+    CHECK(key_is("Theme Park", "THEME PARK"));
+    CHECK(key_is("Then", "THEN"));
+    CHECK(key_is("", ""));
+
+    // ISO-8859-1 letters fold to plain ones in both cases, some become two
+    CHECK(key_is("\xc9lite", "ELITE"));
+    CHECK(key_is("\xe9lite", "ELITE"));
+    CHECK(key_is("Stra\xdf" "e", "STRASSE"));
+    CHECK(key_is("\xc6on \xe6on", "AEON AEON"));
+    CHECK(key_is("\xde\xfe", "THTH"));
+    CHECK(key_is("\xff\xd1\xf1", "YNN"));
+    // the signs in the middle of the letters stay what they are
+    CHECK(key_is("2\xd7" "3\xf7", "2\xd7" "3\xf7"));
+    // and everything below them is only upper cased
+    CHECK(key_is("R-Type (1988) \xa9", "R-TYPE (1988) \xa9"));
+
+    // keys are cut short at size, even in the middle of a letter that
+    // becomes two
+    char key[4];
+    CHECK(collation::key("Abcdef", 6, key, sizeof(key)) == 4 && !memcmp(key, "ABCD", 4));
+    CHECK(collation::key("ab\xdf\xdf", 4, key, 3) == 3 && !memcmp(key, "ABS", 3));
+
+    // byte order with prefixes first, high bytes after ASCII
+    CHECK(collation::compare("ABC", 3, "ABC", 3) == 0);
+    CHECK(collation::compare("AB", 2, "ABC", 3) < 0);
+    CHECK(collation::compare("ABC", 3, "AB", 2) > 0);
+    CHECK(collation::compare("ABD", 3, "ABCZ", 4) > 0);
+    CHECK(collation::compare("Z", 1, "\xd7", 1) < 0);
+    CHECK(collation::compare("", 0, "A", 1) < 0);
+    CHECK(collation::compare("", 0, "", 0) == 0);
+
+    CHECK(collation::hasPrefix("LEMMINGS", 8, "LEMM", 4));
+    CHECK(collation::hasPrefix("LEMMINGS", 8, "LEMMINGS", 8));
+    CHECK(collation::hasPrefix("LEMMINGS", 8, "", 0));
+    CHECK(!collation::hasPrefix("LEMMINGS", 8, "LEMMINGS 2", 10));
+    CHECK(!collation::hasPrefix("LEMMINGS", 8, "LEMN", 4));
+
+    // names in the order the index has them
+    CHECK(compare_names("\xc9lite", "elite") == 0);
+    CHECK(compare_names("The Lemmings", "Lemmings") == 0);
+    const char* names[] = {
+        "Zool",
+        "Secret of Monkey Island 2",
+        "The Secret of Monkey Island",
+        "\xc9lite",
+        "  Another World",
+        "alien breed",
+        "The Addams Family",
+        "Theme Park",
+        "Stra\xdf" "enfeger",
+        "Strasse",
+    };
+    std::sort(names, names + sizeof(names) / sizeof(names[0]), [](const char* a, const char* b) -> bool {
+        return compare_names(a, b) < 0;
+    });
+    static const char* const sorted[] = {
+        "The Addams Family",
+        "alien breed",
+        "  Another World",
+        "\xc9lite",
+        "The Secret of Monkey Island",
+        "Secret of Monkey Island 2",
+        "Strasse",
+        "Stra\xdf" "enfeger",
+        "Theme Park",
+        "Zool",
+    };
+    for (std::size_t i = 0; i < sizeof(sorted) / sizeof(sorted[0]); ++i) {
+        CHECK(!strcmp(names[i], sorted[i]));
+    }
+    return 0;
+}
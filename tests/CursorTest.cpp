@@ -0,0 +1,104 @@
+#include "TestDB.h"
+#include "db/Cursor.h"
+
+using namespace trost;
+
+static const char* Dir = "cursor.db";
+
+static void check_window(const Cursor& cursor)
+{
+    for (std::uint32_t i = 0; i < static_cast<std::uint32_t>(cursor.window()) && cursor.position() + i < cursor.size(); ++i) {
+        const auto entry = cursor.at(cursor.position() + i);
+        CHECK(entry);
+        CHECK(entry->id == cursor.position() + i);
+    }
+}
+
+// hydrate and dispose count, an entry goes when the last hold does
+static void holds(DB& db)
+{
+    db.hydrate(10, 2, false);
+    const auto entry = db.entry(10);
+    CHECK(entry);
+    db.hydrateIds(&entry->id, 1, false);
+    db.dispose(10, 2);
+    CHECK(db.entry(10) == entry);
+    CHECK(!db.entry(11));
+    db.dispose(10, 1);
+    CHECK(!db.entry(10));
+    // nothing left to let go of
+    db.dispose(10, 1);
+
+    const auto id = db.exact(String("Game 042"));
+    CHECK(id == 42);
+    db.hydrate(42, 1);
+    db.dispose(42, 1);
+    CHECK(db.entry(42) && !strcmp(db.entry(42)->name.c_str(), "Game 042"));
+    db.dispose(42, 1);
+    CHECK(!db.entry(42));
+}
+
+// the cursor disposing its window leaves alone what others still hold
+static void shared(DB& db)
+{
+    const auto id = db.exact(String("Game 003"));
+    db.hydrate(20, 4);
+    {
+        Cursor cursor(&db, 8);
+        CHECK(cursor.start(0));
+        check_window(cursor);
+        CHECK(live(db) == 12);
+        cursor.seek(30);
+        check_window(cursor);
+        CHECK(db.entry(id) && db.entry(20) && db.entry(23));
+        CHECK(live(db) == 13);
+    }
+    CHECK(live(db) == 5);
+    db.dispose(id, 1);
+    db.dispose(20, 4);
+    CHECK(live(db) == 0);
+}
+
+// scrolling while loads are in flight holds exactly the window
+static void async(DB& db)
+{
+    const auto id = db.exact(String("Game 005"));
+    {
+        Cursor cursor(&db, 8);
+        int changed = 0;
+        cursor.setAsync([&changed]() -> void {
+            ++changed;
+        });
+        CHECK(cursor.start(0));
+        for (int i = 0; i < 60; ++i) {
+            cursor.scroll(i % 3 ? 2 : -1);
+            if (i % 5 == 0) {
+                drain(db);
+            }
+        }
+        drain(db);
+        CHECK(changed > 0);
+        CHECK(!cursor.isLoading());
+        check_window(cursor);
+        CHECK(live(db) == 9);
+        cursor.seek(0);
+        cursor.reset();
+        drain(db);
+    }
+    CHECK(live(db) == 1);
+    db.dispose(id, 1);
+    CHECK(live(db) == 0);
+}
+
+int main()
+{
+    write_games(Dir, 200, false);
+    DB db { String(Dir) };
+    CHECK(db.createIndex());
+    CHECK(db.entryCount() == 200);
+
+    holds(db);
+    shared(db);
+    async(db);
+    return 0;
+}
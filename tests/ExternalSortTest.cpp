@@ -0,0 +1,122 @@
+#include "Test.h"
+#include "db/ExternalSort.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+using namespace trost;
+
+static const char* Dir = "externalsort.db";
+static constexpr std::uint32_t MaxRecord = 32;
+static constexpr int Count = 5000;
+
+static int compare_records(const std::uint8_t* a, std::uint32_t alength, const std::uint8_t* b, std::uint32_t blength)
+{
+    const auto r = memcmp(a, b, alength < blength ? alength : blength);
+    if (r) {
+        return r;
+    }
+    return alength == blength ? 0 : (alength < blength ? -1 : 1);
+}
+
+// records of 1 to MaxRecord bytes from a few letters, so many share a
+// prefix and some come up more than once
+static std::vector<std::string> make_records()
+{
+    std::uint32_t state = 7;
+    std::vector<std::string> records;
+    for (int i = 0; i < Count; ++i) {
+        state = state * 1103515245 + 12345;
+        const auto length = 1 + (state >> 16) % MaxRecord;
+        std::string record;
+        for (std::uint32_t j = 0; j < length; ++j) {
+            state = state * 1103515245 + 12345;
+            record.push_back(static_cast<char>('a' + (state >> 16) % 4));
+        }
+        records.push_back(record);
+    }
+    return records;
+}
+
+static bool exists(const char* name, std::uint32_t run)
+{
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s%u.tmp", Dir, name, run);
+    struct stat st;
+    return !stat(path, &st);
+}
+
+// sorts records within budget, checks the output against sorted and that
+// every temp file is gone afterwards. returns the runs written
+static std::uint32_t sort_with(const std::vector<std::string>& records, const std::vector<std::string>& sorted,
+                               std::uint32_t budget)
+{
+    std::uint32_t runs;
+    {
+        ExternalSort sort(Dir, "sort", budget, MaxRecord, compare_records);
+        for (auto& record : records) {
+            CHECK(sort.add(record.data(), static_cast<std::uint32_t>(record.size())));
+        }
+        CHECK(sort.finish());
+        CHECK(sort.count() == records.size());
+        runs = sort.runs();
+
+        const std::uint8_t* record;
+        std::uint32_t length;
+        std::uint32_t middle = 0;
+        for (std::size_t i = 0; i < sorted.size(); ++i) {
+            if (i == sorted.size() / 2) {
+                middle = sort.position();
+            }
+            CHECK(sort.next(&record, &length));
+            CHECK(length == sorted[i].size() && !memcmp(record, sorted[i].data(), length));
+        }
+        CHECK(!sort.next(&record, &length));
+
+        // and back to a record seen before
+        CHECK(sort.seek(middle));
+        CHECK(sort.next(&record, &length));
+        CHECK(length == sorted[sorted.size() / 2].size() && !memcmp(record, sorted[sorted.size() / 2].data(), length));
+        CHECK(sort.rewind());
+        CHECK(sort.next(&record, &length));
+        CHECK(length == sorted[0].size() && !memcmp(record, sorted[0].data(), length));
+    }
+    // merging writes a run per pass on top of the ones spilled
+    for (std::uint32_t run = 0; run < 2 * runs; ++run) {
+        CHECK(!exists("sort", run));
+    }
+    return runs;
+}
+
+int main()
+{
+    mkdir(Dir, 0755);
+    const auto records = make_records();
+    auto sorted = records;
+    std::sort(sorted.begin(), sorted.end(), [](const std::string& a, const std::string& b) -> bool {
+        return compare_records(reinterpret_cast<const std::uint8_t*>(a.data()), static_cast<std::uint32_t>(a.size()),
+                               reinterpret_cast<const std::uint8_t*>(b.data()), static_cast<std::uint32_t>(b.size()))
+            < 0;
+    });
+
+    // the smallest budget there is merges two runs at a time, so it takes
+    // many passes
+    CHECK(sort_with(records, sorted, 0) > 16);
+    // a few runs in one or two passes
+    const auto runs = sort_with(records, sorted, 16 * 1024);
+    CHECK(runs > 1 && runs < 16);
+    // everything fits and nothing is written
+    CHECK(sort_with(records, sorted, 1024 * 1024) == 0);
+
+    // too long a record is turned down, and nothing at all still finishes
+    ExternalSort empty(Dir, "empty", 0, MaxRecord, compare_records);
+    char big[MaxRecord + 1] = {};
+    CHECK(!empty.add(big, sizeof(big)));
+    CHECK(empty.finish());
+    const std::uint8_t* record;
+    std::uint32_t length;
+    CHECK(empty.count() == 0 && !empty.next(&record, &length));
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include "TestDB.h"
+#include "util/Collation.h"
+
+using namespace trost;
+
+static const char* Dir = "filter.db";
+static constexpr int Count = 2000;
+
+static const char* const Words[] = {
+    "Alien", "Battle", "Chaos", "Dungeon", "Elite", "Fire", "Ghost", "Hyper", "Island", "Jungle", "Knight", "Lotus",
+};
+static constexpr int WordCount = sizeof(Words) / sizeof(Words[0]);
+
+static char names[Count][64];
+
+int main()
+{
+    const char* list[Count];
+    for (int i = 0; i < Count; ++i) {
+        snprintf(names[i], sizeof(names[i]), "%s %s %d", Words[i % WordCount], Words[(i / WordCount) % WordCount], i);
+        list[i] = names[i];
+    }
+    write_games(Dir, Count, false, list);
+    DB db { String(Dir) };
+    CHECK(db.createIndex());
+
+    // every prefix of every name is there, none may be turned down
+    db.resetFilterStats();
+    for (int i = 0; i < Count; i += 7) {
+        char key[collation::MaxKeyLength];
+        const auto length = collation::key(names[i], strlen(names[i]), key, sizeof(key));
+        for (std::size_t l = 1; l <= length; ++l) {
+            CHECK(db.find(key, l) != DB::NoEntry);
+        }
+        const auto id = db.exact(String(names[i]));
+        CHECK(id != DB::NoEntry && !strcmp(db.entry(id)->name.c_str(), names[i]));
+        db.dispose(id, 1);
+    }
+    CHECK(db.filterStats().rejected == 0 && db.filterStats().falsePositives == 0);
+    CHECK(live(db) == 0);
+
+    // misses under letters that have names and ones that don't. each is
+    // either turned down or gets past the filter and is counted for it
+    std::uint32_t misses = 0;
+    for (int i = 0; i < Count; ++i) {
+        char name[64];
+        snprintf(name, sizeof(name), "%s Zebra %d", Words[i % WordCount], i);
+        CHECK(db.find(String(name)) == DB::NoEntry);
+        CHECK(db.exact(String(name)) == DB::NoEntry);
+        snprintf(name, sizeof(name), "%c%d", 'M' + i % 14, i);
+        CHECK(db.find(String(name)) == DB::NoEntry);
+        misses += 3;
+    }
+    const auto stats = db.filterStats();
+    CHECK(stats.rejected + stats.falsePositives == misses);
+    // sized for 20 per thousand, leave room for the luck of the draw
+    CHECK(stats.falsePositives * 1000 < misses * 60);
+    CHECK(live(db) == 0);
+
+    // without filters nothing is turned down or counted
+    DB::IndexOptions options;
+    options.filterPerMille = 0;
+    CHECK(db.createIndex(options));
+    db.resetFilterStats();
+    CHECK(db.find(String("Alien Zebra")) == DB::NoEntry);
+    CHECK(db.exact(String("Alien Zebra")) == DB::NoEntry);
+    CHECK(db.find(String("Alien Alien")) == 0);
+    CHECK(db.filterStats().rejected == 0 && db.filterStats().falsePositives == 0);
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include "TestDB.h"
+#include "db/Format.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace trost;
+
+static const char* Dir = "frontcoding.db";
+
+// upper case ASCII names are their own collation keys, so plain strcmp
+// gives the order the index is in
+static std::vector<std::string> make_names()
+{
+    static const char* const bases[] = {
+        "LEMMINGS", "LEMMINGS 2", "LEMMINGS 2 THE TRIBES", "LOTUS", "LOTUS ESPRIT TURBO CHALLENGE",
+        "LOTUS III", "SECRET OF MONKEY ISLAND", "SECRET OF MONKEY ISLAND 2", "TURRICAN", "TURRICAN II",
+    };
+    std::vector<std::string> names;
+    for (auto base : bases) {
+        names.push_back(base);
+        for (int i = 0; i < 23; ++i) {
+            char suffix[32];
+            snprintf(suffix, sizeof(suffix), " %c%d", 'A' + i % 5, i * 7);
+            names.push_back(std::string(base) + suffix);
+        }
+    }
+    // a name as long as they get and one that stops short of it, so whole
+    // entries and long shared prefixes both show up
+    const std::string longest(format::MaxNameLength, 'Z');
+    names.push_back(longest);
+    names.push_back(longest.substr(0, 200));
+    // the same name twice, find() gives the first
+    names.push_back("LOTUS");
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+static DB::Id first_with_prefix(const std::vector<std::string>& names, const std::string& prefix)
+{
+    for (std::size_t i = 0; i < names.size(); ++i) {
+        if (!names[i].compare(0, prefix.size(), prefix)) {
+            return static_cast<DB::Id>(i);
+        }
+    }
+    return DB::NoEntry;
+}
+
+// encodeName() every name after the one before it with a restart every
+// interval, then read them all back
+static void round_trip(const std::vector<std::string>& names, std::uint32_t interval)
+{
+    char path[256];
+    snprintf(path, sizeof(path), "%s/names.bin", Dir);
+    std::vector<std::uint32_t> restarts;
+    {
+        File file;
+        CHECK(file.open(path, File::Mode::Write));
+        std::uint8_t buffer[512];
+        FileWriter writer(&file, buffer, sizeof(buffer));
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            const bool restart = !(i % interval);
+            if (restart) {
+                restarts.push_back(writer.position());
+            }
+            const auto& previous = restart ? names[i] : names[i - 1];
+            std::uint8_t out[format::MaxNameEntrySize];
+            const auto size = format::encodeName(restart ? nullptr : previous.c_str(),
+                                                 static_cast<std::uint8_t>(previous.size()), names[i].c_str(),
+                                                 static_cast<std::uint8_t>(names[i].size()),
+                                                 static_cast<std::uint32_t>(i * 100), out);
+            CHECK(size <= format::MaxNameEntrySize);
+            CHECK(writer.write(out, size));
+        }
+        CHECK(writer.flush());
+    }
+
+    File file;
+    CHECK(file.open(path, File::Mode::Read));
+    std::uint8_t buffer[64];
+    FileReader reader(&file, buffer, sizeof(buffer));
+    for (std::size_t r = 0; r < restarts.size(); ++r) {
+        format::NameEntry entry;
+        const auto first = r * interval;
+        CHECK(format::readRestartEntry(file, restarts[r], &entry));
+        CHECK(entry.name == names[first] && entry.offset == first * 100);
+        CHECK(reader.seek(restarts[r] + 2 + entry.length + 4));
+        for (auto i = first + 1; i < names.size() && i < first + interval; ++i) {
+            CHECK(format::readName(reader, &entry));
+            CHECK(entry.length == names[i].size());
+            CHECK(entry.name == names[i] && entry.offset == i * 100);
+        }
+    }
+}
+
+int main()
+{
+    const auto names = make_names();
+    std::vector<const char*> list;
+    for (auto& name : names) {
+        list.push_back(name.c_str());
+    }
+    // games.txt doesn't have to be sorted
+    std::reverse(list.begin(), list.end());
+    write_games(Dir, static_cast<int>(list.size()), false, list.data());
+
+    round_trip(names, 1);
+    round_trip(names, 4);
+    round_trip(names, format::LetterInterval);
+
+    DB db { String(Dir) };
+    CHECK(db.createIndex());
+    CHECK(db.entryCount() == names.size());
+
+    // every whole name and every prefix of a few of them, those land on
+    // restart points and in between
+    for (std::size_t i = 0; i < names.size(); ++i) {
+        CHECK(db.find(String(names[i].c_str())) == first_with_prefix(names, names[i]));
+    }
+    static const char* const prefixes[] = {
+        "LEMMINGS 2 THE TRIBES D126", "SECRET OF MONKEY ISLAND 2 C", "TURRICAN II E",
+    };
+    for (auto prefix : prefixes) {
+        const std::string whole(prefix);
+        for (std::size_t length = 1; length <= whole.size(); ++length) {
+            const auto part = whole.substr(0, length);
+            CHECK(db.find(String(part.c_str())) == first_with_prefix(names, part));
+        }
+    }
+    // misses before, between and after the names
+    static const char* const misses[] = { "AAA", "LEMMINGS 3", "LOTUS AZ", "TURRICAN IIX", "ZZZZY" };
+    for (auto miss : misses) {
+        CHECK(first_with_prefix(names, miss) == DB::NoEntry);
+        CHECK(db.find(String(miss)) == DB::NoEntry);
+    }
+
+    // and the records behind the ids are the right ones
+    db.hydrate(0, static_cast<int>(names.size()), false);
+    for (std::size_t i = 0; i < names.size(); ++i) {
+        CHECK(db.entry(i) && names[i] == db.entry(i)->name.c_str());
+    }
+    db.dispose(0, static_cast<int>(names.size()));
+    return 0;
+}
@@ -0,0 +1,206 @@
+#include "TestDB.h"
+#include "db/Format.h"
+#include "db/History.h"
+#include <initializer_list>
+
+using namespace trost;
+
+static const char* Dir = "history.db";
+static constexpr std::uint32_t Entries = 100;
+
+static void path_for(char* out, std::size_t size, const char* suffix)
+{
+    snprintf(out, size, "%s/history%s", Dir, suffix);
+}
+
+static long file_size(const char* suffix)
+{
+    char path[256];
+    path_for(path, sizeof(path), suffix);
+    struct stat st;
+    return stat(path, &st) ? -1 : static_cast<long>(st.st_size);
+}
+
+static long log_size(std::uint32_t records)
+{
+    return format::HistoryHeaderSize + records * format::HistoryRecordSize;
+}
+
+static bool list_is(const std::uint32_t* ids, std::uint32_t count, std::initializer_list<std::uint32_t> want)
+{
+    if (count != want.size()) {
+        return false;
+    }
+    std::uint32_t i = 0;
+    for (auto id : want) {
+        if (ids[i++] != id) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// the lists every state of the log below has to come back with
+static void check_lists(History& history)
+{
+    std::uint32_t ids[8];
+    // 7 last at 300, then 5 and 9 at 200 with 9 played after 5, then 3
+    CHECK(list_is(ids, history.recent(ids, 8), { 7, 9, 5, 3 }));
+    CHECK(list_is(ids, history.recent(ids, 2), { 7, 9 }));
+    // 5 three times, 3 and 9 twice with 9 the more recent, 7 once
+    CHECK(list_is(ids, history.favourites(ids, 8), { 5, 9, 3, 7 }));
+    CHECK(history.stat(5) && history.stat(5)->plays == 3 && history.stat(5)->last == 200);
+    CHECK(!history.stat(4));
+}
+
+static void play_some(History& history)
+{
+    CHECK(history.add(3, 100));
+    CHECK(history.add(5, 100));
+    CHECK(history.add(3, 150));
+    CHECK(history.add(5, 150));
+    CHECK(history.add(5, 200));
+    CHECK(history.add(9, 200));
+    CHECK(history.add(9, 120));
+    CHECK(history.add(7, 300));
+    // past the end of the index
+    CHECK(!history.add(Entries, 400));
+}
+
+static void append(const char* suffix, const void* data, std::uint32_t size)
+{
+    char path[256];
+    path_for(path, sizeof(path), suffix);
+    File file;
+    CHECK(file.open(path, File::Mode::Append) && file.write(data, size));
+}
+
+static void copy_file(const char* from, const char* to)
+{
+    char a[256], b[256];
+    path_for(a, sizeof(a), from);
+    path_for(b, sizeof(b), to);
+    File in, out;
+    CHECK(in.open(a, File::Mode::Read) && out.open(b, File::Mode::Write));
+    std::uint8_t buffer[4096];
+    const auto got = in.read(buffer, sizeof(buffer));
+    CHECK(got >= 0 && out.write(buffer, static_cast<std::uint32_t>(got)));
+}
+
+static void remove_file(const char* suffix)
+{
+    char path[256];
+    path_for(path, sizeof(path), suffix);
+    File::remove(path);
+}
+
+static void history_test()
+{
+    mkdir(Dir, 0755);
+    remove_file(".log");
+    remove_file(".new");
+
+    History history;
+    CHECK(history.open(Dir, Entries));
+    CHECK(file_size(".log") == log_size(0));
+    play_some(history);
+    check_lists(history);
+    CHECK(file_size(".log") == log_size(8));
+
+    // read back as it was
+    CHECK(history.open(Dir, Entries));
+    check_lists(history);
+
+    // a record cut short is dropped and the log compacted to one per entry
+    append(".log", "\0\0\0\x05\0", 5);
+    CHECK(history.open(Dir, Entries));
+    check_lists(history);
+    CHECK(file_size(".log") == log_size(4));
+
+    // a compaction that removed the log but didn't rename the new one
+    copy_file(".log", ".new");
+    remove_file(".log");
+    CHECK(history.open(Dir, Entries));
+    check_lists(history);
+    CHECK(file_size(".new") < 0 && file_size(".log") == log_size(4));
+
+    // one that didn't get as far as removing the log, the log wins and
+    // the half written new one goes
+    append(".new", "TRPL", 4);
+    CHECK(history.open(Dir, Entries));
+    check_lists(history);
+    CHECK(file_size(".new") < 0);
+
+    // something that isn't a log at all starts over
+    remove_file(".log");
+    append(".log", "not a history log", 17);
+    CHECK(history.open(Dir, Entries));
+    CHECK(!history.stats().size() && file_size(".log") == log_size(0));
+
+    // compacted once there are threshold records more than entries played
+    play_some(history);
+    history.setThreshold(6);
+    CHECK(history.open(Dir, Entries));
+    CHECK(history.add(3, 400));
+    CHECK(file_size(".log") == log_size(9));
+    CHECK(history.add(3, 401));
+    CHECK(file_size(".log") == log_size(4));
+    CHECK(history.stat(3)->plays == 4 && history.stat(3)->last == 401);
+
+    // plays past what a record holds take several records, and count
+    // towards the threshold as what's on disk
+    const History::Stat stats[] = {
+        { 2, 50, 70000, 0 },
+        { 8, 60, 1, 1 },
+    };
+    CHECK(History::write(Dir, stats, 2));
+    CHECK(file_size(".log") == log_size(3));
+    history.setThreshold(3);
+    CHECK(history.open(Dir, Entries));
+    CHECK(history.stat(2)->plays == 70000 && history.stat(8)->plays == 1);
+    CHECK(history.compact());
+    CHECK(file_size(".log") == log_size(3));
+    // 3 records for 2 entries, the second add reaches 2 + 3
+    CHECK(history.add(8, 70));
+    CHECK(file_size(".log") == log_size(4));
+    CHECK(history.add(8, 71));
+    CHECK(file_size(".log") == log_size(3));
+    CHECK(history.stat(2)->plays == 70000 && history.stat(8)->plays == 3);
+    std::uint32_t ids[4];
+    CHECK(list_is(ids, history.favourites(ids, 4), { 2, 8 }));
+    CHECK(list_is(ids, history.recent(ids, 4), { 8, 2 }));
+    history.close();
+}
+
+// plays follow the entries by name when the index is rebuilt and the ids
+// move
+static void carry_test()
+{
+    static const char* const before[] = { "Lemmings", "Rick Dangerous", "Speedball 2", "Zool" };
+    static const char* const after[] = { "Alien Breed", "Lemmings", "Speedball 2", "Turrican", "Zool" };
+    const char* dir = "carry.db";
+    write_games(dir, 4, false, before);
+    // nothing from the last run
+    File::remove("carry.db/history.log");
+    DB db { String(dir) };
+    CHECK(db.createIndex());
+    CHECK(db.played(db.exact(String("Zool"))));
+    CHECK(db.played(db.exact(String("Lemmings"))));
+    CHECK(db.played(db.exact(String("Rick Dangerous"))));
+    CHECK(db.played(db.exact(String("Lemmings"))));
+    CHECK(db.played(db.exact(String("Speedball 2"))));
+
+    // Rick Dangerous is gone and two new names move the rest along
+    write_games(dir, 5, false, after);
+    CHECK(db.createIndex());
+    DB::Id ids[8];
+    CHECK(list_is(ids, db.recent(ids, 8), { 2, 1, 4 }));
+    CHECK(list_is(ids, db.favourites(ids, 8), { 1, 2, 4 }));
+}
+
+int main()
+{
+    history_test();
+    carry_test();
+    return 0;
+}
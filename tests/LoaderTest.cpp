@@ -0,0 +1,131 @@
+#include "TestDB.h"
+#include "db/Loader.h"
+
+using namespace trost;
+
+static const char* Dir = "loader.db";
+static const int Count = 12;
+
+// the record offset of every id, straight from ids.idx
+static void read_offsets(std::uint32_t* offsets)
+{
+    char path[256];
+    snprintf(path, sizeof(path), "%s/ids.idx", Dir);
+    File file;
+    CHECK(file.open(path, File::Mode::Read));
+    std::uint8_t header[format::IdsHeaderSize];
+    CHECK(file.readExact(header, sizeof(header)));
+    CHECK(format::get32(header) == format::IdsMagic);
+    CHECK(format::get32(header + 8) == Count);
+    for (int i = 0; i < Count; ++i) {
+        std::uint8_t off[4];
+        CHECK(file.readExact(off, sizeof(off)));
+        offsets[i] = format::get32(off);
+    }
+}
+
+static void finish(Loader& loader)
+{
+    while (loader.pending()) {
+        loader.wait();
+        loader.process();
+    }
+}
+
+int main()
+{
+    write_games(Dir, Count, true);
+    {
+        DB db { String(Dir) };
+        CHECK(db.createIndex());
+    }
+    std::uint32_t offsets[Count];
+    read_offsets(offsets);
+
+    Loader loader;
+    CHECK(loader.start(Dir));
+    CHECK(loader.isRunning());
+
+    // out of order and with a repeat, results come back in job order
+    static const int picks[] = { 7, 0, 11, 3, 7 };
+    const int picked = sizeof(picks) / sizeof(picks[0]);
+    auto job = new Loader::Job(picked, true);
+    for (int i = 0; i < picked; ++i) {
+        job->offsets[i] = offsets[picks[i]];
+    }
+    int done = 0;
+    job->done = [&done](Loader::Job* job) -> void {
+        ++done;
+        CHECK(job->loaded == job->count);
+        for (std::uint16_t i = 0; i < job->count; ++i) {
+            char name[16], path[32];
+            snprintf(name, sizeof(name), "Game %03d", picks[i]);
+            snprintf(path, sizeof(path), "dh0:games/%03d", picks[i]);
+            const auto& result = job->results[i];
+            CHECK(!strcmp(result.record.name, name));
+            CHECK(!strcmp(result.record.path, path));
+            CHECK(result.record.offset == job->offsets[i]);
+            CHECK(result.record.previewLength > 0);
+            CHECK(result.image.isValid());
+        }
+    };
+    loader.submit(job);
+    CHECK(loader.pending() == 1);
+    finish(loader);
+    CHECK(done == 1);
+
+    // records only
+    job = new Loader::Job(2, false);
+    job->offsets[0] = offsets[1];
+    job->offsets[1] = offsets[2];
+    job->done = [&done](Loader::Job* job) -> void {
+        ++done;
+        CHECK(job->loaded == 2);
+        CHECK(!strcmp(job->results[0].record.name, "Game 001"));
+        CHECK(!strcmp(job->results[1].record.name, "Game 002"));
+        CHECK(!job->results[0].image.isValid());
+    };
+    loader.submit(job);
+    finish(loader);
+    CHECK(done == 2);
+
+    // a cancelled job still comes back but done isn't called
+    job = new Loader::Job(Count, true);
+    memcpy(job->offsets, offsets, sizeof(offsets));
+    job->done = [&done](Loader::Job*) -> void {
+        ++done;
+    };
+    const auto id = loader.submit(job);
+    CHECK(loader.cancel(id));
+    CHECK(!loader.cancel(id + 1));
+    finish(loader);
+    CHECK(done == 2);
+    CHECK(!loader.cancel(id));
+
+    // stopping with work in flight drops it without calling done, and the
+    // loader can be started again after
+    for (int i = 0; i < 4; ++i) {
+        job = new Loader::Job(Count, true);
+        memcpy(job->offsets, offsets, sizeof(offsets));
+        job->done = [&done](Loader::Job*) -> void {
+            ++done;
+        };
+        loader.submit(job);
+    }
+    loader.stop();
+    CHECK(!loader.isRunning());
+    CHECK(loader.pending() == 0);
+    CHECK(done == 2);
+
+    CHECK(loader.start(Dir));
+    job = new Loader::Job(1, true);
+    job->offsets[0] = offsets[Count - 1];
+    job->done = [&done](Loader::Job* job) -> void {
+        ++done;
+        CHECK(!strcmp(job->results[0].record.name, "Game 011"));
+    };
+    loader.submit(job);
+    finish(loader);
+    CHECK(done == 3);
+    return 0;
+}
@@ -0,0 +1,160 @@
+#include "TestDB.h"
+#include "db/Cursor.h"
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+using namespace trost;
+
+static const char* Dir = "order.db";
+static constexpr int Count = 60;
+
+// what entry i has, -1 for none. ratings are numbers, some with leading
+// zeros, or "n/a" which isn't one
+static int year(int i)
+{
+    return i % 6 ? 1985 + (i * 13) % 9 : -1;
+}
+
+static int rating(int i)
+{
+    return i % 5 == 4 ? -1 : (i * 7) % 12;
+}
+
+static char publisher(int i)
+{
+    return static_cast<char>('A' + (i * 5) % 3);
+}
+
+static void write_ordered_games()
+{
+    mkdir(Dir, 0755);
+    char path[256];
+    snprintf(path, sizeof(path), "%s/games.txt", Dir);
+    auto games = fopen(path, "w");
+    CHECK(games);
+    for (int i = 0; i < Count; ++i) {
+        fprintf(games, "Game %03d\tdh0:games/%03d\t\t", i, i);
+        if (year(i) >= 0) {
+            fprintf(games, "year=%d; ", year(i));
+        }
+        if (rating(i) >= 0) {
+            fprintf(games, i % 3 ? "rating=%d; " : "rating=%03d; ", rating(i));
+        } else if (i % 2) {
+            fprintf(games, "rating=n/a; ");
+        }
+        // both spellings are the same key
+        fprintf(games, "publisher=%s %c\n", i % 2 ? "Studio" : "studio", publisher(i));
+    }
+    fclose(games);
+}
+
+// the ids the way orders.idx should have them. key is -1 for none, which
+// goes last either way, ties stay in name order
+template<typename Key>
+static std::vector<DB::Id> expected(Key&& key, bool descending)
+{
+    std::vector<DB::Id> ids;
+    for (int i = 0; i < Count; ++i) {
+        ids.push_back(static_cast<DB::Id>(i));
+    }
+    std::stable_sort(ids.begin(), ids.end(), [&](DB::Id a, DB::Id b) -> bool {
+        const int ka = key(a), kb = key(b);
+        if ((ka < 0) != (kb < 0)) {
+            return kb < 0;
+        }
+        return descending ? ka > kb : ka < kb;
+    });
+    return ids;
+}
+
+static void check_order(DB& db, const char* attribute, const std::vector<DB::Id>& want)
+{
+    Order order;
+    CHECK(db.order(attribute, &order));
+    CHECK(order.size() == want.size());
+    for (std::uint32_t i = 0; i < order.size(); ++i) {
+        CHECK(order.at(i) == want[i]);
+    }
+    // and a page at a time
+    DB::Id page[7];
+    for (std::uint32_t first = 0; first < order.size(); first += 7) {
+        const auto got = db.entries(order, first, page, 7);
+        CHECK(got == std::min<std::uint32_t>(7, order.size() - first));
+        for (std::uint32_t i = 0; i < got; ++i) {
+            CHECK(page[i] == want[first + i]);
+        }
+    }
+}
+
+int main()
+{
+    write_ordered_games();
+    DB db { String(Dir) };
+
+    // the default orders, none of which needs anything but games.txt
+    CHECK(db.createIndex());
+    int orders = 0;
+    db.orders([&orders](const char* attribute, bool descending) -> void {
+        CHECK(!descending);
+        CHECK(!strcmp(attribute, orders ? "publisher" : "year"));
+        ++orders;
+    });
+    CHECK(orders == 2);
+
+    DB::IndexOptions options;
+    options.orders = "year; -rating;publisher ;nothing";
+    CHECK(db.createIndex(options));
+    orders = 0;
+    db.orders([&orders](const char* attribute, bool descending) -> void {
+        static const char* const names[] = { "year", "rating", "publisher", "nothing" };
+        CHECK(!strcmp(attribute, names[orders]));
+        CHECK(descending == (orders == 1));
+        ++orders;
+    });
+    CHECK(orders == 4);
+
+    const auto byYear = expected(year, false);
+    check_order(db, "year", byYear);
+    check_order(db, "YEAR", byYear);
+    // numbers by value whatever their zeros, highest first. descending
+    // turns n/a ahead of them but entries without one stay last
+    check_order(db, "rating", expected([](int i) -> int {
+        return rating(i) >= 0 ? rating(i) : (i % 2 ? 1000 : -1);
+    }, true));
+    check_order(db, "publisher", expected(publisher, false));
+    // nobody has it, so name order
+    check_order(db, "nothing", expected([](int) -> int {
+        return -1;
+    }, false));
+    Order order;
+    CHECK(!db.order("genre", &order));
+
+    // walking an order keeps only the window hydrated
+    CHECK(db.order("year", &order));
+    {
+        Cursor cursor(&db, 8);
+        CHECK(!cursor.start(Order(), 0));
+        CHECK(cursor.start(std::move(order), 3));
+        CHECK(cursor.size() == Count - 3);
+        for (int step = 0; step < 20; ++step) {
+            for (std::uint32_t p = cursor.position(); p < cursor.position() + cursor.window(); ++p) {
+                const auto entry = cursor.at(p);
+                CHECK(entry && entry->id == byYear[3 + p]);
+            }
+            CHECK(live(db) == 8);
+            cursor.scroll(step < 10 ? 5 : -3);
+        }
+        cursor.seek(1000);
+        CHECK(cursor.position() == Count - 3 - 8);
+        CHECK(cursor.at(Count - 4) && cursor.at(Count - 4)->id == byYear[Count - 1]);
+
+        // and switching back to name order lets go of the order's window
+        CHECK(cursor.start(DB::Id(10)));
+        CHECK(cursor.at(0) && cursor.at(0)->id == 10);
+        CHECK(live(db) == 8);
+    }
+    CHECK(live(db) == 0);
+    return 0;
+}
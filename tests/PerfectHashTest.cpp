@@ -0,0 +1,95 @@
+#include "TestDB.h"
+#include "db/Format.h"
+#include "db/PerfectHash.h"
+#include "util/Collation.h"
+#include <vector>
+
+using namespace trost;
+
+static const char* Dir = "hash.db";
+
+// every key gets a slot of its own in [0, count) and a lookup through the
+// seeds finds the same one build() chose
+static void check_build(std::uint32_t count)
+{
+    std::vector<PerfectHash::Key> keys;
+    for (std::uint32_t i = 0; i < count; ++i) {
+        char name[32];
+        const auto length = snprintf(name, sizeof(name), "game %lu", static_cast<unsigned long>(i * 7919));
+        keys.push_back(PerfectHash::hash(name, static_cast<std::size_t>(length)));
+    }
+    std::vector<std::uint32_t> seeds(PerfectHash::bucketsFor(count) + 1), slots(count + 1);
+    CHECK(PerfectHash::build(keys.data(), count, seeds.data(), slots.data()));
+    std::vector<bool> taken(count);
+    for (std::uint32_t k = 0; k < count; ++k) {
+        const auto slot = slots[k];
+        CHECK(slot < count && !taken[slot]);
+        taken[slot] = true;
+        const auto seed = seeds[keys[k].bucket % PerfectHash::bucketsFor(count)];
+        CHECK(PerfectHash::slotFor(keys[k], seed, count) == slot);
+    }
+}
+
+// exact() holds what it finds, so every hit is let go of again
+static DB::Id exact(DB& db, const char* name)
+{
+    const auto id = db.exact(String(name));
+    if (id != DB::NoEntry) {
+        db.dispose(id, 1);
+    }
+    return id;
+}
+
+int main()
+{
+    static const std::uint32_t counts[] = { 1, 2, 3, 5, 100, 4000, 20000 };
+    for (auto count : counts) {
+        check_build(count);
+    }
+
+    // the same key twice can't be placed
+    PerfectHash::Key keys[8];
+    for (int i = 0; i < 8; ++i) {
+        char name[8];
+        keys[i] = PerfectHash::hash(name, static_cast<std::size_t>(snprintf(name, sizeof(name), "k%d", i)));
+    }
+    keys[5] = keys[2];
+    std::uint32_t seeds[2], slots[8];
+    CHECK(!PerfectHash::build(keys, 8, seeds, slots));
+
+    // names that fold to the same key are one key in the hash, exact()
+    // finds the first of them in name order
+    static const char* const names[] = { "Lemmings", "LEMMINGS", "Lotus", "Zool", "zool", "Zool 2" };
+    write_games(Dir, 6, false, names);
+    {
+        DB db { String(Dir) };
+        CHECK(db.createIndex());
+        CHECK(exact(db, "lemmings") == 0);
+        CHECK(exact(db, "ZOOL") == 3);
+        CHECK(exact(db, "Zool 2") == 5);
+        CHECK(exact(db, "Zoo") == DB::NoEntry);
+        CHECK(live(db) == 0);
+    }
+
+    // a hash that failed to build is written as an empty one, exact()
+    // searches the letter file instead and finds the same ids
+    {
+        std::uint8_t header[format::ExactHeaderSize];
+        File file;
+        CHECK(file.open("hash.db/exact.idx", File::Mode::Read) && file.readExact(header, sizeof(header)));
+        file.close();
+        format::put32(header + 8, 0);
+        format::put32(header + 12, 0);
+        CHECK(file.open("hash.db/exact.idx", File::Mode::Write) && file.write(header, sizeof(header)));
+    }
+    {
+        DB db { String(Dir) };
+        CHECK(exact(db, "lemmings") == 0);
+        CHECK(exact(db, "Lotus") == 2);
+        CHECK(exact(db, "ZOOL") == 3);
+        CHECK(exact(db, "Zool 2") == 5);
+        CHECK(exact(db, "Zoo") == DB::NoEntry);
+        CHECK(live(db) == 0);
+    }
+    return 0;
+}
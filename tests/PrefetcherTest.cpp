@@ -0,0 +1,79 @@
+#include "TestDB.h"
+#include "db/Prefetcher.h"
+
+using namespace trost;
+
+static const char* Dir = "prefetcher.db";
+static constexpr int PageSize = 8;
+
+// shows page the way a list view would, holding only what's on screen
+static void show(DB& db, Prefetcher& prefetcher, long page, unsigned long now)
+{
+    static long shown = -1;
+    const auto head = static_cast<DB::Id>(page * PageSize);
+    prefetcher.show(page, head, now);
+    if (shown >= 0) {
+        db.dispose(static_cast<DB::Id>(shown * PageSize), PageSize);
+    }
+    db.hydrate(head, PageSize);
+    shown = page;
+    while (prefetcher.idle()) {
+        drain(db);
+    }
+}
+
+static bool loaded(DB& db, long page)
+{
+    for (int i = 0; i < PageSize; ++i) {
+        const auto entry = db.entry(static_cast<DB::Id>(page * PageSize + i));
+        if (!entry || !entry->bitmap) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    write_games(Dir, 200, true);
+    DB db { String(Dir) };
+    CHECK(db.createIndex());
+
+    {
+        Prefetcher prefetcher(&db);
+        Prefetcher::Config config;
+        config.pageSize = PageSize;
+        config.imageEstimate = 1;
+        prefetcher.configure(config);
+
+        show(db, prefetcher, 0, 0);
+        CHECK(loaded(db, 1));
+
+        // paging on keeps at most the window hydrated, pages behind it
+        // are let go of
+        unsigned long now = 0;
+        for (long page = 1; page < 10; ++page) {
+            now += 1000;
+            show(db, prefetcher, page, now);
+            CHECK(loaded(db, page + 1));
+            CHECK(live(db) <= 5 * PageSize);
+        }
+        CHECK(prefetcher.stats().hits >= 8);
+        CHECK(!db.entry(7 * PageSize - 1));
+
+        // the thumbnails are still in the cache, the entries are gone
+        CHECK(db.cache()->count() > 0);
+
+        // a jump drops every page that was prefetched
+        show(db, prefetcher, 20, now + 1000);
+        for (long page = 7; page < 12; ++page) {
+            CHECK(!db.entry(static_cast<DB::Id>(page * PageSize)));
+        }
+        CHECK(loaded(db, 21));
+    }
+    // only the view's own page is left
+    CHECK(live(db) == PageSize);
+    db.dispose(20 * PageSize, PageSize);
+    CHECK(live(db) == 0);
+    return 0;
+}
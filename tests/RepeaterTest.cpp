@@ -0,0 +1,88 @@
+#include "Test.h"
+#include "util/Repeater.h"
+
+using namespace trost;
+
+// the clock is whatever the test says it is
+static void timing()
+{
+    Repeater repeater;
+    Repeater::Config config;
+    config.delay = 400;
+    config.interval = 100;
+    config.minInterval = 40;
+    config.acceleration = 20;
+    repeater.configure(config);
+
+    CHECK(!repeater.active());
+    CHECK(!repeater.fire(0));
+
+    repeater.press(7, 1000);
+    CHECK(repeater.active() && repeater.token() == 7);
+    CHECK(repeater.remaining(1000) == 400);
+    CHECK(!repeater.fire(1399));
+    CHECK(repeater.fire(1400));
+    CHECK(!repeater.fire(1400));
+
+    // a fifth off each time, rounded down, never below the minimum
+    const unsigned long intervals[] = { 100, 80, 64, 52, 42, 40, 40 };
+    unsigned long now = 1400;
+    for (auto interval : intervals) {
+        CHECK(repeater.remaining(now) == interval);
+        now += interval;
+        CHECK(!repeater.fire(now - 1));
+        CHECK(repeater.fire(now));
+    }
+    CHECK(repeater.repeats() == 8);
+
+    // a late caller gets one repeat, not the ones it missed
+    now += 1000;
+    CHECK(repeater.fire(now));
+    CHECK(!repeater.fire(now));
+    CHECK(repeater.remaining(now) == 40);
+
+    // only the held token stops it
+    repeater.release(8);
+    CHECK(repeater.active());
+    repeater.release(7);
+    CHECK(!repeater.active());
+    CHECK(!repeater.fire(now + 1000));
+
+    // a new press starts over
+    repeater.press(9, now);
+    CHECK(repeater.repeats() == 0 && repeater.remaining(now) == 400);
+    repeater.releaseAll();
+    CHECK(!repeater.active());
+}
+
+static void wrapping()
+{
+    Repeater repeater;
+    repeater.configure(Repeater::Config());
+    const unsigned long now = ~0UL - 100;
+    repeater.press(1, now);
+    CHECK(!repeater.fire(now + 399));
+    CHECK(repeater.fire(now + 400));
+    CHECK(repeater.remaining(now + 400) == 150);
+}
+
+static void limits()
+{
+    Repeater repeater;
+    Repeater::Config config;
+    config.interval = 10;
+    config.minInterval = 0;
+    config.acceleration = 150;
+    repeater.configure(config);
+    CHECK(repeater.config().minInterval == 1);
+    CHECK(repeater.config().interval == 10);
+    CHECK(repeater.config().acceleration == 100);
+}
+
+int main()
+{
+    timing();
+    wrapping();
+    limits();
+    return 0;
+}
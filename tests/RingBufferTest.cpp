@@ -0,0 +1,67 @@
+#include "Test.h"
+#include "util/RingBuffer.h"
+#include <thread>
+
+using namespace trost;
+
+static void single_thread()
+{
+    RingBuffer<int, 4> ring;
+    CHECK(ring.empty());
+    for (int i = 0; i < 4; ++i) {
+        CHECK(ring.push(i));
+    }
+    CHECK(!ring.push(4));
+    CHECK(ring.dropped() == 1);
+    CHECK(ring.size() == 4);
+
+    int value;
+    for (int i = 0; i < 4; ++i) {
+        CHECK(ring.pop(&value));
+        CHECK(value == i);
+    }
+    CHECK(!ring.pop(&value));
+    CHECK(ring.empty());
+}
+
+// one thread pushes a running sequence while another pops it, every value
+// has to come out exactly once and in order. a full buffer makes the
+// producer retry, those attempts are what dropped() counts
+static void two_threads()
+{
+    constexpr unsigned long Count = 1000000;
+    RingBuffer<unsigned long, 64> ring;
+    unsigned long retries = 0;
+
+    std::thread producer([&ring, &retries]() {
+        for (unsigned long i = 0; i < Count; ++i) {
+            while (!ring.push(i)) {
+                ++retries;
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    unsigned long expected = 0;
+    while (expected < Count) {
+        unsigned long value;
+        if (!ring.pop(&value)) {
+            std::this_thread::yield();
+            continue;
+        }
+        CHECK(value == expected);
+        ++expected;
+    }
+    producer.join();
+
+    unsigned long value;
+    CHECK(!ring.pop(&value));
+    CHECK(ring.dropped() == retries);
+}
+
+int main()
+{
+    single_thread();
+    two_threads();
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include "Test.h"
+#include "util/SharedPtr.h"
+#include <utility>
+
+using namespace trost;
+
+static int alive = 0;
+
+struct Node
+{
+    Node()
+    {
+        ++alive;
+    }
+    ~Node()
+    {
+        --alive;
+    }
+
+    int value = 0;
+    SharedPtr<Node> next;
+};
+
+// a list of count nodes with values 0 on, only held by the head
+static SharedPtr<Node> make_list(int count)
+{
+    SharedPtr<Node> head;
+    for (int i = count - 1; i >= 0; --i) {
+        SharedPtr<Node> node(new Node);
+        node->value = i;
+        node->next = std::move(head);
+        head = std::move(node);
+    }
+    return head;
+}
+
+int main()
+{
+    // walking a list through the pointer that holds it frees each node on
+    // the way, with the one assigned from living inside the one released
+    {
+        auto p = make_list(5);
+        CHECK(alive == 5);
+        for (int i = 0; i < 5; ++i) {
+            CHECK(p && p->value == i && p.useCount() == 1);
+            p = p->next;
+            CHECK(alive == 4 - i);
+        }
+        CHECK(!p && p.useCount() == 0);
+    }
+    {
+        auto p = make_list(3);
+        p = std::move(p->next);
+        CHECK(alive == 2 && p->value == 1);
+    }
+    CHECK(alive == 0);
+
+    // copies share the count, the last one out deletes
+    {
+        SharedPtr<Node> a(new Node);
+        auto b = a;
+        CHECK(a.useCount() == 2 && b.get() == a.get());
+        b = b;
+        CHECK(a.useCount() == 2);
+        a = SharedPtr<Node>();
+        CHECK(alive == 1 && b.useCount() == 1);
+    }
+    CHECK(alive == 0);
+
+    // a deleter runs instead of delete
+    int deleted = 0;
+    {
+        SharedPtr<Node> p(new Node, [&deleted](Node* node) -> void {
+            ++deleted;
+            delete node;
+        });
+        auto q = p;
+    }
+    CHECK(deleted == 1 && alive == 0);
+    return 0;
+}
@@ -0,0 +1,30 @@
+#include "Test.h"
+#include "util/SlotMap.h"
+
+using namespace trost;
+
+int main()
+{
+    SlotMap<int> map;
+    const auto a = map.insert(1);
+    const auto b = map.insert(2);
+    CHECK(a && b && a != b);
+    CHECK(map.erase(a));
+    CHECK(!map.get(a) && *map.get(b) == 2);
+    // the slot comes back with a new generation
+    const auto c = map.insert(3);
+    CHECK(c && c != a && (c & 0xffff) == (a & 0xffff) && *map.get(c) == 3 && !map.get(a));
+
+    // 0xffff slots and then no more, without disturbing the ones there are
+    while (map.size() < 0xffff) {
+        CHECK(map.insert(static_cast<int>(map.size())));
+    }
+    CHECK(!map.insert(-1));
+    CHECK(map.size() == 0xffff && *map.get(b) == 2 && *map.get(c) == 3);
+    // one erased makes room for one
+    CHECK(map.erase(b));
+    const auto d = map.insert(4);
+    CHECK(d && *map.get(d) == 4 && !map.get(b));
+    CHECK(!map.insert(-1));
+    return 0;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Test.h"
+#include "db/DB.h"
+#include "db/File.h"
+#include "db/Image.h"
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+// a small ILBM for games.txt to point at, seed picks the colours so the
+// thumbnails don't all come out the same
+inline void write_picture(const char* path, int seed)
+{
+    trost::Image image;
+    CHECK(image.allocate(16, 16, 2));
+    for (std::uint16_t p = 0; p < image.depth(); ++p) {
+        memset(image.plane(p), (seed + p) & 1 ? 0xf0 : 0x3c, image.bytesPerRow() * image.height());
+    }
+    const std::uint16_t palette[4] = { 0x000, static_cast<std::uint16_t>(0x100 * (seed % 16)), 0x0f0, 0x00f };
+    trost::File file;
+    CHECK(file.open(path, trost::File::Mode::Write));
+    CHECK(image.saveILBM(file, palette, 4));
+}
+
+// dir/games.txt with count entries named "Game 000" on, or names[i] when
+// names is given. with pictures every entry gets one of two pictures
+inline void write_games(const char* dir, int count, bool pictures, const char* const* names = nullptr)
+{
+    mkdir(dir, 0755);
+    char path[256];
+    if (pictures) {
+        for (int i = 0; i < 2; ++i) {
+            snprintf(path, sizeof(path), "%s/picture%d.iff", dir, i);
+            write_picture(path, i);
+        }
+    }
+    snprintf(path, sizeof(path), "%s/games.txt", dir);
+    auto games = fopen(path, "w");
+    CHECK(games);
+    for (int i = 0; i < count; ++i) {
+        char name[256];
+        if (names) {
+            snprintf(name, sizeof(name), "%s", names[i]);
+        } else {
+            snprintf(name, sizeof(name), "Game %03d", i);
+        }
+        if (pictures) {
+            fprintf(games, "%s\tdh0:games/%03d\t%s/picture%d.iff\n", name, i, dir, i % 2);
+        } else {
+            fprintf(games, "%s\tdh0:games/%03d\n", name, i);
+        }
+    }
+    fclose(games);
+}
+
+inline void drain(trost::DB& db)
+{
+    while (db.loader()->pending()) {
+        db.loader()->wait();
+        db.loader()->process();
+    }
+}
+
+inline std::uint32_t live(trost::DB& db)
+{
+    std::uint32_t count = 0;
+    for (trost::DB::Id id = 0; id < db.entryCount(); ++id) {
+        count += db.entry(id) != nullptr;
+    }
+    return count;
+}
@@ -0,0 +1,107 @@
+#include "TestDB.h"
+#include "db/Format.h"
+
+using namespace trost;
+
+static const char* Dir = "thumbnail.db";
+
+static bool same_image(const Image& a, const Image& b)
+{
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (std::uint16_t p = 0; p < a.depth(); ++p) {
+        if (memcmp(a.plane(p), b.plane(p), a.bytesPerRow() * a.height()) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// a thumbnail of 4x4 blocks survives being shrunk by 4 and scaled back up
+static void preview_test()
+{
+    Image thumbnail;
+    CHECK(thumbnail.allocate(96, 72, 4));
+    for (std::uint16_t p = 0; p < thumbnail.depth(); ++p) {
+        memset(thumbnail.plane(p), p & 1 ? 0xf0 : 0x0f, thumbnail.bytesPerRow() * thumbnail.height());
+    }
+    std::uint8_t data[format::MaxPreviewSize];
+    const auto length = format::encodePreview(thumbnail, data);
+    CHECK(length && data[0] == 24 && data[1] == 18 && data[2] == 4 && data[3] == 4);
+    Image preview;
+    CHECK(format::decodePreview(data, length, &preview));
+    CHECK(preview.width() == 96 && preview.height() == 72 && preview.depth() == 4);
+    CHECK(same_image(preview, thumbnail));
+    CHECK(!format::decodePreview(data, length - 1, &preview));
+
+    // too deep to fit until it's a sixteenth, which rounds the size up
+    CHECK(thumbnail.allocate(200, 150, 8));
+    CHECK(format::encodePreview(thumbnail, data) && data[3] == 16);
+    CHECK(format::decodePreview(data, format::encodePreview(thumbnail, data), &preview));
+    CHECK(preview.width() == 208 && preview.height() == 160 && preview.depth() == 8);
+}
+
+int main()
+{
+    preview_test();
+
+    // names that aren't file names, and two entries with the same one
+    static const char* const names[] = {
+        "AC/DC Live",
+        "Lemmings",
+        "Lemmings",
+        "Monkey Island 2: LeChuck's Revenge",
+        "Zool",
+        "Zool 2",
+    };
+    const int count = sizeof(names) / sizeof(names[0]);
+    write_games(Dir, count, true, names);
+
+    DB db { String(Dir) };
+    CHECK(db.createIndex());
+    CHECK(db.entryCount() == count);
+    db.hydrate(0, count);
+    for (DB::Id id = 0; id < db.entryCount(); ++id) {
+        CHECK(db.entry(id) && db.entry(id)->bitmap);
+    }
+    // every other entry has the other picture, the two named Lemmings too
+    CHECK(!same_image(*db.entry(1)->bitmap, *db.entry(2)->bitmap));
+    CHECK(same_image(*db.entry(1)->bitmap, *db.entry(3)->bitmap));
+    db.dispose(0, count);
+
+    // without bitmaps the records give previews about the thumbnail's size,
+    // a fresh DB so the cache doesn't hand out the bitmaps straight away
+    {
+        DB fresh { String(Dir) };
+        fresh.hydrate(0, count, false);
+        std::uint16_t widths[count], heights[count];
+        for (DB::Id id = 0; id < fresh.entryCount(); ++id) {
+            const auto entry = fresh.entry(id);
+            CHECK(entry && !entry->bitmap && entry->preview);
+            widths[id] = entry->preview->width();
+            heights[id] = entry->preview->height();
+        }
+        // and once the bitmaps are there the previews are gone
+        fresh.hydrate(0, count);
+        for (DB::Id id = 0; id < fresh.entryCount(); ++id) {
+            const auto entry = fresh.entry(id);
+            CHECK(entry && entry->bitmap && !entry->preview);
+            CHECK(widths[id] >= entry->bitmap->width() && widths[id] < entry->bitmap->width() + 16);
+            CHECK(heights[id] >= entry->bitmap->height() && heights[id] < entry->bitmap->height() + 16);
+        }
+        fresh.dispose(0, count);
+        fresh.dispose(0, count);
+        CHECK(live(fresh) == 0);
+    }
+
+    // without pictures nothing from the last index may turn up
+    write_games(Dir, count, false, names);
+    CHECK(db.createIndex());
+    db.hydrate(0, count);
+    for (DB::Id id = 0; id < db.entryCount(); ++id) {
+        CHECK(db.entry(id) && !db.entry(id)->bitmap && !db.entry(id)->preview);
+    }
+    db.dispose(0, count);
+    return 0;
+}
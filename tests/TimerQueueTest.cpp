@@ -0,0 +1,110 @@
+#include "Test.h"
+#include "util/TimerQueue.h"
+
+using namespace trost;
+
+// one-shots fire once in deadline order, whatever order they were added in
+static void ordering()
+{
+    TimerQueue queue;
+    Vector<int> fired;
+    queue.add(0, 30, 0, [&fired]() -> void { fired.push_back(3); });
+    queue.add(0, 10, 0, [&fired]() -> void { fired.push_back(1); });
+    queue.add(0, 20, 0, [&fired]() -> void { fired.push_back(2); });
+    CHECK(!queue.empty() && queue.nextDeadline() == 10);
+
+    CHECK(queue.fire(9) == 0);
+    CHECK(queue.fire(25) == 2);
+    CHECK(fired.size() == 2 && fired[0] == 1 && fired[1] == 2);
+    CHECK(queue.nextDeadline() == 30);
+    CHECK(queue.fire(100) == 1);
+    CHECK(fired.size() == 3 && fired[2] == 3);
+    CHECK(queue.empty());
+    CHECK(queue.fire(1000) == 0);
+}
+
+// periodic timers keep their phase and drop periods a late caller missed
+static void periodic()
+{
+    TimerQueue queue;
+    int ticks = 0;
+    const auto handle = queue.add(0, 10, 10, [&ticks]() -> void { ++ticks; });
+    CHECK(queue.fire(10) == 1 && queue.nextDeadline() == 20);
+    CHECK(queue.fire(20) == 1 && queue.nextDeadline() == 30);
+    CHECK(queue.fire(95) == 1 && ticks == 3);
+    CHECK(queue.nextDeadline() == 105);
+    CHECK(queue.remove(handle));
+    CHECK(!queue.remove(handle));
+    CHECK(queue.empty());
+    CHECK(queue.fire(1000) == 0 && ticks == 3);
+}
+
+// callbacks can remove themselves and others and add timers, new ones
+// wait for the next call even when they're already due
+static void reentrancy()
+{
+    TimerQueue queue;
+    TimerQueue::Handle self = 0;
+    TimerQueue::Handle other = 0;
+    int selfTicks = 0;
+    int otherTicks = 0;
+    int added = 0;
+    self = queue.add(0, 10, 10, [&]() -> void {
+        ++selfTicks;
+        CHECK(queue.remove(self));
+        CHECK(!queue.remove(self));
+        queue.remove(other);
+        queue.add(10, 0, 0, [&added]() -> void { ++added; });
+    });
+    other = queue.add(0, 10, 10, [&otherTicks]() -> void { ++otherTicks; });
+
+    CHECK(queue.fire(10) == 1);
+    CHECK(selfTicks == 1 && otherTicks == 0 && added == 0);
+    CHECK(queue.fire(10) == 1 && added == 1);
+    CHECK(queue.empty());
+}
+
+// deadlines are compared by distance, so the clock wrapping doesn't
+// reorder anything
+static void wrapping()
+{
+    TimerQueue queue;
+    const unsigned long now = ~0UL - 5;
+    Vector<int> fired;
+    queue.add(now, 20, 0, [&fired]() -> void { fired.push_back(2); });
+    queue.add(now, 2, 0, [&fired]() -> void { fired.push_back(1); });
+    CHECK(queue.nextDeadline() == now + 2);
+    CHECK(queue.fire(now + 10) == 1);
+    CHECK(queue.fire(now + 20) == 1);
+    CHECK(fired.size() == 2 && fired[0] == 1 && fired[1] == 2);
+}
+
+// lots of timers through the heap, stepping the clock a millisecond at
+// a time every one fires right at its deadline
+static void many()
+{
+    TimerQueue queue;
+    bool onTime = true;
+    unsigned long now = 0;
+    for (unsigned long i = 0; i < 500; ++i) {
+        const unsigned long delay = (i * 7919) % 1000;
+        queue.add(0, delay, 0, [&onTime, &now, delay]() -> void {
+            onTime = onTime && now == delay;
+        });
+    }
+    unsigned int fired = 0;
+    for (now = 0; now < 1000; ++now) {
+        fired += queue.fire(now);
+    }
+    CHECK(onTime && fired == 500 && queue.empty());
+}
+
+int main()
+{
+    ordering();
+    periodic();
+    reentrancy();
+    wrapping();
+    many();
+    return 0;
+}